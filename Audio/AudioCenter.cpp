@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "AudioCenter.h"
 
+bool AudioCenter::s_enabled = true;
+
 AudioCenter& AudioCenter::Inst()
 {
 	static AudioCenter inst{};
@@ -8,6 +8,9 @@ class AudioCenter
 {
 public:
 	static AudioCenter& Inst();
+	// When disabled Inst() is never needed, so the TTS thread and embedded python never start
+	static void SetEnabled(bool enabled) { s_enabled = enabled; }
+	static bool IsEnabled() { return s_enabled; }
 
 	struct voiceMsg
 	{
@@ -28,6 +31,7 @@ private:
 	std::mutex _mutex;
 
 	bool _stopped = false;
+	static bool s_enabled;
 
 	void PlayVoiceMsg();
 };
\ No newline at end of file
@@ -0,0 +1,587 @@
+#include "pch.h"
+#include "EquityCalculator.h"
+#include "GameItem/HandEvaluator.h"
+#include "GameItem/Rng.h"
+#include "Utils/ShardedExecutor.h"
+#include "Utils/WorkStealingPool.h"
+#include <array>
+#include <cmath>
+#include <map>
+#include <random>
+
+#undef min
+#undef max
+
+namespace
+{
+	// trials between two looks at the clock and the cancel flag
+	constexpr uint64_t kTrialBatch = 256;
+
+	ShardedExecutor& Pool()
+	{
+		// one shard per core; a run posts one worker per shard, so two runs at once queue up
+		// behind each other instead of oversubscribing the machine
+		static ShardedExecutor pool(0);
+		return pool;
+	}
+
+	WorkStealingPool& StealingPool()
+	{
+		static WorkStealingPool pool(0);
+		return pool;
+	}
+
+	// runouts scored per StrengthBatch call
+	constexpr size_t kRunoutChunk = 256;
+
+	// what a showdown compares in this score mode: the strength itself when Exact, the
+	// coarser Compatible score otherwise, so equity follows the table's own winner
+	uint32_t ShowdownKey(uint32_t strength, HandEvaluator::ScoreMode mode)
+	{
+		return mode == HandEvaluator::ScoreMode::Exact ? strength : (uint32_t)HandEvaluator::ToScore(strength, mode);
+	}
+
+	void ToShowdownKeys(uint32_t* strengths, size_t count, HandEvaluator::ScoreMode mode)
+	{
+		if (mode == HandEvaluator::ScoreMode::Exact)
+			return;
+		for (size_t i = 0; i < count; i++)
+			strengths[i] = (uint32_t)HandEvaluator::ToScore(strengths[i], mode);
+	}
+
+	// every way to add `left` more cards from deck[from..] to cards
+	template <typename Emit>
+	void ForEachCombo(const uint8_t* deck, int deckSize, int from, int left, uint64_t cards, Emit& emit)
+	{
+		if (left == 0)
+		{
+			emit(cards);
+			return;
+		}
+		for (int i = from; i <= deckSize - left; i++)
+			ForEachCombo(deck, deckSize, i + 1, left - 1, cards | (1ull << deck[i]), emit);
+	}
+
+	// matchups held in memory at once, a bound on RangeVsRange's footprint (about 50 MB at three ranges)
+	constexpr uint64_t kMaxMatchups = 4'000'000;
+	// entries kept before the range cache starts over
+	constexpr size_t kRangeCacheLimit = 256;
+
+	std::mutex s_rangeCacheMutex;
+	std::map<std::vector<uint64_t>, RangeEquity> s_rangeCache;
+
+	struct ExactPartial
+	{
+		std::vector<double> share;
+		std::vector<uint64_t> wins;
+		std::vector<uint64_t> ties;
+		uint64_t runouts = 0;
+	};
+}
+
+double EquityResult::Margin95(double rate, uint64_t trials)
+{
+	return trials ? 1.96 * std::sqrt(rate * (1.0 - rate) / trials) : 0.0;
+}
+
+double EquityResult::EquityMargin95() const
+{
+	if (trials == 0)
+		return 0.0;
+	const double mean = Equity();
+	const double variance = std::max(0.0, equitySq / trials - mean * mean);
+	return 1.96 * std::sqrt(variance / trials);
+}
+
+void EquityResult::Merge(const EquityResult& other)
+{
+	trials += other.trials;
+	wins += other.wins;
+	ties += other.ties;
+	losses += other.losses;
+	equity += other.equity;
+	equitySq += other.equitySq;
+}
+
+bool EquityJob::Done() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_running == 0;
+}
+
+EquityResult EquityJob::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_cv.wait(lock, [this]() { return m_running == 0; });
+	return m_result;
+}
+
+void EquityJob::OnDone(std::function<void()> callback)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_running > 0)
+		{
+			m_onDone = std::move(callback);
+			return;
+		}
+	}
+	callback();
+}
+
+void EquityJob::RunWorker(uint64_t seed)
+{
+	const EquityRequest& request = m_request;
+	const CardSet live = CardSet::Full() - request.hole - request.board - request.dead;
+	std::array<uint8_t, 52> deck{};
+	int deckSize = 0;
+	for (uint64_t bits = live.Bits(); bits != 0; bits &= bits - 1)
+		deck[deckSize++] = (uint8_t)std::countr_zero(bits);
+
+	const int boardMissing = 5 - request.board.Count();
+	const int dealt = boardMissing + 2 * request.opponents;
+	Xoshiro256 rng(seed);
+	EquityResult local;
+
+	while (!m_cancelled && std::chrono::steady_clock::now() < m_deadline)
+	{
+		uint64_t batch = kTrialBatch;
+		if (request.maxTrials > 0)
+		{
+			const uint64_t first = m_claimed.fetch_add(kTrialBatch);
+			if (first >= request.maxTrials)
+				break;
+			batch = std::min(kTrialBatch, request.maxTrials - first);
+		}
+
+		for (uint64_t trial = 0; trial < batch; trial++)
+		{
+			// partial Fisher-Yates: the first `dealt` slots are the runout, then two per opponent
+			for (int i = 0; i < dealt; i++)
+				std::swap(deck[i], deck[i + rng() % (uint64_t)(deckSize - i)]);
+			uint64_t board = request.board.Bits();
+			for (int i = 0; i < boardMissing; i++)
+				board |= 1ull << deck[i];
+
+			const uint32_t ours = ShowdownKey(HandEvaluator::Strength((request.hole | CardSet(board)).Lanes()), m_scoreMode);
+			int tiedWith = 0;
+			bool lost = false;
+			for (int o = 0; o < request.opponents && !lost; o++)
+			{
+				const int first = boardMissing + 2 * o;
+				const CardSet theirs(board | (1ull << deck[first]) | (1ull << deck[first + 1]));
+				const uint32_t strength = ShowdownKey(HandEvaluator::Strength(theirs.Lanes()), m_scoreMode);
+				lost = strength > ours;
+				tiedWith += strength == ours;
+			}
+
+			if (lost)
+				local.losses++;
+			else if (tiedWith > 0)
+			{
+				const double share = 1.0 / (tiedWith + 1);
+				local.ties++;
+				local.equity += share;
+				local.equitySq += share * share;
+			}
+			else
+			{
+				local.wins++;
+				local.equity += 1.0;
+				local.equitySq += 1.0;
+			}
+		}
+		local.trials += batch;
+	}
+	Finish(local);
+}
+
+void EquityJob::Finish(const EquityResult& partial)
+{
+	std::function<void()> onDone;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_result.Merge(partial);
+		if (--m_running > 0)
+			return;
+		m_result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startedAt).count();
+		m_result.cancelled = m_cancelled;
+		onDone = std::move(m_onDone);
+		m_cv.notify_all();
+	}
+	if (onDone)
+		onDone();
+}
+
+std::string EquityCalculator::Validate(const EquityRequest& request)
+{
+	if (request.hole.Count() != 2)
+		return "need exactly two hole cards";
+	if (request.board.Count() > 5)
+		return "at most five community cards";
+	if (request.hole.Intersects(request.board) || request.hole.Intersects(request.dead) || request.board.Intersects(request.dead))
+		return "a card is given twice";
+	if (request.opponents < 1 || request.opponents > 9)
+		return "opponents must be 1 to 9";
+	if (request.budget.count() <= 0)
+		return "the time budget must be positive";
+	const int needed = 5 - request.board.Count() + 2 * request.opponents;
+	if (needed > (CardSet::Full() - request.hole - request.board - request.dead).Count())
+		return "not enough cards left to deal";
+	return {};
+}
+
+std::shared_ptr<EquityJob> EquityCalculator::Start(const EquityRequest& request)
+{
+	if (!Validate(request).empty())
+		return nullptr;
+
+	auto job = std::make_shared<EquityJob>();
+	job->m_request = request;
+	job->m_scoreMode = HandEvaluator::GetScoreMode();
+	job->m_startedAt = std::chrono::steady_clock::now();
+	job->m_deadline = job->m_startedAt + request.budget;
+
+	const size_t workers = request.threads > 0 ? std::min((size_t)request.threads, WorkerCount()) : WorkerCount();
+	job->m_running = (int)workers;
+	uint64_t seed = request.seed;
+	if (seed == 0)
+		seed = ((uint64_t)std::random_device{}() << 32) | std::random_device{}();
+	for (size_t i = 0; i < workers; i++)
+	{
+		// workers need independent streams, not neighbouring seeds of one
+		const uint64_t workerSeed = seed + 0x9E3779B97F4A7C15ull * (i + 1);
+		Pool().Post(i, [job, workerSeed]() { job->RunWorker(workerSeed); });
+	}
+	return job;
+}
+
+EquityResult EquityCalculator::Run(const EquityRequest& request)
+{
+	auto job = Start(request);
+	return job ? job->Wait() : EquityResult{};
+}
+
+size_t EquityCalculator::WorkerCount()
+{
+	return Pool().ShardCount();
+}
+
+std::string EquityCalculator::ValidateExact(const std::vector<CardSet>& hands, CardSet board, CardSet dead)
+{
+	if (hands.empty() || hands.size() > 10)
+		return "need 1 to 10 hands";
+	if (board.Count() > 5)
+		return "at most five community cards";
+	CardSet used = board;
+	if (used.Intersects(dead))
+		return "a card is given twice";
+	used |= dead;
+	for (const CardSet& hand : hands)
+	{
+		if (hand.Count() != 2)
+			return "every hand needs exactly two cards";
+		if (used.Intersects(hand))
+			return "a card is given twice";
+		used |= hand;
+	}
+	if (5 - board.Count() > (CardSet::Full() - used).Count())
+		return "not enough cards left to deal";
+	return {};
+}
+
+ExactEquity EquityCalculator::Enumerate(const std::vector<CardSet>& hands, CardSet board, CardSet dead, bool parallel)
+{
+	ExactEquity result;
+	if (!ValidateExact(hands, board, dead).empty())
+		return result;
+	const auto start = std::chrono::steady_clock::now();
+	const HandEvaluator::ScoreMode mode = HandEvaluator::GetScoreMode();
+
+	CardSet live = CardSet::Full() - board - dead;
+	for (const CardSet& hand : hands)
+		live -= hand;
+	std::array<uint8_t, 52> deck{};
+	int deckSize = 0;
+	for (uint64_t bits = live.Bits(); bits != 0; bits &= bits - 1)
+		deck[deckSize++] = (uint8_t)std::countr_zero(bits);
+
+	// one task per first dealt card: the lower the card the more runouts follow it,
+	// which is the imbalance the stealing pool evens out
+	const int missing = 5 - board.Count();
+	const size_t players = hands.size();
+	const size_t tasks = missing == 0 ? 1 : (size_t)(deckSize - missing + 1);
+	std::vector<ExactPartial> partials(tasks);
+
+	auto runTask = [&](size_t task) {
+		ExactPartial& out = partials[task];
+		out.share.assign(players, 0.0);
+		out.wins.assign(players, 0);
+		out.ties.assign(players, 0);
+
+		std::array<uint64_t, kRunoutChunk> runouts;
+		std::array<std::array<uint16_t, kRunoutChunk>, 4> lanes;
+		std::vector<std::array<uint32_t, kRunoutChunk>> strengths(players);
+		size_t filled = 0;
+
+		auto score = [&]() {
+			for (size_t p = 0; p < players; p++)
+			{
+				for (size_t i = 0; i < filled; i++)
+				{
+					const CardSet cards(runouts[i] | hands[p].Bits());
+					for (int s = 0; s < 4; s++)
+						lanes[s][i] = cards.Suit(s);
+				}
+				HandEvaluator::StrengthBatch({ lanes[0].data(), lanes[1].data(), lanes[2].data(), lanes[3].data() },
+					filled, strengths[p].data());
+				ToShowdownKeys(strengths[p].data(), filled, mode);
+			}
+			for (size_t i = 0; i < filled; i++)
+			{
+				uint32_t best = 0;
+				int winners = 0;
+				for (size_t p = 0; p < players; p++)
+				{
+					if (strengths[p][i] > best)
+					{
+						best = strengths[p][i];
+						winners = 1;
+					}
+					else if (strengths[p][i] == best)
+						winners++;
+				}
+				const double share = 1.0 / winners;
+				for (size_t p = 0; p < players; p++)
+				{
+					if (strengths[p][i] != best)
+						continue;
+					out.share[p] += share;
+					(winners == 1 ? out.wins[p] : out.ties[p])++;
+				}
+			}
+			out.runouts += filled;
+			filled = 0;
+		};
+		auto emit = [&](uint64_t cards) {
+			runouts[filled] = cards;
+			if (++filled == kRunoutChunk)
+				score();
+		};
+
+		if (missing == 0)
+			emit(board.Bits());
+		else
+			ForEachCombo(deck.data(), deckSize, (int)task + 1, missing - 1, board.Bits() | (1ull << deck[task]), emit);
+		score();
+	};
+
+	if (parallel)
+		StealingPool().ParallelFor(tasks, runTask);
+	else
+		for (size_t task = 0; task < tasks; task++)
+			runTask(task);
+
+	result.equity.assign(players, 0.0);
+	result.wins.assign(players, 0);
+	result.ties.assign(players, 0);
+	for (const ExactPartial& partial : partials)
+	{
+		for (size_t p = 0; p < players; p++)
+		{
+			result.equity[p] += partial.share[p];
+			result.wins[p] += partial.wins[p];
+			result.ties[p] += partial.ties[p];
+		}
+		result.runouts += partial.runouts;
+	}
+	for (double& equity : result.equity)
+		equity /= result.runouts;
+	result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+RangeEquity EquityCalculator::RangeVsRange(const std::vector<HandRange>& ranges, CardSet board, CardSet dead)
+{
+	RangeEquity result;
+	if (ranges.size() < 2 || ranges.size() > 6)
+		result.error = "need 2 to 6 ranges";
+	else if (board.Count() < 3 || board.Count() > 5)
+		result.error = "the board needs 3 to 5 cards";
+	else if (board.Intersects(dead))
+		result.error = "a card is given twice";
+	if (!result.error.empty())
+		return result;
+
+	const HandEvaluator::ScoreMode mode = HandEvaluator::GetScoreMode();
+	std::vector<uint64_t> key = { board.Bits(), dead.Bits(), (uint64_t)mode };
+	for (const HandRange& range : ranges)
+		key.push_back(range.Fingerprint());
+	{
+		std::unique_lock<std::mutex> lock(s_rangeCacheMutex);
+		auto it = s_rangeCache.find(key);
+		if (it != s_rangeCache.end())
+		{
+			result = it->second;
+			result.cached = true;
+			return result;
+		}
+	}
+	const auto start = std::chrono::steady_clock::now();
+
+	// card removal, part one: combos that hit the board or a dead card never play
+	const size_t players = ranges.size();
+	const CardSet known = board | dead;
+	std::vector<std::vector<HandRange::Combo>> live(players);
+	for (size_t r = 0; r < players; r++)
+	{
+		for (const HandRange::Combo& combo : ranges[r].Combos())
+			if (!combo.cards.Intersects(known))
+				live[r].push_back(combo);
+		result.combos.push_back(live[r].size());
+		if (live[r].empty())
+		{
+			result.error = "range " + std::to_string(r + 1) + " has no combo left on this board";
+			return result;
+		}
+	}
+
+	// part two: matchups where two players would hold the same card
+	std::vector<uint16_t> matchups;
+	std::vector<double> matchupWeights;
+	std::vector<uint16_t> picked(players);
+	auto collect = [&](auto& self, size_t r, CardSet used, double weight) -> bool {
+		if (r == players)
+		{
+			if (matchupWeights.size() >= kMaxMatchups)
+				return false;
+			matchups.insert(matchups.end(), picked.begin(), picked.end());
+			matchupWeights.push_back(weight);
+			return true;
+		}
+		for (size_t i = 0; i < live[r].size(); i++)
+		{
+			if (live[r][i].cards.Intersects(used))
+				continue;
+			picked[r] = (uint16_t)i;
+			if (!self(self, r + 1, used | live[r][i].cards, weight * live[r][i].weight))
+				return false;
+		}
+		return true;
+	};
+	if (!collect(collect, 0, CardSet{}, 1.0))
+	{
+		result.error = "more than " + std::to_string(kMaxMatchups) + " matchups, narrow the ranges";
+		return result;
+	}
+	if (matchupWeights.empty())
+	{
+		result.error = "the ranges have no matchup without a shared card";
+		return result;
+	}
+
+	std::vector<uint64_t> runouts;
+	{
+		const CardSet deck = CardSet::Full() - known;
+		std::array<uint8_t, 52> cards{};
+		int deckSize = 0;
+		for (uint64_t bits = deck.Bits(); bits != 0; bits &= bits - 1)
+			cards[deckSize++] = (uint8_t)std::countr_zero(bits);
+		auto emit = [&runouts](uint64_t runout) { runouts.push_back(runout); };
+		ForEachCombo(cards.data(), deckSize, 0, 5 - board.Count(), board.Bits(), emit);
+	}
+
+	struct RunoutPartial
+	{
+		std::vector<double> share;
+		double total = 0;
+	};
+	std::vector<RunoutPartial> partials(runouts.size());
+	const size_t matchupCount = matchupWeights.size();
+
+	StealingPool().ParallelFor(runouts.size(), [&](size_t index) {
+		const uint64_t runout = runouts[index];
+		RunoutPartial& out = partials[index];
+		out.share.assign(players, 0.0);
+
+		// each combo scored once per runout; 0 marks a combo the runout itself blocks
+		std::vector<std::vector<uint32_t>> strengths(players);
+		std::array<std::vector<uint16_t>, 4> lanes;
+		for (size_t r = 0; r < players; r++)
+		{
+			const size_t n = live[r].size();
+			for (auto& lane : lanes)
+				lane.resize(n);
+			for (size_t i = 0; i < n; i++)
+			{
+				const CardSet cards(runout | live[r][i].cards.Bits());
+				for (int s = 0; s < 4; s++)
+					lanes[s][i] = cards.Suit(s);
+			}
+			strengths[r].resize(n);
+			HandEvaluator::StrengthBatch({ lanes[0].data(), lanes[1].data(), lanes[2].data(), lanes[3].data() },
+				n, strengths[r].data());
+			ToShowdownKeys(strengths[r].data(), n, mode);
+			for (size_t i = 0; i < n; i++)
+				if ((live[r][i].cards.Bits() & runout) != 0)
+					strengths[r][i] = 0;
+		}
+
+		std::array<uint32_t, 6> scores{};
+		const uint16_t* matchup = matchups.data();
+		for (size_t m = 0; m < matchupCount; m++, matchup += players)
+		{
+			uint32_t best = 0;
+			bool blocked = false;
+			for (size_t r = 0; r < players; r++)
+			{
+				scores[r] = strengths[r][matchup[r]];
+				blocked |= scores[r] == 0;
+				best = std::max(best, scores[r]);
+			}
+			if (blocked)
+				continue;
+			int winners = 0;
+			for (size_t r = 0; r < players; r++)
+				winners += scores[r] == best;
+			const double weight = matchupWeights[m];
+			const double share = weight / winners;
+			for (size_t r = 0; r < players; r++)
+				if (scores[r] == best)
+					out.share[r] += share;
+			out.total += weight;
+		}
+	});
+
+	double total = 0;
+	result.equity.assign(players, 0.0);
+	for (const RunoutPartial& partial : partials)
+	{
+		for (size_t r = 0; r < players; r++)
+			result.equity[r] += partial.share[r];
+		total += partial.total;
+	}
+	for (double& equity : result.equity)
+		equity = total > 0 ? equity / total : 0.0;
+	result.matchups = matchupCount;
+	result.runouts = runouts.size();
+	result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::unique_lock<std::mutex> lock(s_rangeCacheMutex);
+	if (s_rangeCache.size() >= kRangeCacheLimit)
+		s_rangeCache.clear();
+	s_rangeCache[key] = result;
+	return result;
+}
+
+size_t EquityCalculator::RangeCacheSize()
+{
+	std::unique_lock<std::mutex> lock(s_rangeCacheMutex);
+	return s_rangeCache.size();
+}
+
+void EquityCalculator::ClearRangeCache()
+{
+	std::unique_lock<std::mutex> lock(s_rangeCacheMutex);
+	s_rangeCache.clear();
+}
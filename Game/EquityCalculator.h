@@ -0,0 +1,134 @@
+#pragma once
+#include "GameItem/CardSet.h"
+#include "GameItem/HandEvaluator.h"
+#include "GameItem/HandRange.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct EquityRequest
+{
+	CardSet hole{};            // exactly two cards
+	CardSet board{};           // 0 to 5 known community cards
+	CardSet dead{};            // cards known to be out of play (mucked, burnt)
+	int opponents = 1;         // random hands, 1 to 9
+	// stops at whichever comes first; the budget always applies, trials 0 means unlimited
+	std::chrono::milliseconds budget{ 50 };
+	uint64_t maxTrials = 0;
+	uint64_t seed = 0;         // 0 draws a fresh one
+	int threads = 0;           // 0 uses every worker of the pool
+};
+
+struct EquityResult
+{
+	uint64_t trials = 0;
+	uint64_t wins = 0;          // outright
+	uint64_t ties = 0;          // split with at least one opponent
+	uint64_t losses = 0;
+	double equity = 0;          // share of the pot won on average, a tie with k others counts 1/(k+1)
+	double equitySq = 0;        // sum of squared per-trial shares, for the interval
+	double elapsedMs = 0;
+	bool cancelled = false;
+
+	double WinRate() const { return trials ? (double)wins / trials : 0.0; }
+	double TieRate() const { return trials ? (double)ties / trials : 0.0; }
+	double LossRate() const { return trials ? (double)losses / trials : 0.0; }
+	double Equity() const { return trials ? equity / trials : 0.0; }
+	// half width of the 95% normal interval of a rate, and of the equity
+	static double Margin95(double rate, uint64_t trials);
+	double EquityMargin95() const;
+	// sums another worker's counts in, elapsed and cancelled are left to the caller
+	void Merge(const EquityResult& other);
+};
+
+// Known hands over every runout of the board, see EquityCalculator::Enumerate
+struct ExactEquity
+{
+	std::vector<double> equity;     // per hand in the order given, pot share averaged over the runouts
+	std::vector<uint64_t> wins;     // runouts won outright
+	std::vector<uint64_t> ties;     // runouts split with at least one other hand
+	uint64_t runouts = 0;
+	double elapsedMs = 0;
+};
+
+// Ranges against each other over every runout, see EquityCalculator::RangeVsRange
+struct RangeEquity
+{
+	std::string error;              // set instead of the rest when the ranges cannot be run
+	std::vector<double> equity;     // per range in the order given, weighted over matchups and runouts
+	std::vector<size_t> combos;     // per range, combos left once the board and dead cards are out
+	uint64_t matchups = 0;          // one combo from each range, no card shared
+	uint64_t runouts = 0;
+	double elapsedMs = 0;
+	bool cached = false;
+};
+
+// One Monte Carlo run in flight. The workers own a reference, so dropping the handle
+// never cuts a run short: Cancel does, and so does the time budget.
+class EquityJob
+{
+public:
+	void Cancel() { m_cancelled = true; }
+	bool Cancelled() const { return m_cancelled; }
+	bool Done() const;
+	// blocks until the workers are finished, at most about the budget
+	EquityResult Wait();
+	// Runs on the thread that finished the job, or right away if it is done already
+	void OnDone(std::function<void()> callback);
+
+private:
+	friend class EquityCalculator;
+
+	EquityRequest m_request;
+	HandEvaluator::ScoreMode m_scoreMode = HandEvaluator::ScoreMode::Compatible;   // the engine's, taken at Start
+	std::chrono::steady_clock::time_point m_startedAt{};
+	std::chrono::steady_clock::time_point m_deadline{};
+	std::atomic<bool> m_cancelled = false;
+	std::atomic<uint64_t> m_claimed = 0;    // trials handed out, only counted with maxTrials
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	int m_running = 0;                       // under m_mutex
+	EquityResult m_result;                   // under m_mutex
+	std::function<void()> m_onDone;          // under m_mutex
+
+	void RunWorker(uint64_t seed);
+	void Finish(const EquityResult& partial);
+};
+
+// Hand-vs-random-hands equity by Monte Carlo rollouts, spread over a pool of worker
+// threads that lives as long as the process. Every worker deals its own runouts from the
+// cards not in the request and scores them with HandEvaluator::Strength. Every mode below
+// ranks hands in the engine's ScoreMode at the time of the call, so on a Compatible table
+// equity agrees with its showdowns: a tie past the third kicker, the wheel over a six-high.
+class EquityCalculator
+{
+public:
+	// empty if the request can be run, the reason otherwise
+	static std::string Validate(const EquityRequest& request);
+	// nullptr for a request Validate rejects
+	static std::shared_ptr<EquityJob> Start(const EquityRequest& request);
+	// Start and Wait on the calling thread
+	static EquityResult Run(const EquityRequest& request);
+	static size_t WorkerCount();
+
+	// empty if the hands can be enumerated, the reason otherwise
+	static std::string ValidateExact(const std::vector<CardSet>& hands, CardSet board, CardSet dead);
+	// Every runout of the missing board cards, 1,712,304 of them preflop heads-up. Runouts are
+	// split by their first card over a WorkStealingPool (the calling thread helps) and scored
+	// with HandEvaluator::StrengthBatch. Blocks; an empty result for hands ValidateExact rejects.
+	static ExactEquity Enumerate(const std::vector<CardSet>& hands, CardSet board, CardSet dead = {}, bool parallel = true);
+
+	// 2 to 6 ranges on a board of 3 to 5 cards. Every card-compatible matchup is played
+	// over every runout: per runout each range's combos are scored once with
+	// HandEvaluator::StrengthBatch, then the matchups only compare strengths. Runouts are
+	// spread over the stealing pool. Results are cached per board, dead cards and ranges.
+	static RangeEquity RangeVsRange(const std::vector<HandRange>& ranges, CardSet board, CardSet dead = {});
+	static size_t RangeCacheSize();
+	static void ClearRangeCache();
+};
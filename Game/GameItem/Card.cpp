@@ -1,6 +1,20 @@
 #include "pch.h"
 #include "Card.h"
 #include "Net/NetPack.h"
+#include <cctype>
+
+Card Card::FromString(std::string_view text)
+{
+	static const std::string_view ranks = "23456789TJQKA";
+	static const std::string_view suits = "SHDC";
+	if (text.size() != 2)
+		return Card{};
+	const size_t rank = ranks.find((char)std::toupper((unsigned char)text[0]));
+	const size_t suit = suits.find((char)std::toupper((unsigned char)text[1]));
+	if (rank == std::string_view::npos || suit == std::string_view::npos)
+		return Card{};
+	return Card((uint8_t)(rank + RANK_MIN), (uint8_t)suit);
+}
 
 void Card::Write(NetPack& pack) const
 {
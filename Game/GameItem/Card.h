@@ -1,6 +1,7 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 class NetPack;
 
@@ -12,11 +13,13 @@ public:
 	static constexpr uint8_t SUIT_COUNT = 4;
 
 	Card() = default;
-	Card(uint8_t rank, uint8_t suit) : _rank(rank), _suit(suit) {}
+	constexpr Card(uint8_t rank, uint8_t suit) : _rank(rank), _suit(suit) {}
 
-	uint8_t Rank() const { return _rank; }
-	uint8_t Suit() const { return _suit; }
-	bool IsValid() const { return _rank >= RANK_MIN && _rank <= RANK_MAX && _suit < SUIT_COUNT; }
+	constexpr uint8_t Rank() const { return _rank; }
+	constexpr uint8_t Suit() const { return _suit; }
+	constexpr bool IsValid() const { return _rank >= RANK_MIN && _rank <= RANK_MAX && _suit < SUIT_COUNT; }
+	// "As", "td", "9H": rank 2-9/T/J/Q/K/A then suit s/h/d/c, any case. Invalid card on bad input.
+	static Card FromString(std::string_view text);
 
 	std::wstring ToString() const
 	{
@@ -0,0 +1,115 @@
+#pragma once
+#include "Card.h"
+#include <array>
+#include <bit>
+#include <cstdint>
+
+// A set of cards as one 64-bit mask: a 13-bit lane per suit, bit (suit * 13 + rank - 2),
+// so membership, union and counting are single instructions and a lane is exactly the
+// rank mask HandEvaluator works on. Invalid cards are never members.
+class CardSet
+{
+public:
+	static constexpr int LANE_BITS = 13;
+	static constexpr uint64_t LANE_MASK = (1ull << LANE_BITS) - 1;
+	static constexpr uint64_t FULL_MASK = (1ull << (LANE_BITS * Card::SUIT_COUNT)) - 1;
+
+	constexpr CardSet() = default;
+	constexpr explicit CardSet(uint64_t bits) : _bits(bits & FULL_MASK) {}
+	CardSet(std::initializer_list<Card> cards)
+	{
+		for (const Card& card : cards)
+			Add(card);
+	}
+
+	static constexpr CardSet Full() { return CardSet(FULL_MASK); }
+	// -1 for an invalid card
+	static constexpr int IndexOf(const Card& card)
+	{
+		return card.IsValid() ? card.Suit() * LANE_BITS + (card.Rank() - Card::RANK_MIN) : -1;
+	}
+	static Card CardAt(int index)
+	{
+		return Card((uint8_t)(index % LANE_BITS + Card::RANK_MIN), (uint8_t)(index / LANE_BITS));
+	}
+	static constexpr CardSet Of(const Card& card)
+	{
+		const int index = IndexOf(card);
+		return index < 0 ? CardSet() : CardSet(1ull << index);
+	}
+	// Concatenated cards, "AsKd" or "Ts9h2c"; "-" or empty is the empty set.
+	// False on a bad card or a card given twice.
+	static bool Parse(std::string_view text, CardSet& out)
+	{
+		out.Clear();
+		if (text == "-")
+			return true;
+		if (text.size() % 2 != 0)
+			return false;
+		for (size_t i = 0; i < text.size(); i += 2)
+		{
+			const Card card = Card::FromString(text.substr(i, 2));
+			if (!card.IsValid() || out.Contains(card))
+				return false;
+			out.Add(card);
+		}
+		return true;
+	}
+
+	constexpr uint64_t Bits() const { return _bits; }
+	constexpr int Count() const { return std::popcount(_bits); }
+	constexpr bool Empty() const { return _bits == 0; }
+	constexpr bool Contains(const Card& card) const { return (_bits & Of(card)._bits) != 0; }
+	constexpr bool ContainsAll(CardSet other) const { return (_bits & other._bits) == other._bits; }
+	constexpr bool Intersects(CardSet other) const { return (_bits & other._bits) != 0; }
+
+	void Add(const Card& card) { _bits |= Of(card)._bits; }
+	void Remove(const Card& card) { _bits &= ~Of(card)._bits; }
+	void Clear() { _bits = 0; }
+
+	// rank mask of one suit, bit (rank - 2)
+	constexpr uint16_t Suit(int suit) const { return (uint16_t)((_bits >> (suit * LANE_BITS)) & LANE_MASK); }
+	constexpr std::array<uint16_t, Card::SUIT_COUNT> Lanes() const { return { Suit(0), Suit(1), Suit(2), Suit(3) }; }
+	// ranks present in any suit
+	constexpr uint16_t Ranks() const { return (uint16_t)(Suit(0) | Suit(1) | Suit(2) | Suit(3)); }
+
+	// the n-th member in index order, n < Count(): a popcount per lane, then n clears of the lowest bit
+	Card Nth(int n) const
+	{
+		int lane = 0;
+		uint64_t bits = Suit(0);
+		for (int count = std::popcount(bits); n >= count && lane < Card::SUIT_COUNT - 1; count = std::popcount(bits))
+		{
+			n -= count;
+			bits = Suit(++lane);
+		}
+		for (; n > 0; n--)
+			bits &= bits - 1;
+		return CardAt(lane * LANE_BITS + std::countr_zero(bits));
+	}
+	// removes and returns the lowest member, the set must not be empty
+	Card PopLowest()
+	{
+		const int index = std::countr_zero(_bits);
+		_bits &= _bits - 1;
+		return CardAt(index);
+	}
+	template <typename Func>
+	void ForEach(Func func) const
+	{
+		for (uint64_t bits = _bits; bits != 0; bits &= bits - 1)
+			func(CardAt(std::countr_zero(bits)));
+	}
+
+	constexpr CardSet operator|(CardSet other) const { return CardSet(_bits | other._bits); }
+	constexpr CardSet operator&(CardSet other) const { return CardSet(_bits & other._bits); }
+	// set difference
+	constexpr CardSet operator-(CardSet other) const { return CardSet(_bits & ~other._bits); }
+	CardSet& operator|=(CardSet other) { _bits |= other._bits; return *this; }
+	CardSet& operator&=(CardSet other) { _bits &= other._bits; return *this; }
+	CardSet& operator-=(CardSet other) { _bits &= ~other._bits; return *this; }
+	constexpr bool operator==(const CardSet& other) const { return _bits == other._bits; }
+
+private:
+	uint64_t _bits = 0;
+};
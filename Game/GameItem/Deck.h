@@ -1,39 +1,32 @@
 #pragma once
-#include "Card.h"
-#include <vector>
-#include <random>
+#include "CardSet.h"
+#include "Rng.h"
 
+// The undealt cards as a CardSet. Drawing picks a uniformly random member, the same
+// distribution as shuffling the whole deck and dealing from the top, without moving
+// 52 cards around first.
 class Deck
 {
 public:
 	Deck() { Reset52(); }
 
-	void Reset52()
-	{
-		_cards.clear();
-		_cards.reserve(52);
-		for (uint8_t suit = 0; suit < Card::SUIT_COUNT; ++suit)
-			for (uint8_t rank = Card::RANK_MIN; rank <= Card::RANK_MAX; ++rank)
-				_cards.emplace_back(rank, suit);
-	}
-
-	void Shuffle(std::mt19937& rng)
-	{
-		std::shuffle(_cards.begin(), _cards.end(), rng);
-	}
+	void Reset52() { _cards = CardSet::Full(); }
+	// cards known to be elsewhere (dead cards, fixed boards) never come out
+	void Remove(CardSet cards) { _cards -= cards; }
 
-	Card Draw()
+	Card Draw(DeckRng& rng)
 	{
-		if (_cards.empty())
+		if (_cards.Empty())
 			return Card{};
-		Card c = _cards.back();
-		_cards.pop_back();
+		Card c = _cards.Nth((int)rng.Below((uint32_t)_cards.Count()));
+		_cards.Remove(c);
 		return c;
 	}
 
-	size_t Size() const { return _cards.size(); }
-	bool Empty() const { return _cards.empty(); }
+	CardSet Remaining() const { return _cards; }
+	size_t Size() const { return (size_t)_cards.Count(); }
+	bool Empty() const { return _cards.Empty(); }
 
 private:
-	std::vector<Card> _cards{};
+	CardSet _cards{};
 };
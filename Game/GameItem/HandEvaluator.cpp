@@ -0,0 +1,394 @@
+#include "pch.h"
+#include "HandEvaluator.h"
+#include <bit>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define HAND_EVALUATOR_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles AVX2 intrinsics anywhere, the caller checks the CPU first
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+#endif
+
+HandEvaluator::ScoreMode HandEvaluator::s_scoreMode = HandEvaluator::ScoreMode::Compatible;
+HandEvaluator::BatchPath HandEvaluator::s_batchPath = HandEvaluator::BatchPath::Auto;
+
+namespace
+{
+	constexpr int kRankMasks = 1 << 13;     // one bit per rank, 2 = bit 0 ... ace = bit 12
+
+	struct RankTables
+	{
+		// high rank of the best straight in a rank mask, 5 for the wheel, 0 for none.
+		// 3 spare bytes: the batch path gathers 4 bytes per entry.
+		std::array<uint8_t, kRankMasks + 3> straight{};
+		// the five highest ranks of a mask, a nibble each, highest in bits 16..19
+		std::array<uint32_t, kRankMasks> topFive{};
+		// set bits, cheaper than a popcount without the instruction
+		std::array<uint8_t, kRankMasks> count{};
+
+		RankTables()
+		{
+			for (int mask = 0; mask < kRankMasks; mask++)
+			{
+				uint32_t packed = 0;
+				int taken = 0;
+				for (int bit = 12; bit >= 0 && taken < 5; bit--)
+				{
+					if (mask & (1 << bit))
+					{
+						packed |= (uint32_t)(bit + 2) << (4 * (4 - taken));
+						taken++;
+					}
+				}
+				topFive[mask] = packed;
+				count[mask] = (uint8_t)std::popcount((uint32_t)mask);
+
+				for (int high = 12; high >= 4; high--)
+				{
+					const int run = 0x1F << (high - 4);
+					if ((mask & run) == run)
+					{
+						straight[mask] = (uint8_t)(high + 2);
+						break;
+					}
+				}
+				// A-2-3-4-5
+				if (straight[mask] == 0 && (mask & 0x100F) == 0x100F)
+					straight[mask] = 5;
+			}
+		}
+	};
+
+	// built on first use, well under a millisecond, 48 KB
+	const RankTables& Tables()
+	{
+		static const RankTables tables;
+		return tables;
+	}
+
+	constexpr uint32_t Pack(HandEvaluator::HandRank rank, uint32_t tiebreak)
+	{
+		return ((uint32_t)rank << 20) | tiebreak;
+	}
+
+	// top n ranks of a mask, packed from bits 16..19 down like topFive
+	inline uint32_t Top(const RankTables& tables, uint32_t mask, int n)
+	{
+		const uint32_t keep = 0xFFFFFu << (4 * (5 - n));
+		return tables.topFive[mask] & keep;
+	}
+
+	inline uint32_t HighestBit(uint32_t mask)
+	{
+		return 1u << (std::bit_width(mask) - 1);
+	}
+
+	inline uint32_t RankOf(uint32_t bit)
+	{
+		return (uint32_t)std::bit_width(bit) + 1;
+	}
+}
+
+uint32_t HandEvaluator::Strength(const std::array<uint16_t, 4>& suits)
+{
+	const RankTables& tables = Tables();
+	const uint32_t s0 = suits[0], s1 = suits[1], s2 = suits[2], s3 = suits[3];
+	const uint32_t all = s0 | s1 | s2 | s3;
+
+	// seven cards hold at most one flush, and then no quads or full house
+	for (uint32_t suit : { s0, s1, s2, s3 })
+	{
+		if (tables.count[suit] < 5)
+			continue;
+		const uint32_t high = tables.straight[suit];
+		if (high == 14)
+			return Pack(HandRank::RoyalFlush, 14u << 16);
+		if (high != 0)
+			return Pack(HandRank::StraightFlush, high << 16);
+		return Pack(HandRank::Flush, tables.topFive[suit]);
+	}
+
+	const uint32_t quads = s0 & s1 & s2 & s3;
+	if (quads != 0)
+	{
+		const uint32_t quad = HighestBit(quads);
+		return Pack(HandRank::FourOfAKind, (RankOf(quad) << 16) | (Top(tables, all & ~quad, 1) >> 4));
+	}
+
+	// three or four of a suit set, then two or more (odd counts drop out of the xor)
+	const uint32_t threes = ((s0 & s1) | (s2 & s3)) & ((s0 & s2) | (s1 & s3));
+	const uint32_t pairs = (all ^ (s0 ^ s1 ^ s2 ^ s3)) | threes;
+	if (threes != 0)
+	{
+		const uint32_t trip = HighestBit(threes);
+		const uint32_t others = pairs & ~trip;
+		if (others != 0)
+			return Pack(HandRank::FullHouse, (RankOf(trip) << 16) | (RankOf(HighestBit(others)) << 12));
+	}
+
+	if (const uint32_t high = tables.straight[all]; high != 0)
+		return Pack(HandRank::Straight, high << 16);
+
+	if (threes != 0)
+	{
+		const uint32_t trip = HighestBit(threes);
+		return Pack(HandRank::ThreeOfAKind, (RankOf(trip) << 16) | (Top(tables, all & ~trip, 2) >> 4));
+	}
+
+	if (pairs != 0)
+	{
+		const uint32_t first = HighestBit(pairs);
+		const uint32_t rest = pairs & ~first;
+		if (rest != 0)
+		{
+			// a third pair can only be the kicker
+			const uint32_t second = HighestBit(rest);
+			return Pack(HandRank::TwoPair, (RankOf(first) << 16) | (RankOf(second) << 12)
+				| (Top(tables, all & ~(first | second), 1) >> 8));
+		}
+		return Pack(HandRank::OnePair, (RankOf(first) << 16) | (Top(tables, all & ~first, 3) >> 4));
+	}
+
+	return Pack(HandRank::HighCard, tables.topFive[all]);
+}
+
+int HandEvaluator::ToScore(uint32_t strength, ScoreMode mode)
+{
+	int rank = (int)(strength >> 20);
+	int k1 = (strength >> 16) & 0xF;
+	const int k2 = (strength >> 12) & 0xF;
+	const int k3 = (strength >> 8) & 0xF;
+	if (mode == ScoreMode::Exact)
+	{
+		const int k4 = (strength >> 4) & 0xF;
+		const int k5 = strength & 0xF;
+		return rank * 10000000 + (((k1 * 15 + k2) * 15 + k3) * 15 + k4) * 15 + k5;
+	}
+	// the original evaluator found the wheel as an ace-high run
+	if (k1 == 5 && (rank == (int)HandRank::Straight || rank == (int)HandRank::StraightFlush))
+	{
+		k1 = 14;
+		if (rank == (int)HandRank::StraightFlush)
+			rank = (int)HandRank::RoyalFlush;
+	}
+	return rank * 10000000 + k1 * 100000 + k2 * 1000 + k3 * 10;
+}
+
+int HandEvaluator::Evaluate(const std::array<Card, 7>& cards)
+{
+	return Evaluate(cards, s_scoreMode);
+}
+
+int HandEvaluator::Evaluate(const std::array<Card, 7>& cards, ScoreMode mode)
+{
+	CardSet set;
+	for (const Card& card : cards)
+		set.Add(card);
+	return Evaluate(set, mode);
+}
+
+namespace
+{
+	void StrengthBatchScalar(const std::array<const uint16_t*, 4>& suits, size_t begin, size_t count, uint32_t* strengths)
+	{
+		for (size_t i = begin; i < count; i++)
+			strengths[i] = HandEvaluator::Strength({ suits[0][i], suits[1][i], suits[2][i], suits[3][i] });
+	}
+
+#if HAND_EVALUATOR_AVX2
+	bool CpuHasAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+		__cpuid(info, 1);
+		// AVX and OSXSAVE, then the OS has to save the ymm registers
+		if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	AVX2_FUNCTION inline __m256i PopCount13(__m256i x)
+	{
+		x = _mm256_sub_epi32(x, _mm256_and_si256(_mm256_srli_epi32(x, 1), _mm256_set1_epi32(0x55555555)));
+		x = _mm256_add_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0x33333333)),
+			_mm256_and_si256(_mm256_srli_epi32(x, 2), _mm256_set1_epi32(0x33333333)));
+		x = _mm256_and_si256(_mm256_add_epi32(x, _mm256_srli_epi32(x, 4)), _mm256_set1_epi32(0x0F0F0F0F));
+		// 13 bits span two bytes
+		return _mm256_and_si256(_mm256_add_epi32(x, _mm256_srli_epi32(x, 8)), _mm256_set1_epi32(0x1F));
+	}
+
+	// index of the highest set bit from the float exponent, exact below 2^24; negative for 0,
+	// which makes the shifted bit below come out 0 as well
+	AVX2_FUNCTION inline __m256i HighestIndex(__m256i x)
+	{
+		const __m256i exponent = _mm256_srli_epi32(_mm256_castps_si256(_mm256_cvtepi32_ps(x)), 23);
+		return _mm256_sub_epi32(exponent, _mm256_set1_epi32(127));
+	}
+
+	// rank of the highest member, 0 for an empty mask
+	AVX2_FUNCTION inline __m256i HighestRank(__m256i x)
+	{
+		const __m256i nonEmpty = _mm256_cmpgt_epi32(x, _mm256_setzero_si256());
+		return _mm256_and_si256(_mm256_add_epi32(HighestIndex(x), _mm256_set1_epi32(2)), nonEmpty);
+	}
+
+	AVX2_FUNCTION inline __m256i Category(HandEvaluator::HandRank rank)
+	{
+		return _mm256_set1_epi32((int)rank << 20);
+	}
+
+	// Strength for eight hands at once: every category is built branch-free and the best
+	// applicable one wins, blended in the same precedence the scalar code tests them in.
+	// The tables are gathered three times per eight hands.
+	AVX2_FUNCTION void StrengthBatchAvx2(const std::array<const uint16_t*, 4>& suits, size_t count, uint32_t* strengths)
+	{
+		const RankTables& tables = Tables();
+		const int* topFive = (const int*)tables.topFive.data();
+		const int* straight = (const int*)tables.straight.data();
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256i byteMask = _mm256_set1_epi32(0xFF);
+		const __m256i four = _mm256_set1_epi32(4);
+		const __m256i fourteen = _mm256_set1_epi32(14);
+		auto nonZero = [&zero](__m256i x) AVX2_FUNCTION { return _mm256_cmpgt_epi32(x, zero); };
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256i s0 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(suits[0] + i)));
+			const __m256i s1 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(suits[1] + i)));
+			const __m256i s2 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(suits[2] + i)));
+			const __m256i s3 = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(suits[3] + i)));
+			const __m256i all = _mm256_or_si256(_mm256_or_si256(s0, s1), _mm256_or_si256(s2, s3));
+
+			// the flush suit if there is one; with a flush nothing below it can win, so the
+			// straight and top-five lookups are done on the flush suit instead of on all ranks
+			__m256i flush = _mm256_and_si256(s0, _mm256_cmpgt_epi32(PopCount13(s0), four));
+			flush = _mm256_or_si256(flush, _mm256_and_si256(s1, _mm256_cmpgt_epi32(PopCount13(s1), four)));
+			flush = _mm256_or_si256(flush, _mm256_and_si256(s2, _mm256_cmpgt_epi32(PopCount13(s2), four)));
+			flush = _mm256_or_si256(flush, _mm256_and_si256(s3, _mm256_cmpgt_epi32(PopCount13(s3), four)));
+			const __m256i hasFlush = nonZero(flush);
+			const __m256i key = _mm256_blendv_epi8(all, flush, hasFlush);
+			const __m256i high = _mm256_and_si256(_mm256_i32gather_epi32(straight, key, 1), byteMask);
+			const __m256i top = _mm256_i32gather_epi32(topFive, key, 4);
+			const __m256i hasStraight = nonZero(high);
+
+			const __m256i quads = _mm256_and_si256(_mm256_and_si256(s0, s1), _mm256_and_si256(s2, s3));
+			const __m256i quadIndex = HighestIndex(quads);
+			const __m256i quadBit = _mm256_sllv_epi32(one, quadIndex);
+			const __m256i quadKicker = HighestRank(_mm256_andnot_si256(quadBit, all));
+
+			const __m256i threes = _mm256_and_si256(_mm256_or_si256(_mm256_and_si256(s0, s1), _mm256_and_si256(s2, s3)),
+				_mm256_or_si256(_mm256_and_si256(s0, s2), _mm256_and_si256(s1, s3)));
+			const __m256i odd = _mm256_xor_si256(_mm256_xor_si256(s0, s1), _mm256_xor_si256(s2, s3));
+			const __m256i pairs = _mm256_or_si256(_mm256_xor_si256(all, odd), threes);
+			const __m256i hasThrees = nonZero(threes);
+			const __m256i tripIndex = HighestIndex(threes);
+			const __m256i tripBit = _mm256_sllv_epi32(one, tripIndex);
+			const __m256i tripRank = _mm256_and_si256(_mm256_add_epi32(tripIndex, _mm256_set1_epi32(2)), hasThrees);
+			const __m256i others = _mm256_andnot_si256(tripBit, pairs);
+
+			const __m256i firstIndex = HighestIndex(pairs);
+			const __m256i firstBit = _mm256_sllv_epi32(one, firstIndex);
+			const __m256i firstRank = HighestRank(pairs);
+			const __m256i rest = _mm256_andnot_si256(firstBit, pairs);
+			const __m256i secondBit = _mm256_sllv_epi32(one, HighestIndex(rest));
+			const __m256i twoPairKicker = HighestRank(_mm256_andnot_si256(_mm256_or_si256(firstBit, secondBit), all));
+
+			// trips and one pair never apply together, they share one kicker lookup
+			const __m256i kickerKey = _mm256_blendv_epi8(_mm256_andnot_si256(firstBit, all), _mm256_andnot_si256(tripBit, all), hasThrees);
+			const __m256i kickers = _mm256_i32gather_epi32(topFive, kickerKey, 4);
+
+			__m256i result = top;   // high card
+			result = _mm256_blendv_epi8(result, _mm256_or_si256(Category(HandEvaluator::HandRank::OnePair),
+				_mm256_or_si256(_mm256_slli_epi32(firstRank, 16), _mm256_srli_epi32(_mm256_and_si256(kickers, _mm256_set1_epi32(0xFFF00)), 4))),
+				nonZero(pairs));
+			result = _mm256_blendv_epi8(result, _mm256_or_si256(Category(HandEvaluator::HandRank::TwoPair),
+				_mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(firstRank, 16), _mm256_slli_epi32(HighestRank(rest), 12)),
+					_mm256_slli_epi32(twoPairKicker, 8))),
+				nonZero(rest));
+			result = _mm256_blendv_epi8(result, _mm256_or_si256(Category(HandEvaluator::HandRank::ThreeOfAKind),
+				_mm256_or_si256(_mm256_slli_epi32(tripRank, 16), _mm256_srli_epi32(_mm256_and_si256(kickers, _mm256_set1_epi32(0xFF000)), 4))),
+				hasThrees);
+			result = _mm256_blendv_epi8(result, _mm256_or_si256(Category(HandEvaluator::HandRank::Straight), _mm256_slli_epi32(high, 16)),
+				hasStraight);
+			result = _mm256_blendv_epi8(result, _mm256_or_si256(Category(HandEvaluator::HandRank::FullHouse),
+				_mm256_or_si256(_mm256_slli_epi32(tripRank, 16), _mm256_slli_epi32(HighestRank(others), 12))),
+				_mm256_and_si256(hasThrees, nonZero(others)));
+			result = _mm256_blendv_epi8(result, _mm256_or_si256(Category(HandEvaluator::HandRank::FourOfAKind),
+				_mm256_or_si256(_mm256_slli_epi32(HighestRank(quads), 16), _mm256_slli_epi32(quadKicker, 12))),
+				nonZero(quads));
+			result = _mm256_blendv_epi8(result, _mm256_or_si256(Category(HandEvaluator::HandRank::Flush), top), hasFlush);
+			const __m256i royal = _mm256_cmpeq_epi32(high, fourteen);
+			const __m256i straightFlush = _mm256_or_si256(
+				_mm256_blendv_epi8(Category(HandEvaluator::HandRank::StraightFlush), Category(HandEvaluator::HandRank::RoyalFlush), royal),
+				_mm256_slli_epi32(high, 16));
+			result = _mm256_blendv_epi8(result, straightFlush, _mm256_and_si256(hasFlush, hasStraight));
+
+			_mm256_storeu_si256((__m256i*)(strengths + i), result);
+		}
+		StrengthBatchScalar(suits, i, count, strengths);
+	}
+#endif
+}
+
+HandEvaluator::BatchPath HandEvaluator::ActiveBatchPath()
+{
+#if HAND_EVALUATOR_AVX2
+	static const bool avx2 = CpuHasAvx2();
+	if (avx2 && s_batchPath != BatchPath::Scalar)
+		return BatchPath::Avx2;
+#endif
+	return BatchPath::Scalar;
+}
+
+void HandEvaluator::StrengthBatch(const std::array<const uint16_t*, 4>& suits, size_t count, uint32_t* strengths)
+{
+#if HAND_EVALUATOR_AVX2
+	if (ActiveBatchPath() == BatchPath::Avx2)
+	{
+		StrengthBatchAvx2(suits, count, strengths);
+		return;
+	}
+#endif
+	StrengthBatchScalar(suits, 0, count, strengths);
+}
+
+void HandEvaluator::EvaluateBatch(const std::array<const uint16_t*, 4>& suits, size_t count, int* scores, ScoreMode mode)
+{
+	static_assert(sizeof(int) == sizeof(uint32_t), "scores double as the strength buffer");
+	uint32_t* strengths = (uint32_t*)scores;
+	StrengthBatch(suits, count, strengths);
+	for (size_t i = 0; i < count; i++)
+		scores[i] = ToScore(strengths[i], mode);
+}
+
+void HandEvaluator::EvaluateBatch(CardSet board, const CardSet* holes, size_t count, int* scores, ScoreMode mode)
+{
+	// transposed a chunk at a time so the lanes stay in L1
+	constexpr size_t kChunk = 256;
+	std::array<std::array<uint16_t, kChunk>, 4> lanes;
+	for (size_t begin = 0; begin < count; begin += kChunk)
+	{
+		const size_t n = std::min(kChunk, count - begin);
+		for (size_t i = 0; i < n; i++)
+		{
+			const CardSet hand = board | holes[begin + i];
+			for (int s = 0; s < 4; s++)
+				lanes[s][i] = hand.Suit(s);
+		}
+		EvaluateBatch({ lanes[0].data(), lanes[1].data(), lanes[2].data(), lanes[3].data() }, n, scores + begin, mode);
+	}
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "Card.h"
+#include "CardSet.h"
 #include <array>
+#include <cstdint>
 #include <vector>
 #include <algorithm>
 
@@ -24,9 +26,52 @@ public:
 		RoyalFlush = 9
 	};
 
-	// Returns a score where higher is better
-	// Format: (HandRank * 10000000) + tiebreakers
-	static int Evaluate(const std::array<Card, 7>& cards)
+	// Score encodings, both (HandRank * 10000000) + tiebreakers so ParseScore reads either
+	enum class ScoreMode : uint8_t
+	{
+		// what Evaluate always returned: three tiebreakers (k1*100000 + k2*1000 + k3*10),
+		// the wheel counts as an ace-high straight and its straight flush as royal
+		Compatible = 0,
+		// every tiebreaker that decides a showdown (five for flush/high card, base 15),
+		// the wheel is a five-high straight
+		Exact = 1,
+	};
+	static void SetScoreMode(ScoreMode mode) { s_scoreMode = mode; }
+	static ScoreMode GetScoreMode() { return s_scoreMode; }
+
+	// Returns a score where higher is better, in the current ScoreMode.
+	// Table driven: no sorting and no allocation, invalid cards (unfinished board) are skipped.
+	static int Evaluate(const std::array<Card, 7>& cards);
+	static int Evaluate(const std::array<Card, 7>& cards, ScoreMode mode);
+	// up to seven cards, the suit lanes go straight into the tables
+	static int Evaluate(CardSet cards) { return ToScore(Strength(cards.Lanes()), s_scoreMode); }
+	static int Evaluate(CardSet cards, ScoreMode mode) { return ToScore(Strength(cards.Lanes()), mode); }
+
+	// Packed strength, the core of Evaluate: HandRank << 20, then up to five tiebreak ranks
+	// a nibble each, highest first. Plain integer order is showdown order (Exact semantics).
+	// suits[s] has bit (rank - 2) set for every card of suit s, CardSet::Lanes().
+	static uint32_t Strength(const std::array<uint16_t, 4>& suits);
+	static int ToScore(uint32_t strength, ScoreMode mode);
+
+	// Batch evaluation over structure-of-arrays input: hand i is suits[0][i] .. suits[3][i],
+	// up to seven cards each. Identical results to Strength, eight hands per step on AVX2.
+	enum class BatchPath : uint8_t
+	{
+		Auto = 0,        // AVX2 when the CPU and OS support it
+		Scalar = 1,
+		Avx2 = 2,        // falls back to scalar where unsupported
+	};
+	static void SetBatchPath(BatchPath path) { s_batchPath = path; }
+	// what Auto resolves to on this machine
+	static BatchPath ActiveBatchPath();
+	static void StrengthBatch(const std::array<const uint16_t*, 4>& suits, size_t count, uint32_t* strengths);
+	static void EvaluateBatch(const std::array<const uint16_t*, 4>& suits, size_t count, int* scores, ScoreMode mode);
+	// one board against many hole-card sets, scores[i] for board | holes[i]
+	static void EvaluateBatch(CardSet board, const CardSet* holes, size_t count, int* scores, ScoreMode mode);
+
+	// The original sort-and-count evaluator, kept as the reference the tables are checked
+	// against (BENCH EVAL). Compatible encoding.
+	static int EvaluateReference(const std::array<Card, 7>& cards)
 	{
 		std::array<Card, 7> sorted = cards;
 		std::sort(sorted.begin(), sorted.end(), [](const Card& a, const Card& b) {
@@ -229,6 +274,9 @@ public:
 	}
 
 private:
+	static ScoreMode s_scoreMode;
+	static BatchPath s_batchPath;
+
 	static int Score(HandRank rank, const std::vector<int>& kickers)
 	{
 		int score = static_cast<int>(rank) * 10000000;
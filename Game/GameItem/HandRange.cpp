@@ -0,0 +1,215 @@
+#include "pch.h"
+#include "HandRange.h"
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#undef min
+#undef max
+
+namespace
+{
+	enum class Shape
+	{
+		Pair,
+		Suited,
+		Offsuit,
+		Any
+	};
+
+	// one hand class: QQ, AKs, AKo, AK
+	struct HandClass
+	{
+		int high = 0;
+		int low = 0;
+		Shape shape = Shape::Any;
+	};
+
+	int RankOf(char c)
+	{
+		static const char ranks[] = "23456789TJQKA";
+		const char* found = std::strchr(ranks, std::toupper((unsigned char)c));
+		return c != '\0' && found ? (int)(found - ranks) + Card::RANK_MIN : -1;
+	}
+
+	std::string_view Trim(std::string_view text)
+	{
+		while (!text.empty() && std::isspace((unsigned char)text.front()))
+			text.remove_prefix(1);
+		while (!text.empty() && std::isspace((unsigned char)text.back()))
+			text.remove_suffix(1);
+		return text;
+	}
+
+	bool ParseClass(std::string_view text, HandClass& out)
+	{
+		if (text.size() < 2 || text.size() > 3)
+			return false;
+		out.high = RankOf(text[0]);
+		out.low = RankOf(text[1]);
+		if (out.high < 0 || out.low < 0)
+			return false;
+		if (out.high < out.low)
+			std::swap(out.high, out.low);
+		if (out.high == out.low)
+		{
+			out.shape = Shape::Pair;
+			return text.size() == 2;
+		}
+		if (text.size() == 2)
+		{
+			out.shape = Shape::Any;
+			return true;
+		}
+		const char suffix = (char)std::tolower((unsigned char)text[2]);
+		out.shape = suffix == 's' ? Shape::Suited : Shape::Offsuit;
+		return suffix == 's' || suffix == 'o';
+	}
+
+	void AddClass(int high, int low, Shape shape, float weight, std::map<uint64_t, float>& combos)
+	{
+		for (uint8_t s1 = 0; s1 < Card::SUIT_COUNT; s1++)
+		{
+			for (uint8_t s2 = 0; s2 < Card::SUIT_COUNT; s2++)
+			{
+				if (shape == Shape::Pair ? s1 >= s2
+					: (shape == Shape::Suited && s1 != s2) || (shape == Shape::Offsuit && s1 == s2))
+					continue;
+				const CardSet cards{ Card((uint8_t)high, s1), Card((uint8_t)low, s2) };
+				combos[cards.Bits()] = weight;
+			}
+		}
+	}
+
+	bool ParsePart(std::string_view part, float weight, std::map<uint64_t, float>& combos)
+	{
+		// one exact combo
+		if (part.size() == 4)
+		{
+			const Card first = Card::FromString(part.substr(0, 2));
+			const Card second = Card::FromString(part.substr(2, 2));
+			if (first.IsValid() && second.IsValid())
+			{
+				if (first == second)
+					return false;
+				combos[CardSet{ first, second }.Bits()] = weight;
+				return true;
+			}
+		}
+
+		HandClass from, to;
+		const size_t dash = part.find('-');
+		if (dash != std::string_view::npos)
+		{
+			if (!ParseClass(part.substr(0, dash), from) || !ParseClass(part.substr(dash + 1), to) || from.shape != to.shape)
+				return false;
+			if (from.shape == Shape::Pair)
+			{
+				for (int rank = std::min(from.high, to.high); rank <= std::max(from.high, to.high); rank++)
+					AddClass(rank, rank, Shape::Pair, weight, combos);
+				return true;
+			}
+			if (from.high == to.high)
+			{
+				for (int kicker = std::min(from.low, to.low); kicker <= std::max(from.low, to.low); kicker++)
+					AddClass(from.high, kicker, from.shape, weight, combos);
+				return true;
+			}
+			if (from.high - from.low != to.high - to.low)
+				return false;
+			const int gap = from.high - from.low;
+			for (int high = std::min(from.high, to.high); high <= std::max(from.high, to.high); high++)
+				AddClass(high, high - gap, from.shape, weight, combos);
+			return true;
+		}
+
+		const bool andUp = !part.empty() && part.back() == '+';
+		if (andUp)
+			part.remove_suffix(1);
+		if (!ParseClass(part, from))
+			return false;
+		if (!andUp)
+			AddClass(from.high, from.low, from.shape, weight, combos);
+		else if (from.shape == Shape::Pair)
+			for (int rank = from.high; rank <= Card::RANK_MAX; rank++)
+				AddClass(rank, rank, Shape::Pair, weight, combos);
+		else
+			for (int kicker = from.low; kicker < from.high; kicker++)
+				AddClass(from.high, kicker, from.shape, weight, combos);
+		return true;
+	}
+}
+
+bool HandRange::Parse(std::string_view text, HandRange& out, std::string& error)
+{
+	out.m_combos.clear();
+	std::map<uint64_t, float> combos;
+	while (!text.empty())
+	{
+		const size_t comma = text.find(',');
+		std::string_view part = Trim(text.substr(0, comma));
+		text = comma == std::string_view::npos ? std::string_view{} : text.substr(comma + 1);
+		if (part.empty())
+			continue;
+
+		float weight = 1.0f;
+		const size_t colon = part.find(':');
+		if (colon != std::string_view::npos)
+		{
+			const std::string number(part.substr(colon + 1));
+			char* end = nullptr;
+			weight = std::strtof(number.c_str(), &end);
+			if (number.empty() || *end != '\0' || !std::isfinite(weight) || weight <= 0.0f)
+			{
+				error = "bad weight in \"" + std::string(part) + "\"";
+				return false;
+			}
+			part = Trim(part.substr(0, colon));
+		}
+		if (!ParsePart(part, weight, combos))
+		{
+			error = "bad range part \"" + std::string(part) + "\"";
+			return false;
+		}
+	}
+	if (combos.empty())
+	{
+		error = "empty range";
+		return false;
+	}
+
+	out.m_combos.reserve(combos.size());
+	for (const auto& [bits, weight] : combos)
+		out.m_combos.push_back(Combo{ CardSet(bits), weight });
+	return true;
+}
+
+double HandRange::TotalWeight() const
+{
+	double total = 0;
+	for (const Combo& combo : m_combos)
+		total += combo.weight;
+	return total;
+}
+
+uint64_t HandRange::Fingerprint() const
+{
+	// FNV-1a over the masks and the weights' bit patterns
+	uint64_t hash = 0xCBF29CE484222325ull;
+	auto mix = [&hash](uint64_t value) {
+		for (int i = 0; i < 8; i++)
+		{
+			hash ^= (value >> (i * 8)) & 0xFF;
+			hash *= 0x100000001B3ull;
+		}
+	};
+	for (const Combo& combo : m_combos)
+	{
+		uint32_t weightBits = 0;
+		std::memcpy(&weightBits, &combo.weight, sizeof(weightBits));
+		mix(combo.cards.Bits());
+		mix(weightBits);
+	}
+	return hash;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "CardSet.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A weighted list of two-card combos, parsed from the usual shorthand:
+//   QQ   QQ+   22-55          pairs: one, that one and up, an inclusive span
+//   AKs  AKo   AK             suited (4 combos), offsuit (12), either (16)
+//   ATs+ KTo-K7o              kicker up to one below the top card, a kicker span
+//   T9s-76s                   connectors (any fixed gap) stepping down together
+//   AhKh                      one exact combo
+//   A5s:0.5                   any of the above with a weight, 1 when left out
+// separated by commas. A combo listed twice keeps the last weight given.
+class HandRange
+{
+public:
+	struct Combo
+	{
+		CardSet cards{};
+		float weight = 1.0f;
+	};
+
+	// false with the offending part in error on bad input; out is left empty then
+	static bool Parse(std::string_view text, HandRange& out, std::string& error);
+
+	// ordered by card mask, so equal ranges list their combos in the same order
+	const std::vector<Combo>& Combos() const { return m_combos; }
+	size_t Size() const { return m_combos.size(); }
+	double TotalWeight() const;
+	// equal for equal combos and weights, used as a cache key
+	uint64_t Fingerprint() const;
+
+private:
+	std::vector<Combo> m_combos;
+};
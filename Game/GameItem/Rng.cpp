@@ -0,0 +1,152 @@
+#include "pch.h"
+#include "Rng.h"
+#include <atomic>
+#include <random>
+
+namespace
+{
+	uint64_t SplitMix64(uint64_t& state)
+	{
+		uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	uint32_t Rotl32(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+
+	void QuarterRound(std::array<uint32_t, 16>& x, int a, int b, int c, int d)
+	{
+		x[a] += x[b]; x[d] = Rotl32(x[d] ^ x[a], 16);
+		x[c] += x[d]; x[b] = Rotl32(x[b] ^ x[c], 12);
+		x[a] += x[b]; x[d] = Rotl32(x[d] ^ x[a], 8);
+		x[c] += x[d]; x[b] = Rotl32(x[b] ^ x[c], 7);
+	}
+
+	std::atomic<RngPolicy> s_defaultPolicy = RngPolicy::Secure;
+	std::atomic<uint64_t> s_replaySeed = 0;
+	std::atomic<uint64_t> s_replayCount = 0;   // generators seeded from the replay seed so far
+}
+
+void Xoshiro256::Seed(uint64_t seed)
+{
+	for (uint64_t& word : m_s)
+		word = SplitMix64(seed);
+}
+
+void ChaCha20::Block(const std::array<uint32_t, 16>& input, std::array<uint32_t, 16>& output)
+{
+	output = input;
+	for (int round = 0; round < 10; round++)
+	{
+		QuarterRound(output, 0, 4, 8, 12);
+		QuarterRound(output, 1, 5, 9, 13);
+		QuarterRound(output, 2, 6, 10, 14);
+		QuarterRound(output, 3, 7, 11, 15);
+		QuarterRound(output, 0, 5, 10, 15);
+		QuarterRound(output, 1, 6, 11, 12);
+		QuarterRound(output, 2, 7, 8, 13);
+		QuarterRound(output, 3, 4, 9, 14);
+	}
+	for (size_t i = 0; i < output.size(); i++)
+		output[i] += input[i];
+}
+
+void ChaCha20::Seed(const std::array<uint32_t, 8>& key, uint64_t stream)
+{
+	// "expand 32-byte k"
+	m_input[0] = 0x61707865;
+	m_input[1] = 0x3320646E;
+	m_input[2] = 0x79622D32;
+	m_input[3] = 0x6B206574;
+	for (size_t i = 0; i < key.size(); i++)
+		m_input[4 + i] = key[i];
+	m_input[12] = 0;
+	m_input[13] = 0;
+	m_input[14] = (uint32_t)stream;
+	m_input[15] = (uint32_t)(stream >> 32);
+	m_used = m_block.size();
+}
+
+void ChaCha20::Seed(uint64_t seed)
+{
+	std::array<uint32_t, 8> key{};
+	for (size_t i = 0; i < key.size(); i += 2)
+	{
+		const uint64_t word = SplitMix64(seed);
+		key[i] = (uint32_t)word;
+		key[i + 1] = (uint32_t)(word >> 32);
+	}
+	Seed(key);
+}
+
+void ChaCha20::SeedRandom()
+{
+	std::random_device device;
+	std::array<uint32_t, 8> key{};
+	for (uint32_t& word : key)
+		word = device();
+	Seed(key);
+}
+
+void ChaCha20::Refill()
+{
+	Block(m_input, m_block);
+	// 64-bit block counter in words 12 and 13
+	if (++m_input[12] == 0)
+		m_input[13]++;
+	m_used = 0;
+}
+
+void DeckRng::Seed(RngPolicy policy, uint64_t seed)
+{
+	m_policy = policy;
+	if (policy == RngPolicy::Fast)
+		m_fast.Seed(seed);
+	else
+		m_secure.Seed(seed);
+	m_seeded = true;
+}
+
+void DeckRng::SeedDefault()
+{
+	m_policy = s_defaultPolicy;
+	const uint64_t replaySeed = s_replaySeed;
+	if (replaySeed != 0)
+	{
+		uint64_t state = replaySeed + 0x9E3779B97F4A7C15ull * s_replayCount.fetch_add(1);
+		Seed(m_policy, SplitMix64(state));
+		return;
+	}
+	if (m_policy == RngPolicy::Fast)
+	{
+		std::random_device device;
+		m_fast.Seed(((uint64_t)device() << 32) | device());
+	}
+	else
+	{
+		m_secure.SeedRandom();
+	}
+	m_seeded = true;
+}
+
+void DeckRng::SetDefaultPolicy(RngPolicy policy)
+{
+	s_defaultPolicy = policy;
+}
+
+RngPolicy DeckRng::DefaultPolicy()
+{
+	return s_defaultPolicy;
+}
+
+void DeckRng::SetReplaySeed(uint64_t seed)
+{
+	s_replaySeed = seed;
+	s_replayCount = 0;
+}
+
+uint64_t DeckRng::ReplaySeed()
+{
+	return s_replaySeed;
+}
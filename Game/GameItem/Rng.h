@@ -0,0 +1,132 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// xoshiro256** (Blackman and Vigna): 32 bytes of state, a few cycles per number. For
+// simulations, where speed matters and nobody is trying to predict the next card.
+class Xoshiro256
+{
+public:
+	using result_type = uint64_t;
+
+	explicit Xoshiro256(uint64_t seed = 0) { Seed(seed); }
+	// the four words come from SplitMix64, so any seed, 0 included, gives a usable state
+	void Seed(uint64_t seed);
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+	result_type operator()()
+	{
+		const uint64_t result = Rotl(m_s[1] * 5, 7) * 9;
+		const uint64_t t = m_s[1] << 17;
+		m_s[2] ^= m_s[0];
+		m_s[3] ^= m_s[1];
+		m_s[1] ^= m_s[2];
+		m_s[0] ^= m_s[3];
+		m_s[2] ^= t;
+		m_s[3] = Rotl(m_s[3], 45);
+		return result;
+	}
+
+private:
+	static uint64_t Rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+	std::array<uint64_t, 4> m_s{};
+};
+
+// The ChaCha20 block function run in counter mode as a keystream generator: a 256-bit key,
+// 64-bit block counter and 64-bit stream id. What comes out cannot be told apart from
+// random or run backwards without the key, so it is what live deals draw from.
+class ChaCha20
+{
+public:
+	using result_type = uint32_t;
+
+	ChaCha20() = default;
+	void Seed(const std::array<uint32_t, 8>& key, uint64_t stream = 0);
+	// the key expanded from one number with SplitMix64, for replays; not secret then
+	void Seed(uint64_t seed);
+	// a key from std::random_device
+	void SeedRandom();
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+	result_type operator()()
+	{
+		if (m_used == m_block.size())
+			Refill();
+		return m_block[m_used++];
+	}
+
+	// one 64-byte block of keystream for the given input words, exposed for known-answer checks
+	static void Block(const std::array<uint32_t, 16>& input, std::array<uint32_t, 16>& output);
+
+private:
+	void Refill();
+
+	std::array<uint32_t, 16> m_input{};
+	std::array<uint32_t, 16> m_block{};
+	size_t m_used = 16;
+};
+
+enum class RngPolicy : uint8_t
+{
+	Fast = 0,      // Xoshiro256
+	Secure = 1     // ChaCha20
+};
+
+// What Deck draws from. Costs nothing until the first draw: that is when an unseeded one
+// takes the default policy and a seed, so a game built only to print a table never seeds.
+// Seeds come from std::random_device unless a replay seed is set, in which case the n-th
+// generator to seed itself in the process gets a seed derived from (replay seed, n), and a
+// rerun that makes the same calls in the same order deals the same cards.
+class DeckRng
+{
+public:
+	DeckRng() = default;
+
+	// seeds now with this policy and seed, overriding the defaults and the replay seed
+	void Seed(RngPolicy policy, uint64_t seed);
+	bool Seeded() const { return m_seeded; }
+	RngPolicy Policy() const { return m_policy; }
+
+	// uniform in [0, bound), bound > 0; Lemire's multiply-shift with rejection, so unbiased
+	uint32_t Below(uint32_t bound)
+	{
+		uint64_t product = (uint64_t)Next32() * bound;
+		uint32_t low = (uint32_t)product;
+		if (low < bound)
+		{
+			const uint32_t threshold = (0u - bound) % bound;
+			while (low < threshold)
+			{
+				product = (uint64_t)Next32() * bound;
+				low = (uint32_t)product;
+			}
+		}
+		return (uint32_t)(product >> 32);
+	}
+
+	// policy for generators that seed themselves, Secure unless changed
+	static void SetDefaultPolicy(RngPolicy policy);
+	static RngPolicy DefaultPolicy();
+	// 0 turns replays off and goes back to std::random_device
+	static void SetReplaySeed(uint64_t seed);
+	static uint64_t ReplaySeed();
+
+private:
+	uint32_t Next32()
+	{
+		if (!m_seeded)
+			SeedDefault();
+		return m_policy == RngPolicy::Fast ? (uint32_t)(m_fast() >> 32) : m_secure();
+	}
+	void SeedDefault();
+
+	bool m_seeded = false;
+	RngPolicy m_policy = RngPolicy::Secure;
+	Xoshiro256 m_fast;
+	ChaCha20 m_secure;
+};
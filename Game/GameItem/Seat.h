@@ -1,5 +1,6 @@
 #pragma once
 #include "Card.h"
+#include "CardSet.h"
 #include <cstdint>
 
 class NetPack;
@@ -22,6 +23,8 @@ struct Seat
 
 	bool IsOccupied() const { return playerId >= 0 && !pendingLeave; }
 	bool CanAct() const { return inHand && !folded && !allIn; }
+	// hole stays two ordered cards for the wire and the printers, evaluation takes the mask
+	CardSet HoleSet() const { return CardSet::Of(hole[0]) | CardSet::Of(hole[1]); }
 
 	void Write(NetPack& pack, bool includeHole = false) const;
 	// Read now auto-detects hasHoleCards flag from stream
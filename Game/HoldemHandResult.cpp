@@ -27,6 +27,17 @@ void HandResult::Write(NetPack& pack) const
 			pr.holeCards[1].Write(pack);
 		}
 	}
+
+	// trailing and optional, older readers stop before it
+	if (HasEquity())
+	{
+		pack.WriteUInt8(kEquityBlockV1);
+		pack.WriteUInt8(equityBoardCards);
+		pack.WriteUInt32(equityRunouts);
+		pack.WriteFloat(equityMs);
+		for (const PlayerHandResult& pr : playerResults)
+			pack.WriteFloat(pr.equity);
+	}
 }
 
 void HandResult::Read(NetPack& pack)
@@ -60,6 +71,15 @@ void HandResult::Read(NetPack& pack)
 		}
 		playerResults.push_back(pr);
 	}
+
+	if (pack.Unread() > 0 && pack.ReadUInt8() == kEquityBlockV1)
+	{
+		equityBoardCards = pack.ReadUInt8();
+		equityRunouts = pack.ReadUInt32();
+		equityMs = pack.ReadFloat();
+		for (PlayerHandResult& pr : playerResults)
+			pr.equity = pack.ReadFloat();
+	}
 }
 
 void HandResult::Clear()
@@ -68,6 +88,9 @@ void HandResult::Clear()
 	communityCards.clear();
 	totalPot = 0;
 	isShowdown = false;
+	equityBoardCards = 0;
+	equityRunouts = 0;
+	equityMs = 0.0f;
 }
 
 void HandResult::WriteToDatabase() const
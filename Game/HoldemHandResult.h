@@ -12,6 +12,8 @@ struct PlayerHandResult
 	int chipsWon = 0;
 	Card holeCards[2]{};
 	bool folded = false;
+	// pot share over every runout from the point the hand went all-in, below 0 when it did not
+	float equity = -1.0f;
 };
 
 struct HandResult
@@ -20,6 +22,17 @@ struct HandResult
 	std::vector<Card> communityCards;
 	int totalPot = 0;
 	bool isShowdown = false;
+	// all-in equity: community cards known when the betting ended, runouts enumerated, time taken
+	uint8_t equityBoardCards = 0;
+	uint32_t equityRunouts = 0;
+	float equityMs = 0.0f;
+
+	bool HasEquity() const { return equityRunouts > 0; }
+
+	// tag of the optional trailing equity block. Write leaves the block, tag included, out
+	// unless HasEquity, so results without equity keep the original format; Read skips a
+	// block with a tag it does not know.
+	static constexpr uint8_t kEquityBlockV1 = 1;
 
 	void Write(NetPack& pack) const;
 	void Read(NetPack& pack);
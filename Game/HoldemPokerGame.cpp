@@ -1,24 +1,35 @@
 #include "pch.h"
 #include "HoldemPokerGame.h"
 #include "HoldemTableSnapshot.h"
+#include "EquityCalculator.h"
 #include "GameItem/HandEvaluator.h"
 #include "Net/NetPack.h"
 #include <algorithm>
-#include <unordered_map>
+#include <bit>
 
 #undef min
 #undef max
 
 HoldemPokerGame::HoldemPokerGame()
-	: _rng(std::random_device{}())
 {
 }
 
 int HoldemPokerGame::s_maxSeats = 0;
+bool HoldemPokerGame::s_allInEquity = false;
+
+void HoldemPokerGame::SetAllInEquity(bool enabled)
+{
+	s_allInEquity = enabled;
+}
+
+bool HoldemPokerGame::IsAllInEquity()
+{
+	return s_allInEquity;
+}
 
 void HoldemPokerGame::SetMaxSeats(int maxSeats)
 {
-	s_maxSeats = maxSeats;
+	s_maxSeats = std::min(maxSeats, kMaxSeats);
 }
 
 int HoldemPokerGame::GetMaxSeats()
@@ -74,9 +85,9 @@ void HoldemPokerGame::StartHand()
 
 	_stage = Stage::PreFlop;
 	_community.clear();
+	_board.Clear();
 	_sidePots.clear();
 	_deck.Reset52();
-	_deck.Shuffle(_rng);
 
 	for (Seat& seat : _seats)
 	{
@@ -88,6 +99,7 @@ void HoldemPokerGame::StartHand()
 		if (IsSeatActive(seat))
 			seat.inHand = true;
 	}
+	SyncSeatMasks();
 
 	if (!_seats.empty())
 	{
@@ -99,6 +111,7 @@ void HoldemPokerGame::StartHand()
 	PostBlinds();
 	for (Seat& seat : _seats)
 		seat.actedThisRound = false;
+	_actedMask = 0;
 
 	DealHoleCards();
 	size_t sbPos = FindNextValidBlindPosition(_dealerIndex + 1);
@@ -134,6 +147,7 @@ void HoldemPokerGame::PostBlinds()
 	sbSeat.currentBet = sbAmount;
 	sbSeat.totalBetThisHand = sbAmount;
 	if (sbSeat.chips == 0) sbSeat.allIn = true;
+	UpdateSeatMasks(sbPos);
 	RecordLastAction(sbSeat.playerId, Action::Bet, sbAmount);
 
 	Seat& bbSeat = _seats[bbPos];
@@ -142,6 +156,7 @@ void HoldemPokerGame::PostBlinds()
 	bbSeat.currentBet = bbAmount;
 	bbSeat.totalBetThisHand = bbAmount;
 	if (bbSeat.chips == 0) bbSeat.allIn = true;
+	UpdateSeatMasks(bbPos);
 	RecordLastAction(bbSeat.playerId, Action::Bet, bbAmount);
 
 	_lastBet = bbAmount;
@@ -150,15 +165,7 @@ void HoldemPokerGame::PostBlinds()
 
 size_t HoldemPokerGame::FindNextValidBlindPosition(size_t start) const
 {
-	if (_seats.empty()) return _seats.size();
-	for (size_t offset = 0; offset < _seats.size(); ++offset)
-	{
-		size_t idx = (start + offset) % _seats.size();
-		const Seat& seat = _seats[idx];
-		if (seat.inHand)
-			return idx;
-	}
-	return _seats.size();
+	return NextInMask(_inHandMask, start);
 }
 
 void HoldemPokerGame::AdvanceStage()
@@ -252,6 +259,7 @@ void HoldemPokerGame::ResetBetsForNewRound()
 		seat.currentBet = 0;
 		seat.actedThisRound = false;
 	}
+	_actedMask = 0;
 }
 
 void HoldemPokerGame::AdvanceTurn()
@@ -438,17 +446,15 @@ HoldemPokerGame::ActionResult HoldemPokerGame::HandleAction(int playerId, Action
 	}
 
 	seat->actedThisRound = true;
+	UpdateSeatMasks(_actingIndex);
 	RecordLastAction(playerId, action, paid);
 	if (didRaise)
 	{
-		for (Seat& other : _seats)
-		{
-			if (&other == seat)
-				continue;
-			if (!other.IsOccupied() || !other.inHand || other.folded || other.allIn)
-				continue;
-			other.actedThisRound = false;
-		}
+		// everyone else who can still act has to answer the raise
+		const uint64_t reopened = (LiveMask() & ~_allInMask) & ~SeatBit(_actingIndex);
+		for (uint64_t bits = reopened; bits != 0; bits &= bits - 1)
+			_seats[std::countr_zero(bits)].actedThisRound = false;
+		_actedMask &= ~reopened;
 	}
 
 	ResolveIfNeeded();
@@ -482,6 +488,7 @@ void HoldemPokerGame::ProcessAutoModePlayer()
 			RecordLastAction(seat.playerId, Action::Fold, 0);
 		}
 		seat.actedThisRound = true;
+		UpdateSeatMasks(_actingIndex);
 		ResolveIfNeeded();
 		if (_stage != Stage::Waiting)
 			AdvanceTurn();
@@ -490,20 +497,15 @@ void HoldemPokerGame::ProcessAutoModePlayer()
 
 void HoldemPokerGame::ResolveIfNeeded()
 {
-	size_t aliveIdx = 0;
-	int aliveCnt = 0;
-	bool allIn = true;
+	const uint64_t live = LiveMask();
+	const int aliveCnt = std::popcount(live);
+	const size_t aliveIdx = live != 0 ? 63 - std::countl_zero(live) : 0;
+	const bool allIn = (live & ~_allInMask) == 0;
 	int withChips = 0;
 	const Seat* loneWithChips = nullptr;
-	for (size_t i = 0; i < _seats.size(); ++i)
+	for (uint64_t bits = live; bits != 0; bits &= bits - 1)
 	{
-		const Seat& seat = _seats[i];
-		if (!seat.IsOccupied() || !seat.inHand || seat.folded)
-			continue;
-		aliveCnt++;
-		aliveIdx = i;
-		if (!seat.allIn)
-			allIn = false;
+		const Seat& seat = _seats[std::countr_zero(bits)];
 		if (seat.chips > 0)
 		{
 			withChips++;
@@ -548,10 +550,40 @@ void HoldemPokerGame::ResolveIfNeeded()
 	if (aliveCnt > 1 && (allIn || (withChips == 1 && loneWithChips
 		&& loneWithChips->currentBet >= _lastBet)))
 	{
+		// the odds as they stood when the betting ended, before the runout is dealt
+		std::vector<int> equityIds;
+		ExactEquity equity;
+		const uint8_t knownBoard = static_cast<uint8_t>(_community.size());
+		if (s_allInEquity && knownBoard < 5)
+		{
+			std::vector<CardSet> hands;
+			for (const Seat& seat : _seats)
+			{
+				if (!seat.IsOccupied() || !seat.inHand || seat.folded)
+					continue;
+				equityIds.push_back(seat.playerId);
+				hands.push_back(seat.HoleSet());
+			}
+			equity = EquityCalculator::Enumerate(hands, _board);
+		}
+
 		while (_community.size() < 5)
 			DealCommunity(1);
 		_stage = Stage::Showdown;
 		HandleShowdown();
+
+		if (!equity.equity.empty())
+		{
+			_lastHandResult.equityBoardCards = knownBoard;
+			_lastHandResult.equityRunouts = static_cast<uint32_t>(equity.runouts);
+			_lastHandResult.equityMs = static_cast<float>(equity.elapsedMs);
+			for (PlayerHandResult& pr : _lastHandResult.playerResults)
+			{
+				auto it = std::find(equityIds.begin(), equityIds.end(), pr.playerId);
+				if (it != equityIds.end())
+					pr.equity = static_cast<float>(equity.equity[it - equityIds.begin()]);
+			}
+		}
 		FinishHand();
 		return;
 	}
@@ -567,6 +599,7 @@ void HoldemPokerGame::FinishHand()
 {
 	_stage = Stage::Waiting;
 	_community.clear();
+	_board.Clear();
 	_sidePots.clear();
 	_lastBet = 0;
 	_lastRaise = 0;
@@ -580,6 +613,7 @@ void HoldemPokerGame::FinishHand()
 		seat.totalBetThisHand = 0;
 		seat.actedThisRound = false;
 	}
+	SyncSeatMasks();
 }
 
 bool HoldemPokerGame::SitDown(int playerId, int seatIdxHint, int& actualSeatIdx)
@@ -629,6 +663,7 @@ bool HoldemPokerGame::SitDown(int playerId, int seatIdxHint, int& actualSeatIdx)
 	std::sort(_seats.begin(), _seats.end(), [](const Seat& a, const Seat& b) {
 		return a.seatIndex < b.seatIndex;
 	});
+	SyncSeatMasks();
 
 	actualSeatIdx = seatIdx;
 	return true;
@@ -684,6 +719,7 @@ void HoldemPokerGame::MarkPendingLeave(int playerId)
 	{
 		seat->pendingLeave = true;
 		seat->autoMode = true;
+		UpdateSeatMasks(static_cast<size_t>(seat - _seats.data()));
 	}
 }
 
@@ -699,6 +735,7 @@ void HoldemPokerGame::RemovePendingLeavers()
 	_seats.erase(std::remove_if(_seats.begin(), _seats.end(), [](const Seat& s) {
 		return s.playerId < 0 || (s.pendingLeave && !s.inHand);
 	}), _seats.end());
+	SyncSeatMasks();
 
 	if (_seats.empty())
 	{
@@ -880,6 +917,9 @@ void HoldemPokerGame::ReadTable(NetPack& pack)
 	_lastRaise = snapshot.lastRaise;
 	_sidePots = snapshot.sidePots;
 	_community = snapshot.community;
+	_board.Clear();
+	for (const Card& card : _community)
+		_board.Add(card);
 	_lastActionPlayerId = snapshot.lastActionPlayerId;
 	_lastAction = snapshot.lastAction;
 	_lastActionAmount = snapshot.lastActionAmount;
@@ -893,6 +933,7 @@ void HoldemPokerGame::ReadTable(NetPack& pack)
 		if (_seats.back().playerId == snapshot.actingPlayerId)
 			_actingIndex = _seats.size() - 1;
 	}
+	SyncSeatMasks();
 }
 
 void HoldemPokerGame::DealHoleCards()
@@ -900,63 +941,67 @@ void HoldemPokerGame::DealHoleCards()
 	for (Seat& seat : _seats)
 	{
 		if (!seat.inHand) continue;
-		seat.hole[0] = _deck.Draw();
-		seat.hole[1] = _deck.Draw();
+		seat.hole[0] = _deck.Draw(_rng);
+		seat.hole[1] = _deck.Draw(_rng);
 	}
 }
 
 void HoldemPokerGame::DealCommunity(size_t count)
 {
 	for (size_t i = 0; i < count; ++i)
-		_community.push_back(_deck.Draw());
+	{
+		_community.push_back(_deck.Draw(_rng));
+		_board.Add(_community.back());
+	}
 }
 
 size_t HoldemPokerGame::NextActiveIndex(size_t start, bool includeAllIn) const
 {
-	if (_seats.empty()) return _seats.size();
-	for (size_t offset = 0; offset < _seats.size(); ++offset)
-	{
-		size_t idx = (start + offset) % _seats.size();
-		const Seat& seat = _seats[idx];
-		if (!seat.IsOccupied() || !seat.inHand || seat.folded)
-			continue;
-		if (!includeAllIn && seat.allIn)
-			continue;
-		return idx;
-	}
-	return _seats.size();
+	return NextInMask(includeAllIn ? LiveMask() : LiveMask() & ~_allInMask, start);
+}
+
+size_t HoldemPokerGame::NextInMask(uint64_t mask, size_t start) const
+{
+	if (mask == 0 || _seats.empty())
+		return _seats.size();
+	const size_t from = start % _seats.size();
+	const uint64_t atOrAfter = from < kMaxSeats ? mask & (~0ull << from) : 0;
+	return static_cast<size_t>(std::countr_zero(atOrAfter != 0 ? atOrAfter : mask));
+}
+
+void HoldemPokerGame::SyncSeatMasks()
+{
+	_occupiedMask = _inHandMask = _foldedMask = _allInMask = _actedMask = 0;
+	for (size_t i = 0; i < _seats.size(); ++i)
+		UpdateSeatMasks(i);
+}
+
+void HoldemPokerGame::UpdateSeatMasks(size_t index)
+{
+	const uint64_t bit = SeatBit(index);
+	const Seat& seat = _seats[index];
+	auto assign = [bit](uint64_t& mask, bool on) { mask = on ? mask | bit : mask & ~bit; };
+	assign(_occupiedMask, seat.IsOccupied());
+	assign(_inHandMask, seat.inHand);
+	assign(_foldedMask, seat.folded);
+	assign(_allInMask, seat.allIn);
+	assign(_actedMask, seat.actedThisRound);
 }
 
 bool HoldemPokerGame::AllBetsMatched() const
 {
-	int activeCount = 0;
-	for (const Seat& seat : _seats)
-	{
-		if (!seat.IsOccupied() || !seat.inHand || seat.folded)
-			continue;
-		if (seat.allIn)
-			continue;
-		activeCount++;
-		if (!seat.actedThisRound && seat.currentBet != _lastBet)
+	const uint64_t canAct = LiveMask() & ~_allInMask;
+	// only seats yet to act can be short of the bet
+	for (uint64_t bits = canAct & ~_actedMask; bits != 0; bits &= bits - 1)
+		if (_seats[std::countr_zero(bits)].currentBet != _lastBet)
 			return false;
-	}
-	return activeCount > 0;
+	return canAct != 0;
 }
 
 bool HoldemPokerGame::AllActivePlayersActed() const
 {
-	int activeCount = 0;
-	for (const Seat& seat : _seats)
-	{
-		if (!seat.IsOccupied() || !seat.inHand || seat.folded)
-			continue;
-		if (seat.allIn)
-			continue;
-		activeCount++;
-		if (!seat.actedThisRound)
-			return false;
-	}
-	return activeCount > 0;
+	const uint64_t canAct = LiveMask() & ~_allInMask;
+	return canAct != 0 && (canAct & ~_actedMask) == 0;
 }
 
 void HoldemPokerGame::HandleShowdown()
@@ -965,9 +1010,21 @@ void HoldemPokerGame::HandleShowdown()
 	DistributePots();
 }
 
+void HoldemPokerGame::ScoreShowdown()
+{
+	_showdownScores.assign(_seats.size(), -1);
+	for (size_t i = 0; i < _seats.size(); ++i)
+	{
+		const Seat& seat = _seats[i];
+		if (seat.inHand && !seat.folded)
+			_showdownScores[i] = EvaluateHand(seat);
+	}
+}
+
 void HoldemPokerGame::DistributePots()
 {
-	std::unordered_map<int, int> chipsWonByPlayer{};
+	ScoreShowdown();
+	std::vector<int> chipsWonBySeat(_seats.size(), 0);
 	int totalPot = 0;
 	for (SidePot& pot : _sidePots)
 	{
@@ -976,23 +1033,24 @@ void HoldemPokerGame::DistributePots()
 			continue;
 
 		int bestScore = -1;
-		std::vector<int> winners;
+		std::vector<size_t> winners;   // seat indices
 
 		for (int pid : pot.eligiblePlayerIds)
 		{
 			const Seat* seat = GetSeatByPlayerId(pid);
 			if (!seat || seat->folded) continue;
 
-			int score = EvaluateHand(*seat);
+			const size_t seatIdx = static_cast<size_t>(seat - _seats.data());
+			int score = _showdownScores[seatIdx];
 			if (score > bestScore)
 			{
 				bestScore = score;
 				winners.clear();
-				winners.push_back(pid);
+				winners.push_back(seatIdx);
 			}
 			else if (score == bestScore)
 			{
-				winners.push_back(pid);
+				winners.push_back(seatIdx);
 			}
 		}
 
@@ -1000,44 +1058,26 @@ void HoldemPokerGame::DistributePots()
 
 		int gain = pot.amount / static_cast<int>(winners.size());
 		int remainder = pot.amount % static_cast<int>(winners.size());
-		for (int pid : winners)
+		for (size_t seatIdx : winners)
 		{
-			Seat* seat = GetSeatByPlayerId(pid);
-			if (seat)
-				seat->chips += gain;
-			chipsWonByPlayer[pid] += gain;
+			_seats[seatIdx].chips += gain;
+			chipsWonBySeat[seatIdx] += gain;
 		}
 		if (remainder > 0)
 		{
-			std::vector<int> ordered = winners;
-			if (!_seats.empty() && _dealerIndex < _seats.size())
+			// odd chips go out clockwise from the seat after the dealer
+			std::vector<size_t> ordered = winners;
+			if (_dealerIndex < _seats.size())
 			{
 				size_t start = (_dealerIndex + 1) % _seats.size();
-				auto seatPos = [this](int pid) -> size_t {
-					for (size_t i = 0; i < _seats.size(); ++i)
-					{
-						if (_seats[i].playerId == pid)
-							return i;
-					}
-					return _seats.size();
-				};
-				std::sort(ordered.begin(), ordered.end(), [this, start, &seatPos](int a, int b) {
-					size_t posA = seatPos(a);
-					size_t posB = seatPos(b);
-					size_t distA = (posA + _seats.size() - start) % _seats.size();
-					size_t distB = (posB + _seats.size() - start) % _seats.size();
-					if (distA != distB)
-						return distA < distB;
-					return a < b;
+				std::sort(ordered.begin(), ordered.end(), [this, start](size_t a, size_t b) {
+					return (a + _seats.size() - start) % _seats.size() < (b + _seats.size() - start) % _seats.size();
 				});
 			}
 			for (int i = 0; i < remainder && i < static_cast<int>(ordered.size()); ++i)
 			{
-				int pid = ordered[i];
-				Seat* seat = GetSeatByPlayerId(pid);
-				if (seat)
-					seat->chips += 1;
-				chipsWonByPlayer[pid] += 1;
+				_seats[ordered[i]].chips += 1;
+				chipsWonBySeat[ordered[i]] += 1;
 			}
 		}
 		pot.amount = 0;
@@ -1046,17 +1086,17 @@ void HoldemPokerGame::DistributePots()
 
 	RecordHandResult(totalPot, true);
 	_lastHandResult.playerResults.clear();
-	for (const Seat& s : _seats)
+	for (size_t i = 0; i < _seats.size(); ++i)
 	{
+		const Seat& s = _seats[i];
 		if (!s.inHand) continue;
 		PlayerHandResult pr;
 		pr.playerId = s.playerId;
 		pr.folded = s.folded;
 		pr.holeCards[0] = s.hole[0];
 		pr.holeCards[1] = s.hole[1];
-		pr.handRank = s.folded ? 0 : EvaluateHand(s);
-		auto it = chipsWonByPlayer.find(s.playerId);
-		pr.chipsWon = (it != chipsWonByPlayer.end()) ? it->second : 0;
+		pr.handRank = s.folded ? 0 : _showdownScores[i];
+		pr.chipsWon = chipsWonBySeat[i];
 		_lastHandResult.playerResults.push_back(pr);
 	}
 	_hasPendingHandResult = true;
@@ -1064,12 +1104,7 @@ void HoldemPokerGame::DistributePots()
 
 int HoldemPokerGame::EvaluateHand(const Seat& seat) const
 {
-	std::array<Card, 7> cards{};
-	cards[0] = seat.hole[0];
-	cards[1] = seat.hole[1];
-	for (size_t i = 0; i < _community.size() && i < 5; ++i)
-		cards[2 + i] = _community[i];
-	return HandEvaluator::Evaluate(cards);
+	return HandEvaluator::Evaluate(seat.HoleSet() | _board);
 }
 
 void HoldemPokerGame::RecordHandResult(int totalPot, bool isShowdown)
@@ -4,7 +4,6 @@
 #include "GameItem/Seat.h"
 #include "HoldemHandResult.h"
 #include <vector>
-#include <random>
 #include <cstdint>
 
 class NetPack;
@@ -63,8 +62,18 @@ public:
 
 	HoldemPokerGame();
 
+	// at most kMaxSeats, one bit each in the seat masks
+	static constexpr int kMaxSeats = 64;
 	static void SetMaxSeats(int maxSeats);
 	static int GetMaxSeats();
+	// exact equities of the live hands whenever an all-in is run out, shown in the hand result.
+	// Off by default: the enumeration runs inside ResolveIfNeeded on whatever thread drives
+	// the table (up to 1.7M runouts preflop), which for a server is the one serving every room.
+	static void SetAllInEquity(bool enabled);
+	static bool IsAllInEquity();
+	// fixes this table's deals, e.g. to replay a hand; otherwise the deck seeds itself from
+	// DeckRng's defaults on the first deal
+	void SeedDeck(RngPolicy policy, uint64_t seed) { _rng.Seed(policy, seed); }
 
 	SetBlindsResult SetBlinds(int smallBlind, int bigBlind);
 	bool AreBlindsSet() const { return _smallBlind > 0 && _bigBlind > 0; }
@@ -137,17 +146,36 @@ private:
 	void HandleShowdown();
 	void DistributePots();
 	int EvaluateHand(const Seat& seat) const;
+	// scores every seat still in the hand once, into _showdownScores
+	void ScoreShowdown();
 	void RecordHandResult(int totalPot, bool isShowdown);
 	void RecordLastAction(int playerId, Action action, int amount);
 	void ClearLastAction();
 	int GetMaxOtherEffectiveTotal(int playerId) const;
 	int GetMaxAllowedTotalBet(const Seat& seat) const;
+	// bit i of a mask is _seats[i]
+	static uint64_t SeatBit(size_t index) { return index < kMaxSeats ? 1ull << index : 0; }
+	// recomputes every mask, after seats are added, removed, reordered or reset together
+	void SyncSeatMasks();
+	// recomputes one seat's bits, after its flags change
+	void UpdateSeatMasks(size_t index);
+	// in the hand and not folded; CanAct seats are these minus _allInMask
+	uint64_t LiveMask() const { return _occupiedMask & _inHandMask & ~_foldedMask; }
+	// first set bit at or after start going round the table, _seats.size() if none
+	size_t NextInMask(uint64_t mask, size_t start) const;
 
 	std::vector<Seat> _seats{};
+	// the Seat flags of the turn and round checks as one bit per seat, see SeatBit
+	uint64_t _occupiedMask = 0;       // Seat::IsOccupied
+	uint64_t _inHandMask = 0;
+	uint64_t _foldedMask = 0;
+	uint64_t _allInMask = 0;
+	uint64_t _actedMask = 0;          // actedThisRound
 	std::vector<Card> _community{};
+	CardSet _board{};                 // _community as a mask, what showdowns evaluate
 	std::vector<SidePot> _sidePots{};
 	Deck _deck{};
-	std::mt19937 _rng;
+	DeckRng _rng;                     // seeds itself on the first deal, see DeckRng
 	Stage _stage = Stage::Waiting;
 	size_t _dealerIndex = 0;
 	size_t _actingIndex = 0;
@@ -165,6 +193,9 @@ private:
 	// Hand result tracking
 	HandResult _lastHandResult{};
 	bool _hasPendingHandResult = false;
+	// by seat index, -1 for seats out of the hand; shared by every side pot and the hand result
+	std::vector<int> _showdownScores;
 
 	static int s_maxSeats;
+	static bool s_allInEquity;
 };
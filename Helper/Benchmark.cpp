@@ -0,0 +1,388 @@
+#include "pch.h"
+#include "Benchmark.h"
+#include "Game/EquityCalculator.h"
+#include "Game/HoldemPokerGame.h"
+#include "Game/GameItem/Deck.h"
+#include "Game/GameItem/HandEvaluator.h"
+#include "Game/GameItem/Rng.h"
+#include <chrono>
+#include <random>
+
+namespace
+{
+	std::vector<std::array<Card, 7>> RandomHands(int count, uint64_t seed)
+	{
+		std::mt19937_64 rng(seed);
+		std::array<Card, 52> deck;
+		for (int i = 0; i < 52; i++)
+			deck[i] = Card((uint8_t)(i % 13 + Card::RANK_MIN), (uint8_t)(i / 13));
+
+		std::vector<std::array<Card, 7>> hands((size_t)count);
+		for (int h = 0; h < count; h++)
+		{
+			// partial Fisher-Yates, the first seven slots are the hand
+			for (int i = 0; i < 7; i++)
+				std::swap(deck[i], deck[i + rng() % (52 - i)]);
+			std::copy(deck.begin(), deck.begin() + 7, hands[h].begin());
+			if (h % 10 == 0)
+				hands[h][5] = hands[h][6] = Card{};
+		}
+		return hands;
+	}
+
+	// RFC 7539 section 2.3.2: the block function on its test key, nonce and counter 1
+	bool ChaChaKnownAnswer()
+	{
+		const std::array<uint32_t, 16> input = {
+			0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+			0x03020100, 0x07060504, 0x0b0a0908, 0x0f0e0d0c,
+			0x13121110, 0x17161514, 0x1b1a1918, 0x1f1e1d1c,
+			0x00000001, 0x09000000, 0x4a000000, 0x00000000 };
+		const std::array<uint32_t, 16> expected = {
+			0xe4e7f110, 0x15593bd1, 0x1fdd0f50, 0xc47120a3,
+			0xc7f4d1c7, 0x0368c033, 0x9aaa2204, 0x4e6cd4c3,
+			0x466482d2, 0x09aa9f07, 0x05d7c214, 0xa2028bd9,
+			0xd19c12b5, 0xb94e16de, 0xe883d0cb, 0x4e3c50a2 };
+		std::array<uint32_t, 16> output{};
+		ChaCha20::Block(input, output);
+		return output == expected;
+	}
+
+	// whole decks dealt per second, drawing with pick(cards left) the way Deck::Draw does;
+	// firstCards counts the first card of every deck for a uniformity check
+	template <typename Pick>
+	double DealRate(int deals, Pick pick, std::array<uint64_t, 52>& firstCards, uint64_t& checksum)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (int d = 0; d < deals; d++)
+		{
+			CardSet cards = CardSet::Full();
+			for (int left = 52; left > 0; left--)
+			{
+				const Card card = cards.Nth(pick(left));
+				cards.Remove(card);
+				if (left == 52)
+					firstCards[(card.Rank() - Card::RANK_MIN) + card.Suit() * 13]++;
+				checksum += card.Rank() * left;
+			}
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return seconds > 0 ? deals / seconds : 0.0;
+	}
+
+	// chi-square of the first-card counts against uniform, about 51 (sd 10) when it is
+	double ChiSquare(const std::array<uint64_t, 52>& counts, int deals)
+	{
+		const double expected = deals / 52.0;
+		double sum = 0;
+		for (uint64_t count : counts)
+			sum += (count - expected) * (count - expected) / expected;
+		return sum;
+	}
+
+	// evaluations per second of eval over every hand, the checksum keeps the loop alive
+	template <typename Eval>
+	double Measure(const std::vector<std::array<Card, 7>>& hands, Eval eval, int64_t& checksum)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		for (const auto& hand : hands)
+			checksum += eval(hand);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return seconds > 0 ? hands.size() / seconds : 0.0;
+	}
+}
+
+void Benchmark::HandEval(int hands, uint64_t seed)
+{
+	const auto sample = RandomHands(hands, seed);
+
+	int mismatches = 0;
+	for (const auto& hand : sample)
+	{
+		const int fast = HandEvaluator::Evaluate(hand, HandEvaluator::ScoreMode::Compatible);
+		const int reference = HandEvaluator::EvaluateReference(hand);
+		if (fast == reference)
+			continue;
+		if (mismatches++ < 5)
+			Console::Out() << "\tmismatch: table " << fast << ", reference " << reference << std::endl;
+	}
+
+	std::vector<std::array<uint16_t, 4>> masks(sample.size());
+	for (size_t i = 0; i < sample.size(); i++)
+	{
+		CardSet set;
+		for (const Card& card : sample[i])
+			set.Add(card);
+		masks[i] = set.Lanes();
+	}
+
+	int64_t checksum = 0;
+	const double reference = Measure(sample, [](const auto& hand) { return HandEvaluator::EvaluateReference(hand); }, checksum);
+	const double compatible = Measure(sample, [](const auto& hand) {
+		return HandEvaluator::Evaluate(hand, HandEvaluator::ScoreMode::Compatible); }, checksum);
+	const double exact = Measure(sample, [](const auto& hand) {
+		return HandEvaluator::Evaluate(hand, HandEvaluator::ScoreMode::Exact); }, checksum);
+	const auto start = std::chrono::steady_clock::now();
+	for (const auto& mask : masks)
+		checksum += HandEvaluator::Strength(mask);
+	const double strengthSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const double strength = strengthSeconds > 0 ? masks.size() / strengthSeconds : 0.0;
+
+	Console::Out() << "[BENCH EVAL] " << hands << " hands, seed " << seed << ", mismatches vs reference: " << mismatches
+		<< " (checksum " << checksum << ")" << std::endl;
+	Console::Out() << '\t' << "reference:         " << std::format("{:8.2f}", reference / 1e6) << " M/s" << std::endl;
+	Console::Out() << '\t' << "table, compatible: " << std::format("{:8.2f}", compatible / 1e6) << " M/s ("
+		<< std::format("{:.1f}", reference > 0 ? compatible / reference : 0.0) << "x)" << std::endl;
+	Console::Out() << '\t' << "table, exact:      " << std::format("{:8.2f}", exact / 1e6) << " M/s" << std::endl;
+	Console::Out() << '\t' << "strength only:     " << std::format("{:8.2f}", strength / 1e6) << " M/s" << std::endl;
+}
+
+namespace
+{
+	const char* BatchPathName(HandEvaluator::BatchPath path)
+	{
+		return path == HandEvaluator::BatchPath::Avx2 ? "avx2" : "scalar";
+	}
+}
+
+void Benchmark::HandEvalBatch(int hands, uint64_t seed)
+{
+	const auto sample = RandomHands(hands, seed);
+	std::array<std::vector<uint16_t>, 4> lanes;
+	for (auto& lane : lanes)
+		lane.resize(sample.size());
+	for (size_t i = 0; i < sample.size(); i++)
+	{
+		CardSet set;
+		for (const Card& card : sample[i])
+			set.Add(card);
+		for (int s = 0; s < 4; s++)
+			lanes[s][i] = set.Suit(s);
+	}
+	const std::array<const uint16_t*, 4> suits = { lanes[0].data(), lanes[1].data(), lanes[2].data(), lanes[3].data() };
+
+	std::vector<uint32_t> scalar(sample.size()), batch(sample.size());
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < sample.size(); i++)
+		scalar[i] = HandEvaluator::Strength({ suits[0][i], suits[1][i], suits[2][i], suits[3][i] });
+	const double scalarSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	start = std::chrono::steady_clock::now();
+	HandEvaluator::StrengthBatch(suits, batch.size(), batch.data());
+	const double batchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int mismatches = 0;
+	for (size_t i = 0; i < sample.size(); i++)
+	{
+		if (scalar[i] == batch[i])
+			continue;
+		if (mismatches++ < 5)
+			Console::Out() << "\tmismatch at " << i << ": scalar " << scalar[i] << ", batch " << batch[i] << std::endl;
+	}
+
+	const double scalarRate = scalarSeconds > 0 ? sample.size() / scalarSeconds : 0.0;
+	const double batchRate = batchSeconds > 0 ? sample.size() / batchSeconds : 0.0;
+	Console::Out() << "[BENCH BATCH] " << hands << " hands, seed " << seed << ", path " << BatchPathName(HandEvaluator::ActiveBatchPath())
+		<< ", mismatches vs scalar: " << mismatches << std::endl;
+	Console::Out() << '\t' << "scalar strength: " << std::format("{:8.2f}", scalarRate / 1e6) << " M/s" << std::endl;
+	Console::Out() << '\t' << "batch strength:  " << std::format("{:8.2f}", batchRate / 1e6) << " M/s ("
+		<< std::format("{:.1f}", scalarRate > 0 ? batchRate / scalarRate : 0.0) << "x)" << std::endl;
+}
+
+bool Benchmark::HandEvalExhaustive()
+{
+	constexpr size_t kChunk = 1 << 14;
+	std::array<std::vector<uint16_t>, 4> lanes;
+	for (auto& lane : lanes)
+		lane.resize(kChunk);
+	std::vector<uint32_t> strengths(kChunk);
+	const std::array<const uint16_t*, 4> suits = { lanes[0].data(), lanes[1].data(), lanes[2].data(), lanes[3].data() };
+
+	uint64_t hands = 0, mismatches = 0;
+	size_t filled = 0;
+	auto check = [&]() {
+		HandEvaluator::StrengthBatch(suits, filled, strengths.data());
+		for (size_t i = 0; i < filled; i++)
+		{
+			if (strengths[i] == HandEvaluator::Strength({ suits[0][i], suits[1][i], suits[2][i], suits[3][i] }))
+				continue;
+			if (mismatches++ < 5)
+				Console::Out() << "\tmismatch: lanes " << suits[0][i] << ' ' << suits[1][i] << ' ' << suits[2][i] << ' ' << suits[3][i]
+					<< ", batch " << strengths[i] << std::endl;
+		}
+		hands += filled;
+		filled = 0;
+	};
+
+	const auto start = std::chrono::steady_clock::now();
+	// seven strictly increasing card indices, the mask grown one card per level
+	for (int a = 0; a < 46; a++)
+	for (int b = a + 1; b < 47; b++)
+	for (int c = b + 1; c < 48; c++)
+	for (int d = c + 1; d < 49; d++)
+	for (int e = d + 1; e < 50; e++)
+	{
+		const uint64_t five = (1ull << a) | (1ull << b) | (1ull << c) | (1ull << d) | (1ull << e);
+		for (int f = e + 1; f < 51; f++)
+		for (int g = f + 1; g < 52; g++)
+		{
+			const CardSet hand(five | (1ull << f) | (1ull << g));
+			for (int s = 0; s < 4; s++)
+				lanes[s][filled] = hand.Suit(s);
+			if (++filled == kChunk)
+				check();
+		}
+	}
+	check();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	Console::Out() << "[BENCH BATCH ALL] " << hands << " hands, path " << BatchPathName(HandEvaluator::ActiveBatchPath())
+		<< ", mismatches vs scalar: " << mismatches << ", " << std::format("{:.1f}", seconds) << " s" << std::endl;
+	return mismatches == 0;
+}
+
+void Benchmark::AllInEquity(int players, uint64_t seed)
+{
+	DeckRng rng;
+	rng.Seed(RngPolicy::Fast, seed);
+	Deck deck;
+	std::vector<CardSet> hands((size_t)players);
+	for (CardSet& hand : hands)
+		hand = CardSet{ deck.Draw(rng), deck.Draw(rng) };
+	const CardSet flop{ deck.Draw(rng), deck.Draw(rng), deck.Draw(rng) };
+
+	Console::Out() << "[BENCH ALLIN] " << players << " players, seed " << seed << std::endl;
+	for (const CardSet board : { CardSet{}, flop })
+	{
+		const ExactEquity serial = EquityCalculator::Enumerate(hands, board, {}, false);
+		const ExactEquity parallel = EquityCalculator::Enumerate(hands, board);
+		const bool same = serial.equity == parallel.equity && serial.wins == parallel.wins && serial.ties == parallel.ties;
+		Console::Out() << '\t' << (board.Empty() ? "preflop: " : "flop:    ") << parallel.runouts << " runouts, one thread "
+			<< std::format("{:.1f}", serial.elapsedMs) << " ms, pool " << std::format("{:.1f}", parallel.elapsedMs) << " ms ("
+			<< std::format("{:.1f}", parallel.elapsedMs > 0 ? serial.elapsedMs / parallel.elapsedMs : 0.0) << "x)"
+			<< (same ? "" : ", RESULTS DIFFER") << std::endl;
+		Console::Out() << "\t\tequity";
+		for (double equity : parallel.equity)
+			Console::Out() << ' ' << std::format("{:.2f}%", equity * 100);
+		Console::Out() << std::endl;
+	}
+}
+
+void Benchmark::Shuffle(int deals, uint64_t seed)
+{
+	// a replay seed has to deal the same decks twice
+	DeckRng first, second;
+	first.Seed(RngPolicy::Secure, seed);
+	second.Seed(RngPolicy::Secure, seed);
+	Deck a, b;
+	bool replays = true;
+	for (int i = 0; i < 52; i++)
+		replays = replays && a.Draw(first) == b.Draw(second);
+
+	uint64_t checksum = 0;
+	auto report = [deals](const char* name, size_t stateBytes, double rate, const std::array<uint64_t, 52>& firstCards) {
+		Console::Out() << '\t' << name << " (" << stateBytes << " bytes): " << std::format("{:.0f}", rate) << " decks/s, "
+			<< std::format("{:.1f}", rate * 52 / 1e6) << " M cards/s, first-card chi-square "
+			<< std::format("{:.1f}", ChiSquare(firstCards, deals)) << std::endl;
+	};
+
+	Console::Out() << "[BENCH SHUFFLE] " << deals << " full decks, seed " << seed << ", replay "
+		<< (replays ? "matches" : "DIFFERS") << ", chacha20 RFC 7539 block " << (ChaChaKnownAnswer() ? "matches" : "DIFFERS") << std::endl;
+	{
+		// what Deck::Draw used before: a std::mt19937 per game and uniform_int_distribution per card
+		std::mt19937 rng((uint32_t)seed);
+		std::array<uint64_t, 52> firstCards{};
+		const double rate = DealRate(deals, [&rng](int left) {
+			return std::uniform_int_distribution<int>(0, left - 1)(rng);
+		}, firstCards, checksum);
+		report("mt19937  ", sizeof(rng), rate, firstCards);
+	}
+	for (const RngPolicy policy : { RngPolicy::Fast, RngPolicy::Secure })
+	{
+		DeckRng rng;
+		rng.Seed(policy, seed);
+		std::array<uint64_t, 52> firstCards{};
+		const double rate = DealRate(deals, [&rng](int left) { return (int)rng.Below((uint32_t)left); }, firstCards, checksum);
+		report(policy == RngPolicy::Fast ? "xoshiro  " : "chacha20 ", sizeof(rng), rate, firstCards);
+	}
+
+	// what every HoldemPokerGame, the throwaway ones built to print a table included, used to pay
+	const int constructions = 10000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < constructions; i++)
+	{
+		std::mt19937 rng(std::random_device{}());
+		checksum += rng();
+	}
+	const double seededUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / constructions;
+	Console::Out() << "\tconstruct + seed: mt19937 from random_device " << std::format("{:.2f}", seededUs)
+		<< " us, DeckRng nothing until the first draw (checksum " << (checksum & 0xFFFF) << ")" << std::endl;
+}
+
+void Benchmark::Seats(int hands, uint64_t seed)
+{
+	const int maxSeats = HoldemPokerGame::GetMaxSeats();
+	const bool allInEquity = HoldemPokerGame::IsAllInEquity();
+	// an all-in runout would time the equity enumeration instead of the engine
+	HoldemPokerGame::SetAllInEquity(false);
+	Console::Out() << "[BENCH SEATS] " << hands << " hands per table, seed " << seed << std::endl;
+	for (const int players : { 9, 10 })
+	{
+		HoldemPokerGame::SetMaxSeats(players);
+		HoldemPokerGame game;
+		game.SeedDeck(RngPolicy::Fast, seed);
+		game.SetBlinds(5, 10);
+		// spread out ids, as real player ids are
+		std::vector<int> ids;
+		for (int p = 0; p < players; p++)
+		{
+			int seatIdx = -1;
+			ids.push_back(100003 + p * 7919);
+			game.SitDown(ids.back(), -1, seatIdx);
+			game.BuyIn(ids.back(), game.GetMinBuyin());
+		}
+
+		// GetSeatByPlayerId scans the seats: at ten of them a hashed index measured no faster
+		const int lookups = 2000000;
+		int64_t checksum = 0;
+		auto lookupStart = std::chrono::steady_clock::now();
+		for (int i = 0; i < lookups; i++)
+		{
+			const Seat* seat = game.GetSeatByPlayerId(ids[i % players]);
+			checksum += seat ? seat->seatIndex : -1;
+		}
+		const double lookupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - lookupStart).count();
+		const double byPlayer = lookupSeconds > 0 ? lookups / lookupSeconds : 0.0;
+
+		// seeded bots: mostly calls, some folds and raises, rebuy when broke
+		Xoshiro256 rng(seed);
+		int64_t actions = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (int hand = 0; hand < hands; hand++)
+		{
+			for (int id : ids)
+				if (game.GetPlayerChips(id) < game.GetBigBlind())
+					game.BuyIn(id, game.GetMinBuyin());
+			game.StartHand();
+			for (int steps = 0; steps < 1000 && game.GetStage() != HoldemPokerGame::Stage::Waiting; steps++)
+			{
+				const int acting = game.ActingPlayerId();
+				if (acting < 0)
+					break;
+				const uint64_t roll = rng() % 16;
+				const HoldemPokerGame::Action action = roll < 3 ? HoldemPokerGame::Action::Fold
+					: roll < 14 ? HoldemPokerGame::Action::CheckCall : HoldemPokerGame::Action::Raise;
+				game.HandleAction(acting, action, game.GetBigBlind() * 2);
+				actions++;
+			}
+			game.ClearPendingHandResult();
+		}
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		Console::Out() << '\t' << players << " seats: by player id " << std::format("{:.1f}", byPlayer / 1e6)
+			<< " M lookups/s, " << actions << " actions in " << std::format("{:.1f}", seconds * 1000) << " ms, "
+			<< std::format("{:.0f}", seconds > 0 ? actions / seconds : 0.0) << " actions/s (checksum " << (checksum & 0xFFFF) << ")"
+			<< std::endl;
+	}
+	HoldemPokerGame::SetMaxSeats(maxSeats);
+	HoldemPokerGame::SetAllInEquity(allInEquity);
+}
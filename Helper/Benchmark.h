@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+// Micro benchmarks behind the BENCH console command. Each one first checks the fast
+// path against the code it replaced on the same inputs, then prints throughput of both.
+// Runs on the calling thread and blocks it, so keep the counts modest on a live session.
+class Benchmark
+{
+public:
+	// Random 7-card hands, one in ten with an unfinished board: the table evaluator in both
+	// score modes and bare HandEvaluator::Strength against HandEvaluator::EvaluateReference
+	static void HandEval(int hands, uint64_t seed);
+	// HandEvaluator::StrengthBatch on the active path against the scalar Strength, same hands
+	static void HandEvalBatch(int hands, uint64_t seed);
+	// Every one of the C(52,7) = 133,784,560 seven-card hands through StrengthBatch and
+	// Strength, compared one by one. Takes seconds to a minute depending on the machine.
+	static bool HandEvalExhaustive();
+	// EquityCalculator::Enumerate for random hands, preflop and on a random flop,
+	// on the calling thread alone and on the stealing pool
+	static void AllInEquity(int players, uint64_t seed);
+	// Whole decks dealt through CardSet::Nth the way Deck::Draw does, with the std::mt19937
+	// it used to take and with both DeckRng policies, plus a first-card uniformity check
+	static void Shuffle(int deals, uint64_t seed);
+	// Full 9- and 10-seat tables of bots playing seeded hands through HoldemPokerGame:
+	// seat lookups by player id and actions per second
+	static void Seats(int hands, uint64_t seed);
+};
@@ -81,6 +81,13 @@ void GameElementPrinter::Print(const HandResult& target, int roomId)
     for (const auto& c : target.communityCards)
         if (c.IsValid()) Console::OutW() << c.ToString() << " ";
     Console::Out() << std::endl;
+    if (target.HasEquity())
+    {
+        static const char* streets[] = { "preflop", "", "", "on the flop", "on the turn" };
+        Console::Out() << "All-in " << (target.equityBoardCards < 5 ? streets[target.equityBoardCards] : "")
+            << ", exact equity over " << target.equityRunouts << " runouts ("
+            << std::format("{:.1f}", target.equityMs) << " ms)" << std::endl;
+    }
 
     for (const auto& pr : target.playerResults)
     {
@@ -92,6 +99,8 @@ void GameElementPrinter::Print(const HandResult& target, int roomId)
             Console::OutW() << pr.holeCards[0].ToString() << " " << pr.holeCards[1].ToString();
             Console::Out() << " (" << HandEvaluator::ParseScore(pr.handRank) << ")";
         }
+        if (target.HasEquity() && pr.equity >= 0)
+            Console::Out() << " equity " << std::format("{:.1f}%", pr.equity * 100);
         if (pr.chipsWon > 0)
             Console::Out() << " WON " << pr.chipsWon;
         Console::Out() << std::endl;
@@ -76,6 +76,47 @@ namespace HelpStrings
   HELP -GENERIC                Show this help
   HELP -HOLDEM                 Show poker help
   PING                         Ping the server
+  NETHEALTH                    Show RTT/jitter/percentiles and clock offset
+  NETHEALTH <ms>               Set ping probe interval (0 = off)
+  NETHEALTH RESET              Clear network health stats
+  RPCSTAT                      Show per-RPC counts, latency and coroutine flows
+  RPCSTAT REQID <ON|OFF>       Tag requests with a request id on the wire
+  RPCSTAT COALESCE <ON|OFF>    Share one in-flight table info request per room
+  RPCSTAT REFRESH <ms>         Reuse a table info reply this recent instead of asking (0 = off)
+  RPCSTAT CHECK                Check that an untagged error fails the request it answers
+  QUEUESTAT                    Show this connection's lane depths, dispatch waits and loop counters
+  QUEUESTAT RESET              Clear inbound lane stats
+  QUEUESTAT PRIO <lane> <n>    Set lane priority, lower runs first (GAME/CONTROL/CHAT)
+  QUEUESTAT WAIT <lane> <ms>   Promote a lane once its oldest pack waited this long
+  QUEUESTAT BURST <n>          Give waiting lanes a turn after n higher packs
+  FAULTSTAT                    Show simulated network faults (client started with --faults)
+  FAULTSTAT RESET              Clear simulated fault stats
+  MUX                          Show sessions multiplexed over the shared connection
+  MUX OPEN <n>                 Open n more sessions on one shared connection
+  MUX <id|ALL> <command>       Run a command as that session, {id} becomes the session id
+  MUX CLOSE <id|ALL>           Close sessions, the shared connection stays up
+  MUX SHARDS <n>               Dispatch mux sessions on n threads (0 = one per core)
+  MUX VERBOSE <ON|OFF>         Print every pack of mux sessions, not only logins/errors
+  EQUITY [opponents] [ms]      Win/tie/lose odds of our hand in the current room (default 50 ms)
+  EQUITY <hole> [board|-] [opponents] [ms]
+                               Same for given cards, e.g. EQUITY AsKd Ts9h2c 2 100
+  EQUITY CANCEL                Stop the running EQUITY estimate
+  EQUITY ALLIN <ON|OFF>        Exact equities in the hand result when an all-in is run out (default OFF)
+  RANGE <board> <range> <range> [range...]
+                               Range against range equity on a flop, turn or river, e.g.
+                               RANGE Ks7d2c QQ+,AKs,ATs+ JJ-99,AQs+ T9s-65s:0.5 (blocks)
+  RANGE PARSE <range>          Show how many combos a range holds
+  RANGE CACHE [CLEAR]          Show or drop the cached range results
+  BENCH EVAL [hands] [seed]    Check the hand evaluator against the original and time both
+  BENCH BATCH [hands] [seed]   Check the batch evaluator against the scalar one and time both
+  BENCH BATCH ALL              Compare batch and scalar on every 7-card hand (slow)
+  BENCH BATCH <AUTO|SCALAR>    Batch evaluation on the best path the CPU has, or scalar only
+  BENCH ALLIN [players] [seed] Time exact all-in equity (2-10 players) preflop and on the flop
+  BENCH SHUFFLE [decks] [seed] Time dealing whole decks with the old mt19937 and both RNG policies
+  BENCH SEATS [hands] [seed]   Time seat lookups and bot hands on full 9- and 10-seat tables
+  EVALMODE [COMPAT|EXACT]      Show or set the hand score encoding of locally played hands
+  RNG [FAST|SECURE]            Show or set the generator new tables deal from (default SECURE)
+  RNG SEED <n|OFF>             Seed new tables from n so a rerun deals the same cards, or stop
   QUIT                         Close the client
 
 ================================================================================
@@ -150,6 +191,7 @@ namespace HelpStrings
     BUYIN <amount>       Buy chips from wallet to table
     STANDUP              Sit out from table
     TABLEINFO            Request current table state
+    SNAPSHOT [n]         Fetch table state through n concurrent awaitable requests
 
   GAME ACTIONS:
     CHECK                Check (when no bet to call)
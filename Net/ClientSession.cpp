@@ -0,0 +1,101 @@
+#include "pch.h"
+#include "ClientSession.h"
+#include "Utils/CoScheduler.h"
+
+ClientSession::RpcAwaiter::RpcAwaiter(Player& player, RpcEnum request, std::function<void(NetPack&)> writer, int timeoutMs) :
+	m_player(player),
+	m_request(request),
+	m_writer(std::move(writer)),
+	m_timeoutMs(timeoutMs)
+{
+}
+
+bool ClientSession::RpcAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	bool sent = m_player.Request(m_request, m_writer,
+		[this, handle](RequestTracker::Status status, NetPack* pack) {
+			m_result.status = status;
+			// the tracker's pack dies after the callback, keep a copy for the flow
+			if (pack)
+				m_result.pack = std::make_unique<NetPack>((uint8_t*)pack->GetContent());
+			CoScheduler::Inst().Post(handle);
+		}, m_timeoutMs);
+	// not sent: resume right away with NotSent
+	return sent;
+}
+
+ClientSession::RpcAwaiter ClientSession::Call(RpcEnum request, std::function<void(NetPack&)> writer, int timeoutMs)
+{
+	return RpcAwaiter(m_player, request, std::move(writer), timeoutMs);
+}
+
+Task<std::optional<HoldemTableSnapshot>> ClientSession::GetTableInfo(int room)
+{
+	RpcResult reply = co_await Call(RpcEnum::rpc_server_get_poker_table_info, [room](NetPack& pack) {
+		pack.WriteInt32(room);
+	});
+	if (!reply.Ok())
+		co_return std::nullopt;
+
+	// Format: roomId:i32, then HoldemTableSnapshot::Read format
+	// a reply matched without a wire id may be another room's pushed table
+	if (reply.pack->ReadInt32() != room)
+		co_return std::nullopt;
+	HoldemTableSnapshot snapshot{};
+	snapshot.Read(*reply.pack);
+	co_return snapshot;
+}
+
+Task<std::optional<int>> ClientSession::CreateRoom(uint16_t roomType)
+{
+	RpcResult reply = co_await Call(RpcEnum::rpc_server_create_room, [roomType](NetPack& pack) {
+		pack.WriteUInt16(roomType);
+	});
+	if (!reply.Ok())
+		co_return std::nullopt;
+	// Format: roomId:i32
+	co_return reply.pack->ReadInt32();
+}
+
+Task<bool> ClientSession::GotoRoom(int room)
+{
+	RpcResult reply = co_await Call(RpcEnum::rpc_server_goto_room, [room](NetPack& pack) {
+		pack.WriteInt32(room);
+	});
+	co_return reply.Ok();
+}
+
+Task<std::optional<ClientSession::SitDownReply>> ClientSession::SitDown(int room)
+{
+	RpcResult reply = co_await Call(RpcEnum::rpc_server_sit_down, [room](NetPack& pack) {
+		pack.WriteInt32(room);
+	});
+	if (!reply.Ok())
+		co_return std::nullopt;
+
+	// Format: seatIdx:i32, chips:i32, minBuyin:i32, bigBlind:i32, walletBalance:i32
+	SitDownReply result;
+	result.seatIndex = reply.pack->ReadInt32();
+	result.chips = reply.pack->ReadInt32();
+	result.minBuyin = reply.pack->ReadInt32();
+	result.bigBlind = reply.pack->ReadInt32();
+	result.walletBalance = reply.pack->ReadInt32();
+	co_return result;
+}
+
+Task<std::optional<ClientSession::BuyInReply>> ClientSession::BuyIn(int room, int amount)
+{
+	RpcResult reply = co_await Call(RpcEnum::rpc_server_poker_buyin, [room, amount](NetPack& pack) {
+		pack.WriteInt32(room);
+		pack.WriteInt32(amount);
+	});
+	if (!reply.Ok())
+		co_return std::nullopt;
+
+	// Format: result:u8, tableChips:i32, walletChips:i32
+	BuyInReply result;
+	result.result = static_cast<HoldemPokerGame::BuyInResult>(reply.pack->ReadUInt8());
+	result.tableChips = reply.pack->ReadInt32();
+	result.walletChips = reply.pack->ReadInt32();
+	co_return result;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <optional>
+#include "Net/RequestTracker.h"
+#include "Game/HoldemTableSnapshot.h"
+#include "Utils/Task.h"
+
+class Player;
+
+// Awaitable front end over Player::Request, for bots and scripts:
+//     auto table = co_await session.GetTableInfo(room);
+// Flows run under CoScheduler on the dispatch thread. Replies still go through
+// NetPackHandler first, so the console output is unchanged.
+// The session must outlive every flow that uses it.
+class ClientSession
+{
+public:
+	struct RpcResult
+	{
+		RequestTracker::Status status = RequestTracker::Status::NotSent;
+		std::unique_ptr<NetPack> pack;   // read position at the payload start, null unless a reply arrived
+		bool Ok() const
+		{
+			return (status == RequestTracker::Status::Ok || status == RequestTracker::Status::Cached) && pack != nullptr;
+		}
+	};
+
+	class RpcAwaiter
+	{
+	public:
+		RpcAwaiter(Player& player, RpcEnum request, std::function<void(NetPack&)> writer, int timeoutMs);
+		bool await_ready() const noexcept { return false; }
+		bool await_suspend(std::coroutine_handle<> handle);
+		RpcResult await_resume() { return std::move(m_result); }
+	private:
+		Player& m_player;
+		RpcEnum m_request;
+		std::function<void(NetPack&)> m_writer;
+		int m_timeoutMs;
+		RpcResult m_result;
+	};
+
+	struct BuyInReply
+	{
+		HoldemPokerGame::BuyInResult result = HoldemPokerGame::BuyInResult::PlayerNotFound;
+		int tableChips = 0;
+		int walletChips = 0;
+	};
+
+	struct SitDownReply
+	{
+		int seatIndex = -1;
+		int chips = 0;
+		int minBuyin = 0;
+		int bigBlind = 0;
+		int walletBalance = 0;
+	};
+
+	explicit ClientSession(Player& player) : m_player(player) {}
+
+	// Raw round trip for any rpc with a reply type
+	RpcAwaiter Call(RpcEnum request, std::function<void(NetPack&)> writer,
+		int timeoutMs = RequestTracker::kDefaultTimeoutMs);
+
+	// Typed round trips, empty on error, timeout or disconnect, and GetTableInfo also on a
+	// reply for another room
+	Task<std::optional<HoldemTableSnapshot>> GetTableInfo(int room);
+	Task<std::optional<int>> CreateRoom(uint16_t roomType);
+	Task<bool> GotoRoom(int room);
+	Task<std::optional<SitDownReply>> SitDown(int room);
+	Task<std::optional<BuyInReply>> BuyIn(int room, int amount);
+
+private:
+	Player& m_player;
+};
@@ -0,0 +1,206 @@
+#include "pch.h"
+#include "ClockSync.h"
+#include <algorithm>
+#include <vector>
+
+#undef min
+#undef max
+
+namespace
+{
+	double SteadyUs(std::chrono::steady_clock::time_point at)
+	{
+		return (double)std::chrono::duration_cast<std::chrono::microseconds>(at.time_since_epoch()).count();
+	}
+
+	// the local wall clock at a steady clock instant
+	int64_t WallClockMs(std::chrono::steady_clock::time_point at)
+	{
+		const auto wall = std::chrono::system_clock::now()
+			+ std::chrono::duration_cast<std::chrono::system_clock::duration>(at - std::chrono::steady_clock::now());
+		return std::chrono::duration_cast<std::chrono::milliseconds>(wall.time_since_epoch()).count();
+	}
+}
+
+ClockSync& ClockSync::Inst()
+{
+	static ClockSync inst{};
+	return inst;
+}
+
+void ClockSync::AddSample(const NetHealth::PingSample& sample)
+{
+	if (!sample.valid)
+		return;
+
+	// t0/t3 on the local steady clock, t1/t2 on the server clock, all in microseconds
+	const double t0 = (double)sample.clientSendSteadyUs;
+	const double t1 = (double)sample.serverRecvMs * 1000.0;
+	const double t2 = (double)sample.serverSendMs * 1000.0;
+	const double t3 = (double)sample.clientRecvSteadyUs;
+
+	Sample s;
+	s.localUs = t3;
+	s.delayUs = std::max(0.0, (t3 - t0) - (t2 - t1));
+	s.offsetUs = ((t1 - t0) + (t2 - t3)) / 2.0;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_samples.push_back(s);
+	if (m_samples.size() > kWindow)
+		m_samples.pop_front();
+	Refit();
+}
+
+void ClockSync::Reset()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_samples.clear();
+	m_synced = false;
+	m_fitCount = 0;
+	m_fitDrift = 0.0;
+	m_lastServerNowMs = 0;
+}
+
+void ClockSync::Refit()
+{
+	if (m_samples.empty())
+		return;
+
+	// minimum delay filter: keep the best quarter of the window (at least kMinFitSamples)
+	std::vector<Sample> sorted(m_samples.begin(), m_samples.end());
+	std::sort(sorted.begin(), sorted.end(), [](const Sample& a, const Sample& b) {
+		return a.delayUs < b.delayUs;
+	});
+	size_t keep = std::max(kMinFitSamples, sorted.size() / 4);
+	keep = std::min(keep, sorted.size());
+	sorted.resize(keep);
+	m_bestDelayUs = sorted.front().delayUs;
+
+	double meanX = 0.0, meanY = 0.0;
+	double minX = sorted.front().localUs, maxX = minX;
+	for (const Sample& s : sorted)
+	{
+		meanX += s.localUs;
+		meanY += s.offsetUs;
+		minX = std::min(minX, s.localUs);
+		maxX = std::max(maxX, s.localUs);
+	}
+	meanX /= (double)keep;
+	meanY /= (double)keep;
+
+	double drift = 0.0;
+	if (keep >= kMinFitSamples && maxX - minX >= kMinFitSpanUs)
+	{
+		double sxx = 0.0, sxy = 0.0;
+		for (const Sample& s : sorted)
+		{
+			sxx += (s.localUs - meanX) * (s.localUs - meanX);
+			sxy += (s.localUs - meanX) * (s.offsetUs - meanY);
+		}
+		if (sxx > 0.0)
+			drift = sxy / sxx;
+		// real oscillators stay within a few hundred ppm, anything larger is noise
+		drift = std::clamp(drift, -500e-6, 500e-6);
+	}
+
+	m_fitOriginUs = meanX;
+	m_fitOffsetUs = meanY;
+	m_fitDrift = drift;
+	m_fitCount = keep;
+	// the first fit replaces the wall clock fallback, which ServerNowMs must not hold on to
+	if (!m_synced)
+		m_lastServerNowMs = 0;
+	m_synced = true;
+}
+
+double ClockSync::OffsetAtLocked(double localUs) const
+{
+	return m_fitOffsetUs + m_fitDrift * (localUs - m_fitOriginUs);
+}
+
+bool ClockSync::IsSynced()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_synced;
+}
+
+double ClockSync::OffsetUs(std::chrono::steady_clock::time_point at)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_synced ? OffsetAtLocked(SteadyUs(at)) : 0.0;
+}
+
+double ClockSync::DriftPpm()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_fitDrift * 1e6;
+}
+
+int64_t ClockSync::ToServerTimeMs(std::chrono::steady_clock::time_point at)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return ToServerTimeMsLocked(at);
+}
+
+int64_t ClockSync::ToServerTimeMsLocked(std::chrono::steady_clock::time_point at) const
+{
+	// no estimate yet, fall back to the local wall clock
+	if (!m_synced)
+		return WallClockMs(at);
+	const double localUs = SteadyUs(at);
+	return (int64_t)((localUs + OffsetAtLocked(localUs)) / 1000.0);
+}
+
+int64_t ClockSync::ServerNowMs()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	int64_t now = ToServerTimeMsLocked(std::chrono::steady_clock::now());
+	if (!m_synced)
+		return now;
+	// a refit may move the estimate backwards by a little, never let callers see time run back
+	if (now < m_lastServerNowMs)
+		now = m_lastServerNowMs;
+	m_lastServerNowMs = now;
+	return now;
+}
+
+ClockSync::OneWayLatency ClockSync::CorrectLatency(const NetHealth::PingSample& sample)
+{
+	OneWayLatency result{};
+	if (!sample.valid)
+		return result;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!m_synced)
+		return result;
+
+	const double t0 = (double)sample.clientSendSteadyUs;
+	const double t3 = (double)sample.clientRecvSteadyUs;
+	const double t1 = (double)sample.serverRecvMs * 1000.0;
+	const double t2 = (double)sample.serverSendMs * 1000.0;
+	result.valid = true;
+	result.upMs = (t1 - (t0 + OffsetAtLocked(t0))) / 1000.0;
+	result.downMs = ((t3 + OffsetAtLocked(t3)) - t2) / 1000.0;
+	return result;
+}
+
+void ClockSync::Print()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Console::Out() << "[CLOCK SYNC]" << std::endl;
+	if (!m_synced)
+	{
+		Console::Out() << '\t' << "not synced yet" << std::endl;
+		return;
+	}
+	const double nowUs = SteadyUs(std::chrono::steady_clock::now());
+	const auto systemNowUs = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+	// offset against the local wall clock is what a user compares with other logs
+	const double wallOffsetMs = (nowUs + OffsetAtLocked(nowUs) - (double)systemNowUs) / 1000.0;
+	Console::Out() << '\t' << "server - local clock: " << std::format("{:.3f}", wallOffsetMs) << " ms" << std::endl;
+	Console::Out() << '\t' << "drift: " << std::format("{:.2f}", m_fitDrift * 1e6) << " ppm" << std::endl;
+	Console::Out() << '\t' << "best delay: " << std::format("{:.3f}", m_bestDelayUs / 1000.0) << " ms (error bound +-"
+		<< std::format("{:.3f}", m_bestDelayUs / 2000.0) << " ms)" << std::endl;
+	Console::Out() << '\t' << "fit samples: " << m_fitCount << " of " << m_samples.size() << std::endl;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include "Net/NetHealth.h"
+
+// NTP style estimate of the server clock relative to the local steady clock.
+// Each ping reply gives t0/t3 (local steady) and t1/t2 (server), so
+//   offset = ((t1 - t0) + (t2 - t3)) / 2,  delay = (t3 - t0) - (t2 - t1)
+// Only the lowest-delay samples of the window are trusted (queueing only ever
+// adds delay), and a least squares fit over them gives offset + drift so the
+// mapping stays accurate between pings.
+class ClockSync
+{
+public:
+	struct OneWayLatency
+	{
+		bool valid = false;
+		double upMs = 0.0;
+		double downMs = 0.0;
+	};
+
+	static ClockSync& Inst();
+
+	void AddSample(const NetHealth::PingSample& sample);
+	void Reset();
+
+	bool IsSynced();
+	// server clock minus local steady clock at the given local instant, in microseconds
+	double OffsetUs(std::chrono::steady_clock::time_point at);
+	double DriftPpm();
+	// monotonic server time in ms since the server epoch, for timestamping local events
+	int64_t ServerNowMs();
+	int64_t ToServerTimeMs(std::chrono::steady_clock::time_point at);
+	OneWayLatency CorrectLatency(const NetHealth::PingSample& sample);
+
+	void Print();
+
+private:
+	ClockSync() = default;
+
+	struct Sample
+	{
+		double localUs = 0.0;   // t3 on the steady clock
+		double delayUs = 0.0;
+		double offsetUs = 0.0;
+	};
+
+	void Refit();
+	double OffsetAtLocked(double localUs) const;
+	int64_t ToServerTimeMsLocked(std::chrono::steady_clock::time_point at) const;
+
+	static constexpr size_t kWindow = 64;
+	static constexpr size_t kMinFitSamples = 4;
+	static constexpr double kMinFitSpanUs = 5e6;
+
+	std::mutex m_mutex;
+	std::deque<Sample> m_samples;
+	bool m_synced = false;
+	double m_fitOriginUs = 0.0;
+	double m_fitOffsetUs = 0.0;
+	double m_fitDrift = 0.0;       // offset change per local microsecond
+	double m_bestDelayUs = 0.0;
+	size_t m_fitCount = 0;
+	int64_t m_lastServerNowMs = 0;   // ServerNowMs of the current estimate, 0 after Reset
+};
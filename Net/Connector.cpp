@@ -0,0 +1,318 @@
+#include "pch.h"
+#include "Connector.h"
+#include "Net/FaultInjectingTransport.h"
+#include "Net/ShmTransport.h"
+#include "Net/TcpTransport.h"
+#include <algorithm>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#undef min
+#undef max
+
+std::mutex Connector::s_mutex{};
+Connector::Options Connector::s_options{};
+Connector::Stats Connector::s_lastStats{};
+
+namespace
+{
+	struct Attempt
+	{
+		SOCKET socket = INVALID_SOCKET;
+		const addrinfo* address = nullptr;
+	};
+
+	int64_t ElapsedUs(std::chrono::steady_clock::time_point since)
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+	}
+
+	std::string FormatAddress(const sockaddr* addr)
+	{
+		char text[INET6_ADDRSTRLEN] = {};
+		if (addr->sa_family == AF_INET6)
+		{
+			inet_ntop(AF_INET6, &((const sockaddr_in6*)addr)->sin6_addr, text, sizeof(text));
+			return "[" + std::string(text) + "]:" + std::to_string(ntohs(((const sockaddr_in6*)addr)->sin6_port));
+		}
+		inet_ntop(AF_INET, &((const sockaddr_in*)addr)->sin_addr, text, sizeof(text));
+		return std::string(text) + ":" + std::to_string(ntohs(((const sockaddr_in*)addr)->sin_port));
+	}
+
+	// the resolver's first family leads, then the families alternate (RFC 8305 section 4)
+	std::vector<const addrinfo*> InterleaveFamilies(const addrinfo* list)
+	{
+		std::vector<const addrinfo*> preferred, other;
+		for (const addrinfo* ptr = list; ptr != NULL; ptr = ptr->ai_next)
+			(ptr->ai_family == list->ai_family ? preferred : other).push_back(ptr);
+		std::vector<const addrinfo*> ordered;
+		for (size_t i = 0; i < std::max(preferred.size(), other.size()); i++)
+		{
+			if (i < preferred.size()) ordered.push_back(preferred[i]);
+			if (i < other.size()) ordered.push_back(other[i]);
+		}
+		return ordered;
+	}
+
+	struct Resolution
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		bool done = false;
+		bool abandoned = false;      // the caller gave up, the resolver frees its own result
+		int error = 0;
+		addrinfo* result = nullptr;
+	};
+
+	// getaddrinfo has no timeout of its own, so it runs on a thread of its own. False if it
+	// has not answered by the deadline; it is left to finish in the background then.
+	bool Resolve(const std::string& host, const std::string& port, std::chrono::steady_clock::time_point deadline,
+		addrinfo*& result, int& error)
+	{
+		auto resolution = std::make_shared<Resolution>();
+		std::thread([resolution, host, port]() {
+			struct addrinfo hints{};
+			hints.ai_family = AF_UNSPEC;
+			hints.ai_socktype = SOCK_STREAM;
+			hints.ai_protocol = IPPROTO_TCP;
+			addrinfo* found = NULL;
+			const int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &found);
+			std::unique_lock<std::mutex> lock(resolution->mutex);
+			if (resolution->abandoned)
+			{
+				if (error == 0)
+					freeaddrinfo(found);
+				return;
+			}
+			resolution->error = error;
+			resolution->result = found;
+			resolution->done = true;
+			resolution->cv.notify_all();
+		}).detach();
+
+		std::unique_lock<std::mutex> lock(resolution->mutex);
+		if (!resolution->cv.wait_until(lock, deadline, [&resolution]() { return resolution->done; }))
+		{
+			resolution->abandoned = true;
+			return false;
+		}
+		error = resolution->error;
+		result = resolution->result;
+		return true;
+	}
+
+	// Non-blocking connect, INVALID_SOCKET if it failed on the spot
+	SOCKET StartConnect(const addrinfo* address, int& error)
+	{
+		SOCKET socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (socket == INVALID_SOCKET)
+		{
+			error = WSAGetLastError();
+			return INVALID_SOCKET;
+		}
+		unsigned long nonBlocking = 1;
+		ioctlsocket(socket, FIONBIO, &nonBlocking);
+		if (connect(socket, address->ai_addr, (int)address->ai_addrlen) == SOCKET_ERROR)
+		{
+			error = WSAGetLastError();
+			if (error != WSAEWOULDBLOCK && error != WSAEINPROGRESS)
+			{
+				closesocket(socket);
+				return INVALID_SOCKET;
+			}
+		}
+		return socket;
+	}
+}
+
+std::string Connector::Endpoint::ToString() const
+{
+	if (scheme == Scheme::Shm)
+		return "shm://" + name;
+	return "tcp://" + host + ":" + port;
+}
+
+bool Connector::ParseUri(const std::string& uri, Endpoint& endpoint)
+{
+	const size_t schemeEnd = uri.find("://");
+	const std::string scheme = schemeEnd == std::string::npos ? "tcp" : uri.substr(0, schemeEnd);
+	const std::string rest = schemeEnd == std::string::npos ? uri : uri.substr(schemeEnd + 3);
+	endpoint = Endpoint{};
+	if (scheme == "shm")
+	{
+		endpoint.scheme = Endpoint::Scheme::Shm;
+		endpoint.name = rest;
+		return !rest.empty() && rest.find_first_of("/\\") == std::string::npos;
+	}
+	if (scheme != "tcp")
+		return false;
+	const size_t colon = rest.rfind(':');
+	if (colon == std::string::npos || colon == 0 || colon + 1 == rest.size())
+		return false;
+	endpoint.host = rest.substr(0, colon);
+	endpoint.port = rest.substr(colon + 1);
+	return true;
+}
+
+std::unique_ptr<Transport> Connector::Open(const Endpoint& endpoint, bool quiet)
+{
+	FaultInjectingTransport::Profile profile;
+	std::string error;
+	if (!endpoint.faults.empty() && !FaultInjectingTransport::Profile::Parse(endpoint.faults, profile, error))
+	{
+		if (!quiet) Console::Err() << "bad fault profile: " << error << std::endl;
+		return nullptr;
+	}
+
+	std::unique_ptr<Transport> transport;
+	if (endpoint.scheme == Endpoint::Scheme::Shm)
+	{
+		transport = ShmTransport::Connect(endpoint.name, 2000, quiet);
+	}
+	else
+	{
+		SOCKET socket = Connect(endpoint.host, endpoint.port, quiet);
+		if (socket != INVALID_SOCKET)
+			transport = std::make_unique<TcpTransport>(socket);
+	}
+	if (transport && !endpoint.faults.empty())
+		transport = std::make_unique<FaultInjectingTransport>(std::move(transport), profile);
+	return transport;
+}
+
+SOCKET Connector::Connect(const std::string& host, const std::string& port, bool quiet)
+{
+	const Options options = GetOptions();
+	const auto start = std::chrono::steady_clock::now();
+	const auto deadline = start + std::chrono::milliseconds(options.timeoutMs);
+	Stats stats{};
+
+	struct addrinfo* result = NULL;
+	int iResult = 0;
+	const bool resolved = Resolve(host, port, deadline, result, iResult);
+	stats.resolveUs = ElapsedUs(start);
+	if (!resolved || iResult != 0)
+	{
+		if (!quiet && !resolved)
+			Console::Err() << "resolving " << host << " timed out after " << options.timeoutMs << " ms" << std::endl;
+		else if (!quiet)
+			Console::Err() << "getaddrinfo failed: " << iResult << std::endl;
+		stats.elapsedUs = stats.resolveUs;
+		stats.lastError = iResult;
+		RecordStats(stats);
+		return INVALID_SOCKET;
+	}
+
+	std::vector<const addrinfo*> candidates = InterleaveFamilies(result);
+	stats.addresses = candidates.size();
+	std::vector<Attempt> pending;
+	size_t next = 0;
+	auto nextStart = start;
+	SOCKET connectSocket = INVALID_SOCKET;
+	while (connectSocket == INVALID_SOCKET)
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (now >= deadline)
+			break;
+		// next address once the stagger delay passed, or right away if nothing is in flight
+		if (next < candidates.size() && (now >= nextStart || pending.empty()))
+		{
+			int error = 0;
+			SOCKET socket = StartConnect(candidates[next], error);
+			stats.attempts++;
+			if (socket != INVALID_SOCKET)
+				pending.push_back(Attempt{ socket, candidates[next] });
+			else
+				stats.lastError = error;
+			next++;
+			nextStart = now + std::chrono::milliseconds(options.attemptDelayMs);
+			continue;
+		}
+		// every address failed
+		if (pending.empty())
+			break;
+
+		const auto until = next < candidates.size() ? std::min(nextStart, deadline) : deadline;
+		const auto waitMs = std::chrono::duration_cast<std::chrono::milliseconds>(until - now).count() + 1;
+		std::vector<WSAPOLLFD> fds(pending.size());
+		for (size_t i = 0; i < pending.size(); i++)
+		{
+			fds[i].fd = pending[i].socket;
+			fds[i].events = POLLOUT;
+		}
+		if (WSAPoll(fds.data(), (unsigned long)fds.size(), (int)waitMs) <= 0)
+			continue;
+		for (size_t i = fds.size(); i-- > 0;)
+		{
+			if (fds[i].revents == 0)
+				continue;
+			int error = 0;
+			socklen_t errorLen = sizeof(error);
+			getsockopt(pending[i].socket, SOL_SOCKET, SO_ERROR, (char*)&error, &errorLen);
+			if (error == 0 && !(fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)))
+			{
+				connectSocket = pending[i].socket;
+				stats.address = FormatAddress(pending[i].address->ai_addr);
+				pending.erase(pending.begin() + i);
+				break;
+			}
+			stats.lastError = error;
+			closesocket(pending[i].socket);
+			pending.erase(pending.begin() + i);
+			// a refused address frees the way for the next one without waiting out the stagger
+			nextStart = now;
+		}
+	}
+	for (const Attempt& attempt : pending)
+		closesocket(attempt.socket);
+	freeaddrinfo(result);
+
+	if (connectSocket != INVALID_SOCKET)
+	{
+		// Player and ReconnectManager expect a blocking socket
+		unsigned long nonBlocking = 0;
+		ioctlsocket(connectSocket, FIONBIO, &nonBlocking);
+	}
+	stats.connected = connectSocket != INVALID_SOCKET;
+	stats.elapsedUs = ElapsedUs(start);
+	RecordStats(stats);
+	if (!stats.connected && !quiet)
+		Console::Err() << "connect to " << host << ":" << port << " failed after " << stats.attempts << "/"
+			<< stats.addresses << " address(es) in " << stats.elapsedUs / 1000 << " ms (last error "
+			<< stats.lastError << ")" << std::endl;
+	return connectSocket;
+}
+
+void Connector::SetOptions(const Options& options)
+{
+	std::unique_lock<std::mutex> lock(s_mutex);
+	s_options = options;
+}
+
+Connector::Options Connector::GetOptions()
+{
+	std::unique_lock<std::mutex> lock(s_mutex);
+	return s_options;
+}
+
+Connector::Stats Connector::LastStats()
+{
+	std::unique_lock<std::mutex> lock(s_mutex);
+	return s_lastStats;
+}
+
+void Connector::PrintStats()
+{
+	const Stats stats = LastStats();
+	Console::Out() << "[CONNECT] " << (stats.connected ? stats.address : std::string("failed"))
+		<< ": " << std::format("{:.2f}", stats.elapsedUs / 1000.0) << " ms (resolve "
+		<< std::format("{:.2f}", stats.resolveUs / 1000.0) << " ms), attempt " << stats.attempts
+		<< " of " << stats.addresses << " address(es)" << std::endl;
+}
+
+void Connector::RecordStats(const Stats& stats)
+{
+	std::unique_lock<std::mutex> lock(s_mutex);
+	s_lastStats = stats;
+}
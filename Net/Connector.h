@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class Transport;
+
+// Resolves host:port and opens a connected TCP socket, or opens a transport by URI.
+// Shared by the startup path in main.cpp and ReconnectManager.
+// TCP connects race all resolved addresses "happy eyeballs" style (RFC 8305): families
+// alternate, a new non-blocking attempt starts every attemptDelayMs (or as soon as one
+// fails) and the first socket to finish connecting wins.
+class Connector
+{
+public:
+	// tcp://host:port (also plain host:port) or shm://name
+	struct Endpoint
+	{
+		enum class Scheme { Tcp, Shm };
+		Scheme scheme = Scheme::Tcp;
+		std::string host;
+		std::string port;
+		std::string name;      // shm only
+		std::string faults;    // FaultInjectingTransport profile spec, empty = clean link
+		std::string ToString() const;
+	};
+
+	struct Options
+	{
+		int timeoutMs = 5000;        // whole Connect call, resolving included
+		int attemptDelayMs = 250;    // stagger between starting attempts
+	};
+
+	struct Stats
+	{
+		bool connected = false;
+		int64_t resolveUs = 0;
+		int64_t elapsedUs = 0;       // resolve + connect
+		size_t addresses = 0;
+		int attempts = 0;
+		std::string address;         // the winner, empty on failure
+		int lastError = 0;
+	};
+
+	// Returns INVALID_SOCKET on failure, errors are reported to Console::Err
+	static SOCKET Connect(const std::string& host, const std::string& port, bool quiet = false);
+	static bool ParseUri(const std::string& uri, Endpoint& endpoint);
+	// Returns nullptr on failure, errors are reported to Console::Err
+	static std::unique_ptr<Transport> Open(const Endpoint& endpoint, bool quiet = false);
+
+	static void SetOptions(const Options& options);
+	static Options GetOptions();
+	// Of the most recent TCP Connect (startup, or the last reconnect attempt)
+	static Stats LastStats();
+	static void PrintStats();
+
+private:
+	static void RecordStats(const Stats& stats);
+
+	static std::mutex s_mutex;
+	static Options s_options;
+	static Stats s_lastStats;
+};
@@ -0,0 +1,384 @@
+#include "pch.h"
+#include "FaultInjectingTransport.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#undef min
+#undef max
+
+namespace
+{
+	struct FaultStats
+	{
+		std::atomic<uint64_t> connections = 0;
+		std::atomic<uint64_t> bytesIn = 0;
+		std::atomic<uint64_t> bytesOut = 0;
+		std::atomic<uint64_t> chunks = 0;
+		std::atomic<uint64_t> splits = 0;
+		std::atomic<uint64_t> coalescedReads = 0;
+		std::atomic<uint64_t> resets = 0;
+		std::atomic<int64_t> totalDelayUs = 0;
+		std::atomic<int64_t> maxDelayUs = 0;
+	};
+	FaultStats g_stats;
+
+	// decorrelates the generators of successive connections (reconnects) and of the two directions
+	uint64_t MixSeed(uint64_t seed, uint64_t stream)
+	{
+		uint64_t z = seed + 0x9E3779B97F4A7C15ull * (stream + 1);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	bool ApplyPreset(const std::string& name, FaultInjectingTransport::Profile& profile)
+	{
+		FaultInjectingTransport::Profile preset{};
+		if (name == "lan")
+		{
+			preset.latencyMs = 1;
+		}
+		else if (name == "wifi")
+		{
+			preset.latencyMs = 15;
+			preset.jitterMs = 10;
+			preset.splitChance = 0.05;
+		}
+		else if (name == "3g")
+		{
+			preset.latencyMs = 120;
+			preset.jitterMs = 60;
+			preset.bandwidthBytesPerSec = 100 * 1024;
+			preset.splitChance = 0.1;
+			preset.coalesceMs = 40;
+		}
+		else if (name == "flaky")
+		{
+			preset.latencyMs = 40;
+			preset.jitterMs = 30;
+			preset.splitChance = 0.2;
+			preset.dropChance = 0.002;
+		}
+		else if (name == "chaos")
+		{
+			preset.latencyMs = 80;
+			preset.jitterMs = 80;
+			preset.bandwidthBytesPerSec = 50 * 1024;
+			preset.splitChance = 0.5;
+			preset.coalesceMs = 20;
+			preset.dropChance = 0.01;
+		}
+		else
+		{
+			return false;
+		}
+		preset.seed = profile.seed;
+		profile = preset;
+		return true;
+	}
+}
+
+bool FaultInjectingTransport::Profile::Parse(const std::string& spec, Profile& profile, std::string& error)
+{
+	profile = Profile{};
+	std::istringstream stream(spec);
+	std::string item;
+	bool first = true;
+	while (std::getline(stream, item, ','))
+	{
+		const size_t eq = item.find('=');
+		if (eq == std::string::npos)
+		{
+			if (!first || !ApplyPreset(item, profile))
+			{
+				error = "unknown fault preset " + item;
+				return false;
+			}
+			first = false;
+			continue;
+		}
+		first = false;
+		const std::string key = item.substr(0, eq);
+		const std::string value = item.substr(eq + 1);
+		try
+		{
+			if (key == "seed") profile.seed = std::stoull(value);
+			else if (key == "latency") profile.latencyMs = std::max(0, std::stoi(value));
+			else if (key == "jitter") profile.jitterMs = std::max(0, std::stoi(value));
+			else if (key == "bw") profile.bandwidthBytesPerSec = std::max<int64_t>(0, std::stoll(value));
+			else if (key == "split") profile.splitChance = std::clamp(std::stod(value), 0.0, 1.0);
+			else if (key == "coalesce") profile.coalesceMs = std::max(0, std::stoi(value));
+			else if (key == "drop") profile.dropChance = std::clamp(std::stod(value), 0.0, 1.0);
+			else if (key == "disconnect") profile.disconnectAfterMs = std::max(0, std::stoi(value));
+			else
+			{
+				error = "unknown fault key " + key;
+				return false;
+			}
+		}
+		catch (const std::exception&)
+		{
+			error = "bad value for fault key " + key;
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string FaultInjectingTransport::Profile::ToString() const
+{
+	return std::format("seed={},latency={},jitter={},bw={},split={},coalesce={},drop={},disconnect={}",
+		seed, latencyMs, jitterMs, bandwidthBytesPerSec, splitChance, coalesceMs, dropChance, disconnectAfterMs);
+}
+
+FaultInjectingTransport::FaultInjectingTransport(std::unique_ptr<Transport> inner, const Profile& profile) :
+	m_inner(std::move(inner)),
+	m_profile(profile),
+	m_openedAt(Clock::now())
+{
+	const uint64_t connection = g_stats.connections++;
+	m_in.rng.seed(MixSeed(profile.seed, connection * 2));
+	m_out.rng.seed(MixSeed(profile.seed, connection * 2 + 1));
+	m_inThread = std::thread(&FaultInjectingTransport::InboundJob, this);
+	m_outThread = std::thread(&FaultInjectingTransport::OutboundJob, this);
+}
+
+FaultInjectingTransport::~FaultInjectingTransport()
+{
+	Shutdown();
+	if (m_inThread.joinable())
+		m_inThread.join();
+	if (m_outThread.joinable())
+		m_outThread.join();
+}
+
+int FaultInjectingTransport::Recv(char* buffer, int length)
+{
+	std::unique_lock<std::mutex> lock(m_in.mutex);
+	while (true)
+	{
+		if (m_shutdown)
+			return 0;
+		if (!m_in.queue.empty())
+		{
+			const auto due = m_in.queue.front().due;
+			if (due <= Clock::now())
+				break;
+			m_in.cv.wait_until(lock, due);
+			continue;
+		}
+		if (m_broken)
+			return m_lastError == 0 ? 0 : -1;
+		m_in.cv.wait(lock);
+	}
+
+	// one chunk per call, so splits show up as partial reads; the coalesce grid releases
+	// several chunks at once and those are handed out together
+	const auto now = Clock::now();
+	int copied = 0;
+	int chunks = 0;
+	while (!m_in.queue.empty() && copied < length && m_in.queue.front().due <= now)
+	{
+		Chunk& chunk = m_in.queue.front();
+		const int count = std::min(length - copied, (int)chunk.bytes.size());
+		memcpy(buffer + copied, chunk.bytes.data(), count);
+		copied += count;
+		chunks++;
+		if (count < (int)chunk.bytes.size())
+		{
+			chunk.bytes.erase(chunk.bytes.begin(), chunk.bytes.begin() + count);
+			break;
+		}
+		m_in.queue.pop_front();
+		if (m_profile.coalesceMs <= 0)
+			break;
+	}
+	if (chunks > 1)
+		g_stats.coalescedReads++;
+	return copied;
+}
+
+bool FaultInjectingTransport::Send(const char* data, size_t length)
+{
+	if (m_broken)
+		return false;
+	g_stats.bytesOut += length;
+	Enqueue(m_out, data, length, false);
+	return true;
+}
+
+void FaultInjectingTransport::Shutdown()
+{
+	m_shutdown = true;
+	Break(WSAECONNRESET);
+}
+
+void FaultInjectingTransport::Break(int error)
+{
+	if (m_broken.exchange(true))
+	{
+		// a later Shutdown still has to wake the threads
+		m_in.cv.notify_all();
+		m_out.cv.notify_all();
+		return;
+	}
+	m_lastError = error;
+	if (error != 0)
+	{
+		// abrupt: whatever was in flight is gone
+		{
+			std::unique_lock<std::mutex> lock(m_in.mutex);
+			m_in.queue.clear();
+		}
+		std::unique_lock<std::mutex> lock(m_out.mutex);
+		m_out.queue.clear();
+	}
+	if (error != 0 && !m_shutdown)
+		g_stats.resets++;
+	m_inner->Shutdown();
+	m_in.cv.notify_all();
+	m_out.cv.notify_all();
+}
+
+void FaultInjectingTransport::InboundJob()
+{
+	char buffer[NET_PACK_MAX_LEN];
+	while (!m_broken)
+	{
+		int received = m_inner->Recv(buffer, sizeof(buffer));
+		if (received <= 0)
+		{
+			Break(received == 0 ? 0 : (m_inner->LastError() != 0 ? m_inner->LastError() : WSAECONNRESET));
+			return;
+		}
+		g_stats.bytesIn += received;
+		Enqueue(m_in, buffer, (size_t)received, true);
+	}
+}
+
+void FaultInjectingTransport::OutboundJob()
+{
+	const auto disconnectAt = m_profile.disconnectAfterMs > 0
+		? m_openedAt + std::chrono::milliseconds(m_profile.disconnectAfterMs) : Clock::time_point::max();
+	std::unique_lock<std::mutex> lock(m_out.mutex);
+	while (!m_broken)
+	{
+		if (Clock::now() >= disconnectAt)
+		{
+			lock.unlock();
+			Break(WSAECONNRESET);
+			return;
+		}
+		if (m_out.queue.empty() || m_out.queue.front().due > Clock::now())
+		{
+			auto until = m_out.queue.empty() ? disconnectAt : std::min(m_out.queue.front().due, disconnectAt);
+			if (until == Clock::time_point::max())
+				m_out.cv.wait(lock);
+			else
+				m_out.cv.wait_until(lock, until);
+			continue;
+		}
+		Chunk chunk = std::move(m_out.queue.front());
+		m_out.queue.pop_front();
+		lock.unlock();
+		// each chunk is its own write, so split chunks reach the peer as partial writes
+		if (!m_inner->Send(chunk.bytes.data(), chunk.bytes.size()))
+		{
+			Break(m_inner->LastError() != 0 ? m_inner->LastError() : WSAECONNRESET);
+			return;
+		}
+		lock.lock();
+	}
+}
+
+void FaultInjectingTransport::Enqueue(Direction& dir, const char* data, size_t length, bool inbound)
+{
+	std::unique_lock<std::mutex> lock(dir.mutex);
+	if (m_profile.dropChance > 0.0 && std::bernoulli_distribution(m_profile.dropChance)(dir.rng))
+	{
+		lock.unlock();
+		Break(WSAECONNRESET);
+		return;
+	}
+
+	std::vector<size_t> cuts;
+	if (length > 1 && m_profile.splitChance > 0.0 && std::bernoulli_distribution(m_profile.splitChance)(dir.rng))
+	{
+		const int pieces = std::uniform_int_distribution<int>(2, 4)(dir.rng);
+		std::uniform_int_distribution<size_t> at(1, length - 1);
+		for (int i = 1; i < pieces; i++)
+			cuts.push_back(at(dir.rng));
+		std::sort(cuts.begin(), cuts.end());
+		cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+		g_stats.splits++;
+	}
+	cuts.push_back(length);
+
+	size_t begin = 0;
+	for (size_t end : cuts)
+	{
+		const auto due = Schedule(dir, end - begin, inbound);
+		dir.queue.push_back(Chunk{ due, std::vector<char>(data + begin, data + end) });
+		begin = end;
+		g_stats.chunks++;
+	}
+	dir.cv.notify_all();
+}
+
+FaultInjectingTransport::Clock::time_point FaultInjectingTransport::Schedule(Direction& dir, size_t bytes, bool inbound)
+{
+	const auto now = Clock::now();
+	int delayMs = m_profile.latencyMs;
+	if (m_profile.jitterMs > 0)
+		delayMs += std::uniform_int_distribution<int>(-m_profile.jitterMs, m_profile.jitterMs)(dir.rng);
+	auto due = now + std::chrono::milliseconds(std::max(0, delayMs));
+
+	if (m_profile.bandwidthBytesPerSec > 0)
+	{
+		// the chunk occupies the wire after the previous one, then travels the latency
+		const auto onWire = std::max(now, dir.wireFree);
+		dir.wireFree = onWire + std::chrono::microseconds((int64_t)bytes * 1000000 / m_profile.bandwidthBytesPerSec);
+		due = std::max(due, dir.wireFree + std::chrono::milliseconds(m_profile.latencyMs));
+	}
+	// a stream stays in order, jitter can only bunch chunks up
+	due = std::max(due, dir.lastDue);
+	if (inbound && m_profile.coalesceMs > 0)
+	{
+		const auto grid = std::chrono::milliseconds(m_profile.coalesceMs);
+		const auto sinceOpen = due - m_openedAt;
+		due = m_openedAt + ((sinceOpen + grid - Clock::duration(1)) / grid) * grid;
+	}
+	dir.lastDue = due;
+
+	const int64_t delayUs = std::chrono::duration_cast<std::chrono::microseconds>(due - now).count();
+	g_stats.totalDelayUs += delayUs;
+	int64_t seen = g_stats.maxDelayUs;
+	while (delayUs > seen && !g_stats.maxDelayUs.compare_exchange_weak(seen, delayUs))
+	{
+	}
+	return due;
+}
+
+void FaultInjectingTransport::PrintStats()
+{
+	const uint64_t chunks = g_stats.chunks;
+	Console::Out() << "[FAULTS] connections " << g_stats.connections << ", resets " << g_stats.resets
+		<< ", bytes in/out " << g_stats.bytesIn << "/" << g_stats.bytesOut
+		<< ", chunks " << chunks << " (split " << g_stats.splits << ", coalesced reads " << g_stats.coalescedReads << ")"
+		<< ", delay avg " << std::format("{:.2f}", chunks ? g_stats.totalDelayUs / 1000.0 / chunks : 0.0)
+		<< " ms, max " << std::format("{:.2f}", g_stats.maxDelayUs / 1000.0) << " ms" << std::endl;
+}
+
+void FaultInjectingTransport::ResetStats()
+{
+	// connections stays, it feeds the per connection seeds
+	g_stats.bytesIn = 0;
+	g_stats.bytesOut = 0;
+	g_stats.chunks = 0;
+	g_stats.splits = 0;
+	g_stats.coalescedReads = 0;
+	g_stats.resets = 0;
+	g_stats.totalDelayUs = 0;
+	g_stats.maxDelayUs = 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Net/Transport.h"
+
+// Wraps another transport and makes it behave like a bad network, to exercise framing,
+// batching and reconnects locally. Both directions get latency with jitter and an optional
+// bandwidth cap, chunks can be split (partial reads and writes) or held back so several
+// packs arrive glued together, and the link can drop abruptly. Every decision comes from
+// a seeded generator per direction, so a scenario replays the same faults given the same traffic.
+// It has no PollHandle, so Player reads it on its recv thread.
+class FaultInjectingTransport : public Transport
+{
+public:
+	struct Profile
+	{
+		uint64_t seed = 1;
+		int latencyMs = 0;              // one way, both directions
+		int jitterMs = 0;               // uniform +- on top of the latency
+		int64_t bandwidthBytesPerSec = 0;   // per direction, 0 = unlimited
+		double splitChance = 0.0;       // a chunk is cut into 2-4 pieces
+		int coalesceMs = 0;             // inbound data is released on this grid, 0 = off
+		double dropChance = 0.0;        // per chunk, the link resets
+		int disconnectAfterMs = 0;      // the link resets once it is this old, 0 = never
+
+		// "<preset>[,key=value...]" or just "key=value,...". Presets: lan, wifi, 3g, flaky, chaos.
+		// Keys: seed, latency, jitter, bw, split, coalesce, drop, disconnect
+		static bool Parse(const std::string& spec, Profile& profile, std::string& error);
+		std::string ToString() const;
+	};
+
+	FaultInjectingTransport(std::unique_ptr<Transport> inner, const Profile& profile);
+	~FaultInjectingTransport() override;
+	FaultInjectingTransport(const FaultInjectingTransport&) = delete;
+	FaultInjectingTransport& operator=(const FaultInjectingTransport&) = delete;
+
+	int Recv(char* buffer, int length) override;
+	bool Send(const char* data, size_t length) override;
+	void Shutdown() override;
+	int LastError() const override { return m_lastError; }
+	const char* Kind() const override { return "fault"; }
+
+	// Totals over every wrapped connection
+	static void PrintStats();
+	static void ResetStats();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct Chunk
+	{
+		Clock::time_point due;
+		std::vector<char> bytes;
+	};
+	struct Direction
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::deque<Chunk> queue;
+		std::mt19937_64 rng;
+		Clock::time_point lastDue{};
+		Clock::time_point wireFree{};
+	};
+
+	void InboundJob();
+	void OutboundJob();
+	// Cuts data into chunks (maybe split) and queues them with their delivery time
+	void Enqueue(Direction& dir, const char* data, size_t length, bool inbound);
+	Clock::time_point Schedule(Direction& dir, size_t bytes, bool inbound);
+	// error 0: the peer closed, queued data is still delivered; otherwise an abrupt reset
+	void Break(int error);
+
+	std::unique_ptr<Transport> m_inner;
+	Profile m_profile;
+	Clock::time_point m_openedAt;
+	Direction m_in;
+	Direction m_out;
+	std::atomic<bool> m_broken = false;
+	std::atomic<bool> m_shutdown = false;
+	std::atomic<int> m_lastError = 0;
+	std::thread m_inThread;
+	std::thread m_outThread;
+};
@@ -0,0 +1,237 @@
+#include "pch.h"
+#include "NetHealth.h"
+#include "Net/ClockSync.h"
+#include "Net/ReconnectManager.h"
+#include "Net/RequestTracker.h"
+#include <cmath>
+
+#undef min
+#undef max
+
+namespace
+{
+	int64_t SystemNowMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	std::string FormatMs(double us)
+	{
+		return std::format("{:.2f} ms", us / 1000.0);
+	}
+
+	// a spike needs some history first, otherwise the very first samples look like spikes
+	constexpr uint64_t kSpikeWarmupSamples = 8;
+	constexpr int64_t kSpikeMinUs = 2000;
+
+	void PrintPingResult(const NetHealth::PingSample& sample, int64_t upLatencyMs)
+	{
+		// raw numbers mix both clocks, only the corrected ones mean anything one-way
+		auto oneWay = ClockSync::Inst().CorrectLatency(sample);
+		Console::Out() << "[PING RESULT]:" << std::endl;
+		if (oneWay.valid)
+		{
+			Console::Out() << '\t' << "UP LATENCY: " << std::format("{:.2f}", oneWay.upMs) << " Ms" << std::endl;
+			Console::Out() << '\t' << "DN LATENCY: " << std::format("{:.2f}", oneWay.downMs) << " Ms" << std::endl;
+		}
+		else
+		{
+			const int64_t DnLatencyMs = sample.clientRecvMs - sample.serverSendMs;
+			Console::Out() << '\t' << "UP LATENCY (unsynced): " << upLatencyMs << " Ms" << std::endl;
+			Console::Out() << '\t' << "DN LATENCY (unsynced): " << DnLatencyMs << " Ms" << std::endl;
+		}
+		Console::Out() << '\t' << "RTT: " << std::format("{:.2f}", sample.rttUs / 1000.0) << " Ms" << std::endl;
+	}
+}
+
+NetHealth& NetHealth::Inst()
+{
+	static NetHealth inst{};
+	return inst;
+}
+
+NetHealth::~NetHealth()
+{
+	Stop();
+}
+
+void NetHealth::Start(Player& player, int intervalMs)
+{
+	Stop();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_player = &player;
+	m_intervalMs = intervalMs;
+	m_stopped = false;
+	m_probeThread = std::thread(&NetHealth::ProbeJob, this);
+}
+
+void NetHealth::Stop()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stopped = true;
+	}
+	m_cv.notify_all();
+	if (m_probeThread.joinable())
+		m_probeThread.join();
+}
+
+void NetHealth::SetInterval(int intervalMs)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_intervalMs = std::max(0, intervalMs);
+	}
+	m_cv.notify_all();
+}
+
+void NetHealth::Reset()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_histogram.Reset();
+	m_srttUs = m_rttVarUs = m_jitterUs = 0.0;
+	m_lastRttUs = -1;
+	m_sent = m_received = m_lost = m_spikes = 0;
+	m_lastSpikeUs = 0;
+}
+
+void NetHealth::ProbeJob()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_stopped)
+	{
+		if (m_intervalMs <= 0)
+		{
+			m_cv.wait(lock, [this]() { return m_stopped || m_intervalMs > 0; });
+			continue;
+		}
+		if (m_cv.wait_for(lock, std::chrono::milliseconds(m_intervalMs), [this]() { return m_stopped; }))
+			break;
+
+		Player* player = m_player;
+		lock.unlock();
+		if (player && !player->Expired())
+			SendPing(*player, false);
+		lock.lock();
+	}
+}
+
+void NetHealth::SendPing(Player& player, bool manual)
+{
+	const auto nowMs = SystemNowMs();
+	const PendingPing ping{ manual, nowMs, std::chrono::steady_clock::now() };
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_sent++;
+	}
+	// a reply that never comes (eaten by a reconnect) times out in the tracker and counts as lost
+	const bool sent = player.Request(RpcEnum::rpc_server_ping, [nowMs](NetPack& pack) { pack.WriteInt64(nowMs); },
+		[this, ping](RequestTracker::Status status, NetPack* reply) {
+			OnPingReply(ping, status == RequestTracker::Status::Ok ? reply : nullptr);
+		}, kPingTimeoutMs);
+	if (!sent)
+		OnPingReply(ping, nullptr);
+}
+
+void NetHealth::OnPingReply(const PendingPing& ping, NetPack* reply)
+{
+	if (reply == nullptr)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_lost++;
+		return;
+	}
+	const auto now = std::chrono::steady_clock::now();
+	// Format: upLatencyMs:i64, serverSendMs:i64
+	const int64_t upLatencyMs = reply->ReadInt64();
+	PingSample sample{};
+	sample.serverSendMs = reply->ReadInt64();
+	sample.clientRecvMs = SystemNowMs();
+
+	sample.valid = true;
+	sample.manual = ping.manual;
+	sample.clientSendMs = ping.clientSendMs;
+	sample.serverRecvMs = ping.clientSendMs + upLatencyMs;
+	sample.clientSendSteadyUs = std::chrono::duration_cast<std::chrono::microseconds>(ping.sentAt.time_since_epoch()).count();
+	sample.clientRecvSteadyUs = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+	sample.rttUs = sample.clientRecvSteadyUs - sample.clientSendSteadyUs;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_received++;
+		RecordRtt(sample.rttUs);
+	}
+
+	ClockSync::Inst().AddSample(sample);
+	if (sample.manual)
+		PrintPingResult(sample, upLatencyMs);
+}
+
+void NetHealth::RecordRtt(int64_t rttUs)
+{
+	m_histogram.Record(rttUs);
+	const double rtt = (double)rttUs;
+
+	if (m_lastRttUs < 0)
+	{
+		// RFC 6298 initialisation
+		m_srttUs = rtt;
+		m_rttVarUs = rtt / 2.0;
+	}
+	else
+	{
+		bool spike = m_received > kSpikeWarmupSamples
+			&& rttUs > kSpikeMinUs
+			&& rtt > m_srttUs + 4.0 * m_rttVarUs
+			&& rtt > 2.0 * m_srttUs;
+		if (spike)
+		{
+			m_spikes++;
+			m_lastSpikeUs = rttUs;
+			m_lastSpikeAt = std::chrono::steady_clock::now();
+			Console::Out() << "[NET] latency spike: " << FormatMs(rtt) << " (srtt " << FormatMs(m_srttUs) << ")" << std::endl;
+		}
+
+		// RFC 3550 interarrival jitter on consecutive round trips
+		double delta = std::abs(rtt - (double)m_lastRttUs);
+		m_jitterUs += (delta - m_jitterUs) / 16.0;
+		m_rttVarUs = 0.75 * m_rttVarUs + 0.25 * std::abs(m_srttUs - rtt);
+		m_srttUs = 0.875 * m_srttUs + 0.125 * rtt;
+	}
+	m_lastRttUs = rttUs;
+}
+
+void NetHealth::Print()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Console::Out() << "[NET HEALTH]" << std::endl;
+	Console::Out() << '\t' << "probe interval: " << (m_intervalMs > 0 ? std::to_string(m_intervalMs) + " ms" : "off") << std::endl;
+	Console::Out() << '\t' << "pings: " << m_sent << " sent, " << m_received << " received, "
+		<< m_lost << " lost, " << (m_sent > m_received + m_lost ? m_sent - m_received - m_lost : 0) << " pending" << std::endl;
+	if (m_histogram.Count() == 0)
+	{
+		Console::Out() << '\t' << "no samples yet" << std::endl;
+	}
+	else
+	{
+		Console::Out() << '\t' << "rtt ewma: " << FormatMs(m_srttUs) << ", var: " << FormatMs(m_rttVarUs)
+			<< ", jitter: " << FormatMs(m_jitterUs) << std::endl;
+		Console::Out() << '\t' << "rtt min/mean/max: " << FormatMs((double)m_histogram.Min()) << " / "
+			<< FormatMs(m_histogram.Mean()) << " / " << FormatMs((double)m_histogram.Max()) << std::endl;
+		Console::Out() << '\t' << "rtt p50/p99/p999: " << FormatMs((double)m_histogram.Percentile(50.0)) << " / "
+			<< FormatMs((double)m_histogram.Percentile(99.0)) << " / " << FormatMs((double)m_histogram.Percentile(99.9)) << std::endl;
+		Console::Out() << '\t' << "spikes: " << m_spikes;
+		if (m_spikes > 0)
+		{
+			auto agoS = std::chrono::duration_cast<std::chrono::seconds>(
+				std::chrono::steady_clock::now() - m_lastSpikeAt).count();
+			Console::Out() << " (last " << FormatMs((double)m_lastSpikeUs) << ", " << agoS << " s ago)";
+		}
+		Console::Out() << std::endl;
+	}
+
+	ReconnectManager* reconnect = m_player ? m_player->GetReconnectManager() : nullptr;
+	lock.unlock();
+	if (reconnect)
+		reconnect->PrintStats();
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "Utils/LatencyHistogram.h"
+
+class NetPack;
+class Player;
+
+// Continuous round-trip tracking for the server connection.
+// A background prober sends rpc_server_ping at a fixed interval; every reply
+// (probe or manual PING) feeds EWMA RTT, jitter, a percentile histogram and
+// spike detection. Each ping is a request on the sending Player's RequestTracker,
+// so its reply is paired with it by wire id, or FIFO on that one connection, and
+// pings from mux sessions never take another session's reply.
+class NetHealth
+{
+public:
+	struct PingSample
+	{
+		bool valid = false;
+		bool manual = false;
+		int64_t clientSendMs = 0;    // t0, local system clock
+		int64_t serverRecvMs = 0;    // t1, server clock
+		int64_t serverSendMs = 0;    // t2, server clock
+		int64_t clientRecvMs = 0;    // t3, local system clock
+		int64_t clientSendSteadyUs = 0;  // t0 on the local steady clock
+		int64_t clientRecvSteadyUs = 0;  // t3 on the local steady clock
+		int64_t rttUs = 0;           // steady clock, includes server processing
+	};
+
+	static NetHealth& Inst();
+
+	void Start(Player& player, int intervalMs);
+	void Stop();
+	void SetInterval(int intervalMs);
+	int GetInterval() const { return m_intervalMs; }
+	void Reset();
+
+	void SendPing(Player& player, bool manual);
+
+	void Print();
+
+	~NetHealth();
+
+private:
+	NetHealth() = default;
+
+	struct PendingPing
+	{
+		bool manual = false;
+		int64_t clientSendMs = 0;
+		std::chrono::steady_clock::time_point sentAt{};
+	};
+
+	void ProbeJob();
+	// reply at the payload start, null if none came
+	void OnPingReply(const PendingPing& ping, NetPack* reply);
+	void RecordRtt(int64_t rttUs);
+
+	static constexpr int kPingTimeoutMs = 10000;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::thread m_probeThread;
+	Player* m_player = nullptr;
+	bool m_stopped = true;
+	int m_intervalMs = 0;
+
+	LatencyHistogram m_histogram;
+	double m_srttUs = 0.0;
+	double m_rttVarUs = 0.0;
+	double m_jitterUs = 0.0;
+	int64_t m_lastRttUs = -1;
+	uint64_t m_sent = 0;
+	uint64_t m_received = 0;
+	uint64_t m_lost = 0;
+	uint64_t m_spikes = 0;
+	int64_t m_lastSpikeUs = 0;
+	std::chrono::steady_clock::time_point m_lastSpikeAt{};
+};
@@ -33,11 +33,12 @@ NetPack::NetPack(uint8_t* stream)
 	std::memcpy(&rawType, stream, sizeof(rawType));
 	std::memcpy(&rawSize, stream + 2, sizeof(rawSize));
 
-	m_enumType = static_cast<RpcEnum>(rawType);
+	bool hasRequestId = (rawType & NET_PACK_REQUEST_ID_FLAG) != 0;
+	m_enumType = static_cast<RpcEnum>(rawType & ~NET_PACK_REQUEST_ID_FLAG);
 	m_size = rawSize;
 	m_readPos = 4;
 
-	if (m_enumType >= RpcEnum::INVALID || m_size < 4 || m_size > NET_PACK_MAX_LEN)
+	if (m_enumType >= RpcEnum::INVALID || m_size < (hasRequestId ? 8u : 4u) || m_size > NET_PACK_MAX_LEN)
 	{
 		m_enumType = RpcEnum::INVALID;
 		m_size = 0;
@@ -46,12 +47,22 @@ NetPack::NetPack(uint8_t* stream)
 	}
 
 	std::memcpy(m_content, stream, m_size);
+	if (hasRequestId)
+	{
+		// strip the trailer so readers see the plain payload
+		m_size -= 4;
+		std::memcpy(&m_requestId, m_content + m_size, 4);
+		uint16_t plainType = (uint16_t)m_enumType;
+		std::memcpy(m_content, &plainType, 2);
+		std::memcpy(m_content + 2, &m_size, 2);
+	}
 }
 NetPack::NetPack(NetPack&& src) noexcept
 {
 	std::memmove(&m_enumType, &src.m_enumType, 2);
 	std::memmove(&m_size, &src.m_size, sizeof(size_t));
 	std::memmove(&m_readPos, &src.m_readPos, sizeof(size_t));
+	m_requestId = src.m_requestId;
 	std::memmove(&m_content, &src.m_content, m_size);
 }
 
@@ -60,6 +71,7 @@ void NetPack::operator = (NetPack&& src) noexcept
 	std::memmove(&m_enumType, &src.m_enumType, 2);
 	std::memmove(&m_size, &src.m_size, sizeof(size_t));
 	std::memmove(&m_readPos, &src.m_readPos, sizeof(size_t));
+	m_requestId = src.m_requestId;
 	std::memmove(&m_content, &src.m_content, m_size);
 }
 
@@ -232,6 +244,46 @@ void NetPack::WriteUInt32(uint32_t val, int atPos)
 	std::memcpy(m_content + 2, &m_size, 2);
 }
 
+void NetPack::AttachRequestId(uint32_t requestId)
+{
+	uint16_t rawType = 0;
+	std::memcpy(&rawType, m_content, 2);
+	if (requestId == 0 || (rawType & NET_PACK_REQUEST_ID_FLAG) != 0)
+		return;
+	WriteUInt32(requestId);
+	m_requestId = requestId;
+	uint16_t flaggedType = (uint16_t)m_enumType | NET_PACK_REQUEST_ID_FLAG;
+	std::memcpy(m_content, &flaggedType, 2);
+}
+
 const char* NetPack::GetContent() { return (char*)m_content; }
 size_t NetPack::Length() { return m_size; }
 RpcEnum NetPack::MsgType() { return m_enumType; }
+
+bool NetPackFramer::Feed(const char* data, size_t len, const std::function<void(NetPack&&)>& onPack)
+{
+	m_pending.insert(m_pending.end(), (const uint8_t*)data, (const uint8_t*)data + len);
+
+	size_t offset = 0;
+	bool ok = true;
+	while (m_pending.size() - offset >= 4)
+	{
+		uint16_t packSize = 0;
+		std::memcpy(&packSize, m_pending.data() + offset + 2, sizeof(packSize));
+		if (packSize < 4 || packSize > NET_PACK_MAX_LEN)
+		{
+			ok = false;
+			break;
+		}
+		if (m_pending.size() - offset < packSize)
+			break;
+		onPack(NetPack(m_pending.data() + offset));
+		offset += packSize;
+	}
+
+	if (!ok)
+		m_pending.clear();
+	else if (offset > 0)
+		m_pending.erase(m_pending.begin(), m_pending.begin() + offset);
+	return ok;
+}
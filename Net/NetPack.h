@@ -1,13 +1,18 @@
 #pragma once
 #include "RpcEnum.h"
+#include <functional>
+#include <vector>
 
 #define NET_PACK_MAX_LEN 4096
+// set in the type field when the last 4 bytes of the payload carry a request id
+#define NET_PACK_REQUEST_ID_FLAG 0x8000
 
 class NetPack
 {
 	RpcEnum m_enumType = RpcEnum::INVALID;
 	size_t m_readPos = 0;
 	size_t m_size = 0;
+	uint32_t m_requestId = 0;
 	uint8_t m_content[NET_PACK_MAX_LEN];
 public:
 	NetPack() = delete;
@@ -20,6 +25,13 @@ public:
 	const char* GetContent();
 	size_t Length();
 	RpcEnum MsgType();
+	// 0 when the pack carries no request id
+	uint32_t RequestId() const { return m_requestId; }
+	// appends the id and flags the header, must be the last write
+	void AttachRequestId(uint32_t requestId);
+	void ResetReadPos() { m_readPos = 4; }
+	// payload bytes not read yet, lets a reader accept packs from senders without a newer trailing field
+	size_t Unread() const { return m_size > m_readPos ? m_size - m_readPos : 0; }
 
 	//read
 	float ReadFloat();
@@ -47,3 +59,14 @@ public:
 	uint8_t* DebugGetContent() { return (uint8_t*)m_content; }
 };
 
+// Reassembles NetPacks from a byte stream.
+// A single recv may carry half a pack or several packs back to back
+// (e.g. the burst of replies after a reconnect), so frames are cut by the size header.
+class NetPackFramer
+{
+	std::vector<uint8_t> m_pending;
+public:
+	// Returns false if the stream is corrupt (size header out of range)
+	bool Feed(const char* data, size_t len, const std::function<void(NetPack&&)>& onPack);
+	void Reset() { m_pending.clear(); }
+};
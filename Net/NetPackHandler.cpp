@@ -5,22 +5,186 @@
 #include "Helper/GameElementPrinter.h"
 #include "ServerClass/Room.h"
 #include "Audio/AudioCenter.h"
+#include "Net/RequestTracker.h"
+#include "Net/SessionEvents.h"
+#include "Utils/ShardedExecutor.h"
 
-std::queue<NetPack> NetPackHandler::_taskList = std::queue<NetPack>();
-std::mutex NetPackHandler::_mutex{};
-void NetPackHandler::AddTask(NetPack&& pack)
+std::atomic<bool> NetPackHandler::_muxVerbose = false;
+
+NetPackHandler::NetPackHandler()
+{
+	m_lanes[(size_t)Lane::Game].priority = 0;
+	m_lanes[(size_t)Lane::Control].priority = 1;
+	m_lanes[(size_t)Lane::Control].maxWaitMs = 200;
+	m_lanes[(size_t)Lane::Chat].priority = 2;
+	m_lanes[(size_t)Lane::Chat].maxWaitMs = 1000;
+}
+NetPackHandler::~NetPackHandler()
+{
+	Detach();
+}
+
+NetPackHandler::Lane NetPackHandler::GetLane(RpcEnum msgType)
 {
-	std::unique_lock<std::mutex> lock(_mutex);
-	_taskList.push(std::move(pack));
+	switch (msgType)
+	{
+	case RpcEnum::rpc_client_get_poker_table_info:
+	case RpcEnum::rpc_client_poker_hand_result:
+	case RpcEnum::rpc_client_sit_down:
+	case RpcEnum::rpc_client_poker_buyin:
+	case RpcEnum::rpc_client_poker_standup:
+	case RpcEnum::rpc_client_poker_set_blinds:
+	// ping replies are timestamped when dispatched, queueing them would inflate the RTT
+	case RpcEnum::rpc_client_ping:
+		return Lane::Game;
+	case RpcEnum::rpc_client_send_text:
+		return Lane::Chat;
+	default:
+		return Lane::Control;
+	}
+}
+const char* NetPackHandler::GetLaneName(Lane lane)
+{
+	switch (lane)
+	{
+	case Lane::Game: return "game";
+	case Lane::Control: return "control";
+	case Lane::Chat: return "chat";
+	default: return "invalid";
+	}
+}
+
+void NetPackHandler::AddTask(NetPack&& pack, RequestTracker* tracker, uint16_t session)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	LaneState& lane = m_lanes[(size_t)GetLane(pack.MsgType())];
+	lane.tasks.push(Task{ std::move(pack), tracker, std::chrono::steady_clock::now(), session });
+	lane.enqueued++;
+	if (lane.tasks.size() > lane.maxDepth)
+		lane.maxDepth = lane.tasks.size();
+	// under the lock, so Detach never returns with a wake still on its way
+	if (m_wakeHook)
+		m_wakeHook();
+}
+void NetPackHandler::SetWakeHook(std::function<void()> hook)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_wakeHook = std::move(hook);
+}
+void NetPackHandler::RunOn(ShardedExecutor& executor, size_t shard)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_executor = &executor;
+	m_shard = shard;
+	// one drain in flight at a time, packs arriving meanwhile ride along with it
+	m_wakeHook = [this]() {
+		if (m_drainQueued.exchange(true))
+			return;
+		m_executor->Post(m_shard, [this]() {
+			m_drainQueued = false;
+			while (DoOneTask() != 1) {}
+		});
+	};
+	for (auto& lane : m_lanes)
+	{
+		if (!lane.tasks.empty())
+		{
+			m_wakeHook();
+			break;
+		}
+	}
+}
+void NetPackHandler::Detach()
+{
+	ShardedExecutor* executor = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_wakeHook = nullptr;
+		executor = m_executor;
+		m_executor = nullptr;
+	}
+	if (executor)
+		executor->Flush(m_shard);
+}
+NetPackHandler::LaneState* NetPackHandler::PickLaneLocked(std::chrono::steady_clock::time_point now, bool& promoted)
+{
+	promoted = false;
+	LaneState* best = nullptr;
+	LaneState* starving = nullptr;
+	for (auto& lane : m_lanes)
+	{
+		if (lane.tasks.empty())
+			continue;
+		if (best == nullptr || lane.priority < best->priority)
+			best = &lane;
+		// among lanes past their wait limit the lowest priority one is the most starved
+		if (lane.maxWaitMs > 0 && now - lane.tasks.front().enqueuedAt >= std::chrono::milliseconds(lane.maxWaitMs)
+			&& (starving == nullptr || lane.priority > starving->priority))
+			starving = &lane;
+	}
+	if (best == nullptr)
+		return nullptr;
+
+	// the burst counter only runs while something lower is waiting
+	bool lowerWaiting = false;
+	LaneState* lowest = best;
+	for (auto& lane : m_lanes)
+	{
+		if (lane.tasks.empty() || &lane == best)
+			continue;
+		lowerWaiting = true;
+		if (lane.priority > lowest->priority)
+			lowest = &lane;
+	}
+	if (!lowerWaiting)
+	{
+		m_burst = 0;
+		return best;
+	}
+	if (starving != nullptr && starving != best)
+	{
+		m_burst = 0;
+		promoted = true;
+		return starving;
+	}
+	if (m_maxBurst > 0 && ++m_burst > m_maxBurst)
+	{
+		m_burst = 0;
+		promoted = true;
+		return lowest;
+	}
+	return best;
 }
 int NetPackHandler::DoOneTask()
 {
-	std::unique_lock<std::mutex> lock(_mutex);
-	if (_taskList.size() == 0)
+	std::unique_lock<std::mutex> lock(m_mutex);
+	const auto now = std::chrono::steady_clock::now();
+	bool promoted = false;
+	LaneState* lane = PickLaneLocked(now, promoted);
+	if (lane == nullptr)
 		return 1; // no task to do
 
-	auto& task = _taskList.front();
-	_taskList.pop();
+	// move out before pop, the handlers below must not touch a destroyed queue slot
+	Task queued = std::move(lane->tasks.front());
+	lane->tasks.pop();
+	const int64_t waitUs = std::chrono::duration_cast<std::chrono::microseconds>(now - queued.enqueuedAt).count();
+	lane->dispatched++;
+	lane->totalWaitUs += waitUs;
+	if (waitUs > lane->maxWaitUs)
+		lane->maxWaitUs = waitUs;
+	if (promoted)
+		lane->promoted++;
+	lock.unlock();
+
+	if (queued.session != 0)
+	{
+		HandleMuxTask(queued);
+		if (queued.tracker)
+			queued.tracker->OnResponse(queued.pack);
+		return 0;
+	}
+
+	NetPack& task = queued.pack;
 
 	if (task.MsgType() == RpcEnum::rpc_client_send_text)
 	{
@@ -28,20 +192,24 @@ int NetPackHandler::DoOneTask()
 		auto speakerInfo = PlayerInfo(task);
 		auto msg = task.ReadString();
 		bool includeName = task.ReadInt8() == 1;
-		if (includeName)
+		// headless runs never start TTS
+		if (AudioCenter::IsEnabled())
 		{
-			std::string saidString = "said";
-			switch (speakerInfo.GetLanguage())
+			if (includeName)
 			{
-			case Chinese:
-				saidString = "˵";
-				break;
-			default: break;
+				std::string saidString = "said";
+				switch (speakerInfo.GetLanguage())
+				{
+				case Chinese:
+					saidString = "˵";
+					break;
+				default: break;
+				}
+				AudioCenter::Inst().AddVoiceMsg(std::format("{} {} {}", speakerInfo.GetName().c_str(), saidString, msg.c_str()), speakerInfo.GetLanguage());
 			}
-			AudioCenter::Inst().AddVoiceMsg(std::format("{} {} {}", speakerInfo.GetName().c_str(), saidString, msg.c_str()), speakerInfo.GetLanguage());
+			else
+				AudioCenter::Inst().AddVoiceMsg(msg.c_str(), speakerInfo.GetLanguage());
 		}
-		else
-			AudioCenter::Inst().AddVoiceMsg(msg.c_str(), speakerInfo.GetLanguage());
 		Console::Out() << speakerInfo.GetName() << ": " << msg << std::endl;
 	}
 	else if (task.MsgType() == RpcEnum::rpc_client_log_in)
@@ -50,6 +218,7 @@ int NetPackHandler::DoOneTask()
 		Console::Out() << "log in success" << std::endl;
 		auto playerInfo = PlayerInfo(task);
 		GameElementPrinter::Print(playerInfo);
+		SessionEvents::Inst().OnLogin(playerInfo.GetID());
 	}
 	else if (task.MsgType() == RpcEnum::rpc_client_print_room)
 	{
@@ -105,6 +274,7 @@ int NetPackHandler::DoOneTask()
 		// Format: errCode:u16
 		auto errCode = task.ReadUInt16();
 		Console::Out() << "Server sent error code: " << errCode << std::endl;
+		SessionEvents::Inst().OnError(errCode);
 	}
 	else if (task.MsgType() == RpcEnum::rpc_client_tick)
 	{
@@ -118,6 +288,7 @@ int NetPackHandler::DoOneTask()
 		HoldemPokerGame localGame;
 		localGame.ReadTable(task);
 		GameElementPrinter::Print(localGame, roomId);
+		SessionEvents::Inst().OnTableInfo(roomId, localGame.ActingPlayerId());
 	}
 	else if (task.MsgType() == RpcEnum::rpc_client_sit_down)
 	{
@@ -194,18 +365,82 @@ int NetPackHandler::DoOneTask()
 		HandResult result;
 		result.Read(task);
 		GameElementPrinter::Print(result, roomId);
+		SessionEvents::Inst().OnHandResult(roomId);
+	}
+	// rpc_client_ping completes its request below, NetHealth takes it from there
+
+	if (queued.tracker)
+		queued.tracker->OnResponse(task);
+	return 0;
+}
+
+void NetPackHandler::HandleMuxTask(Task& queued)
+{
+	NetPack& task = queued.pack;
+	if (task.MsgType() == RpcEnum::rpc_client_log_in)
+	{
+		// Format: id:u32, nickname:string, language:u32
+		auto playerInfo = PlayerInfo(task);
+		Console::Out() << "[session " << queued.session << "] logged in as " << playerInfo.GetName()
+			<< " (id " << playerInfo.GetID() << ")" << std::endl;
+	}
+	else if (task.MsgType() == RpcEnum::rpc_client_error_respond)
+	{
+		// Format: errCode:u16
+		Console::Out() << "[session " << queued.session << "] server sent error code: " << task.ReadUInt16() << std::endl;
 	}
-	else if (task.MsgType() == RpcEnum::rpc_client_ping)
+	else if (_muxVerbose)
 	{
-		const int64_t UpLatencyMs = task.ReadInt64();
-		const int64_t serverSendMs = task.ReadInt64();
-		const auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-			std::chrono::system_clock::now().time_since_epoch()).count();
-		const int64_t DnLatencyMs = nowMs - serverSendMs;
-		Console::Out() << "[PING RESULT]:" << std::endl;
-		Console::Out() << '\t' << "UP LATENCY: " << UpLatencyMs << " Ms"  << std::endl;
-		Console::Out() << '\t' << "DN LATENCY: " << DnLatencyMs << " Ms" << std::endl;
+		Console::Out() << "[session " << queued.session << "] " << GetRpcName(task.MsgType())
+			<< " (" << task.Length() << " bytes)" << std::endl;
 	}
+	task.ResetReadPos();
+}
 
-	return 0;
+void NetPackHandler::SetLanePriority(Lane lane, int priority)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_lanes[(size_t)lane].priority = priority;
+}
+void NetPackHandler::SetLaneMaxWait(Lane lane, int maxWaitMs)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_lanes[(size_t)lane].maxWaitMs = maxWaitMs;
+}
+void NetPackHandler::SetMaxBurst(int maxBurst)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_maxBurst = maxBurst;
+	m_burst = 0;
+}
+void NetPackHandler::PrintStats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Console::Out() << "[QUEUE STATS] max burst: " << m_maxBurst << std::endl;
+	for (size_t i = 0; i < m_lanes.size(); i++)
+	{
+		const LaneState& lane = m_lanes[i];
+		const double meanWaitMs = lane.dispatched > 0 ? lane.totalWaitUs / 1000.0 / lane.dispatched : 0.0;
+		Console::Out() << '\t' << GetLaneName((Lane)i)
+			<< ": prio " << lane.priority
+			<< ", max wait " << lane.maxWaitMs << " ms"
+			<< ", depth " << lane.tasks.size() << " (max " << lane.maxDepth << ")"
+			<< ", in " << lane.enqueued << ", out " << lane.dispatched
+			<< ", promoted " << lane.promoted
+			<< ", wait avg " << std::format("{:.2f}", meanWaitMs) << " ms"
+			<< ", wait max " << std::format("{:.2f}", lane.maxWaitUs / 1000.0) << " ms" << std::endl;
+	}
+}
+void NetPackHandler::ResetStats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (auto& lane : m_lanes)
+	{
+		lane.enqueued = 0;
+		lane.dispatched = 0;
+		lane.promoted = 0;
+		lane.maxDepth = lane.tasks.size();
+		lane.totalWaitUs = 0;
+		lane.maxWaitUs = 0;
+	}
 }
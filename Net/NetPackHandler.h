@@ -1,12 +1,93 @@
 #pragma once
-#include "Player/Player.h"
+#include "Net/NetPack.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <queue>
 
+class RequestTracker;
+class ShardedExecutor;
+// Inbound dispatcher of one connection: every Player owns one, so connections do not share
+// a queue or a lock. Whoever drains it (the EventLoop for the console's own connection, a
+// ShardedExecutor shard for multiplexed sessions) is its dispatch thread.
 class NetPackHandler
 {
-	static std::queue<NetPack> _taskList;
-	static std::mutex _mutex;
 public:
-	static void AddTask(NetPack&& pack);
-	static int DoOneTask();
+	// Inbound packs are queued per lane so a chat burst (which also feeds TTS)
+	// cannot hold up table state or turn notifications.
+	enum class Lane : uint8_t
+	{
+		Game = 0,
+		Control = 1,
+		Chat = 2,
+		Count
+	};
+
+private:
+	struct Task
+	{
+		NetPack pack;
+		RequestTracker* tracker = nullptr;
+		std::chrono::steady_clock::time_point enqueuedAt{};
+		uint16_t session = 0;      // SessionMux session, 0 for the console's own connection
+	};
+	struct LaneState
+	{
+		std::queue<Task> tasks;
+		int priority = 0;          // lower runs first
+		int maxWaitMs = 0;         // older than this jumps ahead of higher lanes, 0 = never
+		uint64_t enqueued = 0;
+		uint64_t dispatched = 0;
+		uint64_t promoted = 0;     // dispatched ahead of its priority by starvation protection
+		size_t maxDepth = 0;
+		int64_t totalWaitUs = 0;
+		int64_t maxWaitUs = 0;
+	};
+	std::array<LaneState, (size_t)Lane::Count> m_lanes;
+	std::mutex m_mutex;
+	std::function<void()> m_wakeHook;   // under m_mutex
+	// a waiting lane gets one turn after this many packs from higher lanes, 0 = never
+	int m_maxBurst = 32;
+	int m_burst = 0;
+	ShardedExecutor* m_executor = nullptr;
+	size_t m_shard = 0;
+	std::atomic<bool> m_drainQueued = false;
+	static std::atomic<bool> _muxVerbose;
+
+	LaneState* PickLaneLocked(std::chrono::steady_clock::time_point now, bool& promoted);
+	// Packs of multiplexed bot sessions: only logins and errors are printed, tagged with the
+	// session, and SessionEvents (which describes the console's own session) is left alone
+	static void HandleMuxTask(Task& task);
+public:
+	NetPackHandler();
+	~NetPackHandler();
+	NetPackHandler(const NetPackHandler&) = delete;
+	NetPackHandler& operator=(const NetPackHandler&) = delete;
+
+	static Lane GetLane(RpcEnum msgType);
+	static const char* GetLaneName(Lane lane);
+
+	// tracker, when given, gets to complete the matching request after the pack is handled
+	void AddTask(NetPack&& pack, RequestTracker* tracker = nullptr, uint16_t session = 0);
+	int DoOneTask();
+	// Called after every AddTask, from whatever thread received the pack and under the
+	// handler's lock, so the dispatch thread can schedule a drain. It must not call back in.
+	void SetWakeHook(std::function<void()> hook);
+	// Drains on one shard of the executor instead of a caller-supplied hook; packs queued
+	// before the call are drained too. The executor has to outlive the handler.
+	void RunOn(ShardedExecutor& executor, size_t shard);
+	// Stops waking the dispatch thread and waits out a drain already posted to the shard,
+	// the owner calls it before the trackers its packs point at go away
+	void Detach();
+
+	void SetLanePriority(Lane lane, int priority);
+	void SetLaneMaxWait(Lane lane, int maxWaitMs);
+	void SetMaxBurst(int maxBurst);
+	// Also print every other pack of multiplexed sessions, one line each
+	static void SetMuxVerbose(bool verbose) { _muxVerbose = verbose; }
+	void PrintStats();
+	void ResetStats();
 };
 
@@ -0,0 +1,291 @@
+#include "pch.h"
+#include "ReconnectManager.h"
+#include "Net/RequestTracker.h"
+#include "Net/Transport.h"
+#include <algorithm>
+#include <random>
+
+#undef min
+#undef max
+
+namespace
+{
+	std::vector<uint8_t> CopyBytes(NetPack& pack)
+	{
+		const uint8_t* content = (const uint8_t*)pack.GetContent();
+		return std::vector<uint8_t>(content, content + pack.Length());
+	}
+
+	// re-reads a pack we built ourselves (write-side packs have no read cursor)
+	NetPack ReadView(NetPack& pack)
+	{
+		return NetPack((uint8_t*)pack.GetContent());
+	}
+}
+
+ReconnectManager::ReconnectManager(Connector::Endpoint endpoint)
+	: ReconnectManager(std::move(endpoint), Config{})
+{
+}
+
+ReconnectManager::ReconnectManager(Connector::Endpoint endpoint, Config config)
+	: m_endpoint(std::move(endpoint)), m_config(config)
+{
+}
+
+bool ReconnectManager::Replayable(RpcEnum msgType)
+{
+	switch (msgType)
+	{
+	case RpcEnum::rpc_server_poker_buyin:
+	case RpcEnum::rpc_server_create_room:
+		return false;
+	default:
+		return true;
+	}
+}
+
+bool ReconnectManager::OnOutbound(NetPack& pack, uint32_t requestId, uint64_t& seq)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	seq = 0;
+
+	switch (pack.MsgType())
+	{
+	case RpcEnum::rpc_server_log_in:
+		// session state is replayed from here, never from the journal
+		m_loginPack = CopyBytes(pack);
+		m_joinedRooms.clear();
+		return !m_reconnecting;
+	case RpcEnum::rpc_server_goto_room:
+	{
+		int roomId = ReadView(pack).ReadInt32();
+		if (roomId >= 0 && std::find(m_joinedRooms.begin(), m_joinedRooms.end(), roomId) == m_joinedRooms.end())
+			m_joinedRooms.push_back(roomId);
+		return !m_reconnecting;
+	}
+	case RpcEnum::rpc_server_leave_room:
+	{
+		int roomId = ReadView(pack).ReadInt32();
+		m_joinedRooms.erase(std::remove(m_joinedRooms.begin(), m_joinedRooms.end(), roomId), m_joinedRooms.end());
+		break;
+	}
+	default:
+		break;
+	}
+
+	DropExpired();
+	if (m_journal.size() >= m_config.maxJournal)
+		m_journal.pop_front();
+
+	JournalEntry entry;
+	entry.seq = m_nextSeq++;
+	entry.msgType = pack.MsgType();
+	entry.responseType = GetRpcResponseType(pack.MsgType());
+	entry.requestId = requestId;
+	entry.room = RequestTracker::ReplyRoom(pack);
+	entry.time = std::chrono::steady_clock::now();
+	entry.bytes = CopyBytes(pack);
+	seq = entry.seq;
+	m_journal.push_back(std::move(entry));
+	return !m_reconnecting;
+}
+
+void ReconnectManager::OnSendResult(uint64_t seq, bool sent)
+{
+	if (seq == 0 || !sent) return;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (auto it = m_journal.begin(); it != m_journal.end(); ++it)
+	{
+		if (it->seq != seq) continue;
+		// fire-and-forget rpcs have nothing to wait for once they left the socket
+		if (it->responseType == RpcEnum::INVALID)
+			m_journal.erase(it);
+		else
+			it->sent = true;
+		return;
+	}
+}
+
+void ReconnectManager::OnInbound(NetPack& pack)
+{
+	const RpcEnum msgType = pack.MsgType();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (pack.RequestId() != 0)
+	{
+		for (auto it = m_journal.begin(); it != m_journal.end(); ++it)
+		{
+			if (it->sent && it->requestId == pack.RequestId())
+			{
+				m_journal.erase(it);
+				return;
+			}
+		}
+		return;
+	}
+	// a server that echoes ids leaves only pushes untagged
+	if (RequestTracker::UseWireIds())
+		return;
+
+	if (msgType == RpcEnum::rpc_client_error_respond)
+	{
+		// the server answers a failed request with an error instead of its response
+		for (auto it = m_journal.begin(); it != m_journal.end(); ++it)
+		{
+			if (it->sent && it->responseType != RpcEnum::INVALID)
+			{
+				m_journal.erase(it);
+				return;
+			}
+		}
+		return;
+	}
+
+	int32_t room = -1;
+	if (RequestTracker::ServerPushes(msgType))
+	{
+		pack.ResetReadPos();
+		room = pack.Unread() >= sizeof(int32_t) ? pack.ReadInt32() : -1;
+		pack.ResetReadPos();
+	}
+	for (auto it = m_journal.begin(); it != m_journal.end(); ++it)
+	{
+		if (it->sent && it->responseType == msgType && it->room == room)
+		{
+			m_journal.erase(it);
+			return;
+		}
+	}
+}
+
+bool ReconnectManager::Reconnect(Player& player)
+{
+	m_reconnecting = true;
+	Console::Out() << "connection lost, reconnecting to " << m_endpoint.ToString() << std::endl;
+
+	const auto start = std::chrono::steady_clock::now();
+	std::mt19937 rng(std::random_device{}());
+	int delayMs = m_config.initialDelayMs;
+	for (int attempt = 1; attempt <= m_config.maxAttempts; ++attempt)
+	{
+		if (attempt > 1)
+		{
+			// exponential backoff with +-20% jitter so a bot farm does not reconnect in lockstep
+			std::uniform_int_distribution<int> jitter(-delayMs / 5, delayMs / 5);
+			std::this_thread::sleep_for(std::chrono::milliseconds(delayMs + jitter(rng)));
+			delayMs = std::min(delayMs * 2, m_config.maxDelayMs);
+		}
+		if (player.Expired())
+			break;
+
+		auto transport = Connector::Open(m_endpoint, true);
+		if (!transport)
+			continue;
+		if (!player.ResetTransport(std::move(transport)))
+			break;
+
+		std::vector<uint32_t> lost;
+		size_t replayed = Replay(player, lost);
+		// outside the journal lock, a callback may well send again
+		for (uint32_t requestId : lost)
+			player.Tracker().Fail(requestId, RequestTracker::Status::Lost);
+		const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_stats.reconnectCount++;
+			m_stats.lastReconnectMs = elapsedMs;
+			m_stats.lastAttempts = attempt;
+			m_stats.lastReplayedPacks = replayed;
+			m_stats.lastLostPacks = lost.size();
+		}
+		Console::Out() << "reconnected in " << elapsedMs << " ms (attempt " << attempt
+			<< "), replayed " << replayed << " pack(s)";
+		if (!lost.empty())
+			Console::Out() << ", " << lost.size() << " sent request(s) not safe to resend failed";
+		Console::Out() << std::endl;
+		return true;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stats.failedCount++;
+		m_reconnecting = false;
+	}
+	Console::Out() << "reconnect failed" << std::endl;
+	return false;
+}
+
+size_t ReconnectManager::Replay(Player& player, std::vector<uint32_t>& lost)
+{
+	// holding the lock until m_reconnecting drops keeps packs sent meanwhile from slipping past the replay
+	std::unique_lock<std::mutex> lock(m_mutex);
+	size_t count = 0;
+	if (!m_loginPack.empty())
+	{
+		NetPack login(m_loginPack.data());
+		player.Transmit(login);
+		count++;
+		for (int roomId : m_joinedRooms)
+		{
+			NetPack toRoom(RpcEnum::rpc_server_goto_room);
+			toRoom.WriteInt32(roomId);
+			player.Transmit(toRoom);
+			count++;
+		}
+	}
+
+	DropExpired();
+	for (auto it = m_journal.begin(); it != m_journal.end();)
+	{
+		// the server may have acted on it already: a second buy-in would buy in twice
+		if (it->sent && !Replayable(it->msgType))
+		{
+			if (it->requestId != 0)
+				lost.push_back(it->requestId);
+			it = m_journal.erase(it);
+			continue;
+		}
+		NetPack pack(it->bytes.data());
+		// parsing strips the request id trailer, put it back so the reply still correlates
+		pack.AttachRequestId(pack.RequestId());
+		if (!player.Transmit(pack))
+			break;
+		count++;
+		if (it->responseType == RpcEnum::INVALID)
+		{
+			it = m_journal.erase(it);
+			continue;
+		}
+		it->sent = true;
+		++it;
+	}
+	m_reconnecting = false;
+	return count;
+}
+
+void ReconnectManager::DropExpired()
+{
+	const auto cutoff = std::chrono::steady_clock::now() - std::chrono::milliseconds(m_config.journalTtlMs);
+	while (!m_journal.empty() && m_journal.front().time < cutoff)
+		m_journal.pop_front();
+}
+
+ReconnectManager::Stats ReconnectManager::GetStats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void ReconnectManager::PrintStats()
+{
+	Stats stats = GetStats();
+	Console::Out() << "[RECONNECT]" << std::endl;
+	Console::Out() << '\t' << "reconnects: " << stats.reconnectCount << ", failed: " << stats.failedCount << std::endl;
+	if (stats.lastReconnectMs >= 0)
+	{
+		Console::Out() << '\t' << "last: " << stats.lastReconnectMs << " ms, " << stats.lastAttempts
+			<< " attempt(s), " << stats.lastReplayedPacks << " pack(s) replayed, "
+			<< stats.lastLostPacks << " lost" << std::endl;
+	}
+}
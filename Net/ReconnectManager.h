@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Net/Connector.h"
+#include "Net/RpcEnum.h"
+
+class NetPack;
+class Player;
+
+// Re-establishes the server connection after Player loses its socket.
+// Tracks the session state the server forgets on disconnect (login, joined rooms)
+// and a journal of outbound packs that were not acknowledged yet, and replays
+// both on the new socket. A reply acknowledges the sent entry with its wire id, or
+// without ids the oldest sent one of its type (for pushed types, of its room).
+// Requests that are not safe to repeat (buy-in, create room) are only replayed if
+// they never left; one already sent fails with RequestTracker::Status::Lost instead.
+// USEROOM is client side only and lives in CommandProcessor, which outlives the
+// socket, so it needs no replay.
+class ReconnectManager
+{
+public:
+	struct Config
+	{
+		int maxAttempts = 10;
+		int initialDelayMs = 50;     // first attempt is immediate, then this doubles
+		int maxDelayMs = 3000;
+		int journalTtlMs = 10000;    // unanswered packs older than this are not replayed
+		size_t maxJournal = 256;
+	};
+
+	struct Stats
+	{
+		int reconnectCount = 0;
+		int failedCount = 0;
+		int64_t lastReconnectMs = -1;
+		int lastAttempts = 0;
+		size_t lastReplayedPacks = 0;
+		size_t lastLostPacks = 0;
+	};
+
+	explicit ReconnectManager(Connector::Endpoint endpoint);
+	ReconnectManager(Connector::Endpoint endpoint, Config config);
+
+	// Player hooks. OnOutbound returns false if the pack must wait for the replay;
+	// requestId is the pack's RequestTracker id, 0 if it has none.
+	bool OnOutbound(NetPack& pack, uint32_t requestId, uint64_t& seq);
+	void OnSendResult(uint64_t seq, bool sent);
+	void OnInbound(NetPack& pack);
+
+	// a sent request of this type may be repeated after a reconnect without doing it twice
+	static bool Replayable(RpcEnum msgType);
+
+	// Blocking, runs on the recv thread. Returns false once all attempts failed
+	// or the player was deleted meanwhile.
+	bool Reconnect(Player& player);
+
+	bool IsReconnecting() const { return m_reconnecting; }
+	const Connector::Endpoint& GetEndpoint() const { return m_endpoint; }
+	Stats GetStats();
+	void PrintStats();
+
+private:
+	struct JournalEntry
+	{
+		uint64_t seq = 0;
+		RpcEnum msgType = RpcEnum::INVALID;
+		RpcEnum responseType = RpcEnum::INVALID;
+		uint32_t requestId = 0;
+		int32_t room = -1;                   // RequestTracker::ReplyRoom
+		bool sent = false;
+		std::chrono::steady_clock::time_point time{};
+		std::vector<uint8_t> bytes;
+	};
+
+	// lost gets the tracker ids of sent requests that were not Replayable
+	size_t Replay(Player& player, std::vector<uint32_t>& lost);
+	void DropExpired();
+
+	Connector::Endpoint m_endpoint;
+	Config m_config;
+	Stats m_stats{};
+
+	std::mutex m_mutex;
+	std::atomic<bool> m_reconnecting = false;
+	uint64_t m_nextSeq = 1;
+	std::vector<uint8_t> m_loginPack;
+	std::vector<int> m_joinedRooms;
+	std::deque<JournalEntry> m_journal;
+};
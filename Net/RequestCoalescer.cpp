@@ -0,0 +1,149 @@
+#include "pch.h"
+#include "RequestCoalescer.h"
+#include <cstring>
+
+bool RequestCoalescer::s_enabled = true;
+int RequestCoalescer::s_minRefreshMs = 0;
+
+bool RequestCoalescer::Coalesces(RpcEnum request)
+{
+	// only requests without side effects, whose reply depends on nothing but the payload
+	switch (request)
+	{
+	case RpcEnum::rpc_server_get_poker_table_info:
+		return s_enabled;
+	default:
+		return false;
+	}
+}
+
+namespace
+{
+	// A reply without an echoed id was matched by type, so it is only kept if it names the
+	// same room as the request did: coalesced requests and their replies lead with the room id.
+	bool BelongsTo(const std::string& key, NetPack& reply)
+	{
+		if (reply.RequestId() != 0)
+			return true;
+		reply.ResetReadPos();
+		if (key.size() < 8 || reply.Unread() < sizeof(int32_t))
+			return false;
+		int32_t room = 0;
+		std::memcpy(&room, key.data() + 4, sizeof(room));
+		const bool same = reply.ReadInt32() == room;
+		reply.ResetReadPos();
+		return same;
+	}
+}
+
+std::string RequestCoalescer::KeyOf(NetPack& pack)
+{
+	// header included: it carries the type, and a request id trailer is only attached later
+	return std::string(pack.GetContent(), pack.Length());
+}
+
+bool RequestCoalescer::Join(RpcEnum request, const std::string& key, RequestTracker::Callback& callback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Stats& stats = m_stats[(uint16_t)request];
+	auto group = m_inFlight.find(key);
+	if (group != m_inFlight.end())
+	{
+		group->second.waiters.push_back(std::move(callback));
+		stats.joined++;
+		return true;
+	}
+
+	const int minRefreshMs = s_minRefreshMs;
+	auto recent = m_recent.find(key);
+	if (recent != m_recent.end() && minRefreshMs > 0
+		&& std::chrono::steady_clock::now() - recent->second.at < std::chrono::milliseconds(minRefreshMs))
+	{
+		// every caller reads its own copy
+		NetPack reply((uint8_t*)recent->second.content.data());
+		stats.cached++;
+		lock.unlock();
+		if (callback)
+			callback(RequestTracker::Status::Cached, &reply);
+		return true;
+	}
+
+	Group& lead = m_inFlight[key];
+	lead.request = request;
+	lead.waiters.push_back(std::move(callback));
+	stats.sent++;
+	return false;
+}
+
+void RequestCoalescer::Complete(const std::string& key, RequestTracker::Status status, NetPack* pack)
+{
+	std::vector<RequestTracker::Callback> waiters;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto group = m_inFlight.find(key);
+		if (group == m_inFlight.end())
+			return;
+		waiters = std::move(group->second.waiters);
+		m_inFlight.erase(group);
+		if (status == RequestTracker::Status::Ok && pack != nullptr && s_minRefreshMs > 0 && BelongsTo(key, *pack))
+		{
+			Reply& reply = m_recent[key];
+			reply.content.assign(pack->GetContent(), pack->GetContent() + pack->Length());
+			reply.at = std::chrono::steady_clock::now();
+		}
+	}
+	for (auto& waiter : waiters)
+	{
+		if (!waiter)
+			continue;
+		// each caller reads from the payload start
+		if (pack)
+			pack->ResetReadPos();
+		waiter(status, pack);
+	}
+}
+
+void RequestCoalescer::Abandon(const std::string& key)
+{
+	std::vector<RequestTracker::Callback> waiters;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto group = m_inFlight.find(key);
+		if (group == m_inFlight.end())
+			return;
+		waiters = std::move(group->second.waiters);
+		m_inFlight.erase(group);
+	}
+	// the first one is the leading caller, told by Request's return value instead
+	for (size_t i = 1; i < waiters.size(); i++)
+		if (waiters[i])
+			waiters[i](RequestTracker::Status::NotSent, nullptr);
+}
+
+RequestCoalescer::Stats RequestCoalescer::GetStats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Stats total{};
+	for (const auto& [type, stats] : m_stats)
+	{
+		total.sent += stats.sent;
+		total.joined += stats.joined;
+		total.cached += stats.cached;
+	}
+	return total;
+}
+
+void RequestCoalescer::PrintStats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Console::Out() << "[COALESCE] " << (s_enabled ? "on" : "off") << ", min refresh " << s_minRefreshMs << " ms"
+		<< ", in flight " << m_inFlight.size() << std::endl;
+	for (const auto& [type, stats] : m_stats)
+	{
+		const uint64_t saved = stats.joined + stats.cached;
+		const uint64_t asked = stats.sent + saved;
+		Console::Out() << '\t' << GetRpcName((RpcEnum)type) << ": sent " << stats.sent
+			<< ", joined " << stats.joined << ", cached " << stats.cached
+			<< ", saved " << saved << " (" << std::format("{:.1f}", asked > 0 ? 100.0 * saved / asked : 0.0) << "%)" << std::endl;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Net/RequestTracker.h"
+
+class NetPack;
+
+// Folds identical read-only requests of one connection into a single round trip.
+// Two requests are identical when type and payload match, so for table info that is
+// one request per room: callers arriving while it is in flight join it and are all
+// answered by its reply. With a minimum refresh interval a reply that recent is handed
+// out again (Status::Cached) instead of asking the server at all.
+// Player::Request runs every request through here; Join and Abandon run where requests
+// are made, Complete on the connection's dispatch thread.
+class RequestCoalescer
+{
+public:
+	struct Stats
+	{
+		uint64_t sent = 0;       // requests that went to the server
+		uint64_t joined = 0;     // folded into one already in flight
+		uint64_t cached = 0;     // answered from a recent reply
+	};
+
+	static bool Coalesces(RpcEnum request);
+	static std::string KeyOf(NetPack& pack);
+
+	static void SetEnabled(bool enabled) { s_enabled = enabled; }
+	static bool IsEnabled() { return s_enabled; }
+	// 0 = only fold requests in flight, never answer from an older reply
+	static void SetMinRefreshMs(int ms) { s_minRefreshMs = ms; }
+	static int GetMinRefreshMs() { return s_minRefreshMs; }
+
+	// True when the caller is answered without sending: it joined a request in flight or
+	// was served from a fresh reply (callback already called). False: the caller sends,
+	// and the request's tracker callback must forward to Complete(key, ...).
+	bool Join(RpcEnum request, const std::string& key, RequestTracker::Callback& callback);
+	// Dispatch thread. Answers every caller waiting on key.
+	void Complete(const std::string& key, RequestTracker::Status status, NetPack* pack);
+	// The leading request could not be sent: it never calls back, the callers that joined it get NotSent
+	void Abandon(const std::string& key);
+
+	Stats GetStats();
+	void PrintStats();
+
+private:
+	struct Group
+	{
+		RpcEnum request = RpcEnum::INVALID;
+		std::vector<RequestTracker::Callback> waiters;   // the leading caller first
+	};
+	struct Reply
+	{
+		std::vector<char> content;
+		std::chrono::steady_clock::time_point at{};
+	};
+
+	static bool s_enabled;
+	static int s_minRefreshMs;
+
+	std::mutex m_mutex;
+	std::map<std::string, Group> m_inFlight;
+	std::map<std::string, Reply> m_recent;
+	std::map<uint16_t, Stats> m_stats;                  // by request type
+};
@@ -0,0 +1,233 @@
+#include "pch.h"
+#include "RequestTracker.h"
+#include <algorithm>
+
+#undef min
+#undef max
+
+bool RequestTracker::s_useWireIds = false;
+
+bool RequestTracker::ServerPushes(RpcEnum response)
+{
+	return response == RpcEnum::rpc_client_get_poker_table_info;
+}
+
+bool RequestTracker::ServerMayReject(RpcEnum request)
+{
+	return request != RpcEnum::rpc_server_ping && !ServerPushes(GetRpcResponseType(request));
+}
+
+int32_t RequestTracker::ReplyRoom(NetPack& request)
+{
+	if (!ServerPushes(GetRpcResponseType(request.MsgType())))
+		return -1;
+	// a pack built for sending never set its read position
+	request.ResetReadPos();
+	if (request.Unread() < sizeof(int32_t))
+		return -1;
+	const int32_t room = request.ReadInt32();
+	request.ResetReadPos();
+	return room;
+}
+
+uint32_t RequestTracker::Begin(RpcEnum request, Callback callback, int timeoutMs, int32_t room)
+{
+	RpcEnum response = GetRpcResponseType(request);
+	if (response == RpcEnum::INVALID)
+		return 0;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Pending pending;
+	pending.id = m_nextId++;
+	if (m_nextId == 0) m_nextId = 1;
+	pending.request = request;
+	pending.response = response;
+	pending.room = room;
+	pending.sentAt = std::chrono::steady_clock::now();
+	pending.deadline = pending.sentAt + std::chrono::milliseconds(timeoutMs);
+	pending.callback = std::move(callback);
+
+	uint32_t id = pending.id;
+	m_fifoByResponse[(uint16_t)response].push_back(id);
+	m_pending.emplace(id, std::move(pending));
+	m_stats[(uint16_t)request].sent++;
+	m_maxInFlight = std::max(m_maxInFlight, m_pending.size());
+	return id;
+}
+
+void RequestTracker::Cancel(uint32_t requestId)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Pending pending;
+	TakeLocked(requestId, pending);
+}
+
+void RequestTracker::Fail(uint32_t requestId, Status status)
+{
+	Pending pending;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (!TakeLocked(requestId, pending))
+			return;
+		m_stats[(uint16_t)pending.request].errors++;
+	}
+	Complete(pending, status, nullptr);
+}
+
+bool RequestTracker::TakeLocked(uint32_t requestId, Pending& out)
+{
+	auto it = m_pending.find(requestId);
+	if (it == m_pending.end())
+		return false;
+	out = std::move(it->second);
+	m_pending.erase(it);
+
+	auto& fifo = m_fifoByResponse[(uint16_t)out.response];
+	auto fifoIt = std::find(fifo.begin(), fifo.end(), requestId);
+	if (fifoIt != fifo.end())
+		fifo.erase(fifoIt);
+	return true;
+}
+
+bool RequestTracker::OnResponse(NetPack& pack)
+{
+	return Respond(pack, s_useWireIds);
+}
+
+bool RequestTracker::Respond(NetPack& pack, bool wireIds)
+{
+	Pending pending;
+	Status status = Status::Ok;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		bool found = false;
+		if (pack.RequestId() != 0)
+		{
+			// tagged replies never fall back to FIFO, a late one just finds nothing
+			if (!TakeLocked(pack.RequestId(), pending))
+				return false;
+			found = true;
+		}
+		// a server that echoes ids leaves pushes (table updates, chat) untagged
+		else if (wireIds)
+			return false;
+
+		if (!found && pack.MsgType() == RpcEnum::rpc_client_error_respond)
+		{
+			// without an echoed id the error belongs to the oldest request still waiting that
+			// the server could have turned down
+			auto oldest = std::find_if(m_pending.begin(), m_pending.end(), [](const auto& entry) {
+				return ServerMayReject(entry.second.request);
+			});
+			if (oldest != m_pending.end())
+				found = TakeLocked(oldest->first, pending);
+		}
+		else if (!found)
+		{
+			auto fifoIt = m_fifoByResponse.find((uint16_t)pack.MsgType());
+			if (fifoIt != m_fifoByResponse.end() && !fifoIt->second.empty())
+			{
+				uint32_t matched = fifoIt->second.front();
+				if (ServerPushes(pack.MsgType()))
+				{
+					// the oldest request for the room this names; none means it is a push
+					pack.ResetReadPos();
+					const int32_t room = pack.Unread() >= sizeof(int32_t) ? pack.ReadInt32() : -1;
+					auto sameRoom = std::find_if(fifoIt->second.begin(), fifoIt->second.end(), [this, room](uint32_t id) {
+						return m_pending[id].room == room;
+					});
+					matched = sameRoom != fifoIt->second.end() ? *sameRoom : 0;
+				}
+				if (matched != 0)
+					found = TakeLocked(matched, pending);
+			}
+		}
+		if (!found)
+			return false;
+
+		status = pack.MsgType() == RpcEnum::rpc_client_error_respond ? Status::Error : Status::Ok;
+		RpcStats& stats = m_stats[(uint16_t)pending.request];
+		if (status == Status::Ok)
+		{
+			stats.ok++;
+			stats.latency.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - pending.sentAt).count());
+		}
+		else
+		{
+			stats.errors++;
+		}
+	}
+
+	pack.ResetReadPos();
+	Complete(pending, status, &pack);
+	return true;
+}
+
+void RequestTracker::Tick()
+{
+	std::vector<Pending> expired;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		const auto now = std::chrono::steady_clock::now();
+		std::vector<uint32_t> ids;
+		for (const auto& [id, pending] : m_pending)
+			if (pending.deadline <= now)
+				ids.push_back(id);
+		for (uint32_t id : ids)
+		{
+			Pending pending;
+			if (!TakeLocked(id, pending))
+				continue;
+			m_stats[(uint16_t)pending.request].timeouts++;
+			expired.push_back(std::move(pending));
+		}
+	}
+	for (Pending& pending : expired)
+		Complete(pending, Status::Timeout, nullptr);
+}
+
+void RequestTracker::Complete(Pending& pending, Status status, NetPack* pack)
+{
+	if (pending.callback)
+		pending.callback(status, pack);
+}
+
+size_t RequestTracker::PendingCount()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_pending.size();
+}
+
+bool RequestTracker::SelfCheck()
+{
+	RequestTracker tracker;
+	Status ping = Status::NotSent, buyin = Status::NotSent;
+	tracker.Begin(RpcEnum::rpc_server_ping, [&ping](Status status, NetPack*) { ping = status; });
+	tracker.Begin(RpcEnum::rpc_server_poker_buyin, [&buyin](Status status, NetPack*) { buyin = status; });
+	NetPack error(RpcEnum::rpc_client_error_respond);
+	error.WriteUInt16(1);
+	// FIFO matching whatever the process uses, a wire id would make the error unambiguous
+	const bool matched = tracker.Respond(error, false);
+	return matched && buyin == Status::Error && ping == Status::NotSent && tracker.PendingCount() == 1;
+}
+
+void RequestTracker::PrintStats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Console::Out() << "[RPC STATS] in flight: " << m_pending.size() << " (max " << m_maxInFlight << ")"
+		<< ", wire ids: " << (s_useWireIds ? "on" : "off") << std::endl;
+	for (const auto& [type, stats] : m_stats)
+	{
+		Console::Out() << '\t' << GetRpcName((RpcEnum)type) << ": sent " << stats.sent
+			<< ", ok " << stats.ok << ", err " << stats.errors << ", timeout " << stats.timeouts;
+		if (stats.latency.Count() > 0)
+		{
+			Console::Out() << std::format(", p50 {:.2f} ms, p99 {:.2f} ms, max {:.2f} ms",
+				stats.latency.Percentile(50.0) / 1000.0,
+				stats.latency.Percentile(99.0) / 1000.0,
+				stats.latency.Max() / 1000.0);
+		}
+		Console::Out() << std::endl;
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include "Net/RpcEnum.h"
+#include "Utils/LatencyHistogram.h"
+
+class NetPack;
+
+// Pending-request table for one connection.
+// Every request with a known response type (see GetRpcResponseType) gets an id and
+// an entry here, so any number of them can be in flight at once. Responses are
+// matched by the wire request id when the server echoes one, otherwise FIFO per
+// response type. FIFO relies on the server answering a connection in order, and it
+// breaks down for reply types the server also pushes unasked (ServerPushes): those
+// are only matched to a request for the room the reply names, and anything else of
+// that type is left to NetPackHandler as a push. Prefer wire ids where the server
+// echoes them; the loopback server does, and --loopback turns them on.
+class RequestTracker
+{
+public:
+	enum class Status : uint8_t
+	{
+		Ok = 0,
+		Error = 1,        // server answered with rpc_client_error_respond
+		Timeout = 2,
+		NotSent = 3,      // never left the client: awaitables, and callers coalesced onto such a request
+		Cached = 4,       // answered from a recent identical reply without a round trip (RequestCoalescer)
+		Lost = 5,         // sent, then the connection dropped before the reply and it is not safe to resend
+	};
+
+	// pack is null on timeout and loss; on Ok/Error its read position is at the payload start
+	using Callback = std::function<void(Status status, NetPack* pack)>;
+
+	static constexpr int kDefaultTimeoutMs = 5000;
+
+	// Writes the request id trailer on outgoing requests. Off by default since it
+	// needs a server that echoes the id; FIFO matching works with any server.
+	static void SetUseWireIds(bool use) { s_useWireIds = use; }
+	static bool UseWireIds() { return s_useWireIds; }
+
+	// reply types the server also sends unasked, e.g. table info after every action;
+	// their payload leads with the room id
+	static bool ServerPushes(RpcEnum response);
+	// the room a reply to this request must name, -1 unless its reply type ServerPushes;
+	// the request's read position is left at the payload start
+	static int32_t ReplyRoom(NetPack& request);
+	// requests an untagged rpc_client_error_respond may answer: not pings, which the
+	// server never rejects, and not requests matched to a ServerPushes reply by room,
+	// which can wait a long time for their push and would take errors meant for others
+	static bool ServerMayReject(RpcEnum request);
+	// an untagged error with a ping and a BUYIN pending fails the BUYIN, true if it does
+	static bool SelfCheck();
+
+	// Registers a request before it is sent, returns its id (0 if the rpc has no response).
+	// room is ReplyRoom of the request, so a FIFO match can tell its reply from a push.
+	uint32_t Begin(RpcEnum request, Callback callback = nullptr, int timeoutMs = kDefaultTimeoutMs, int32_t room = -1);
+	void Cancel(uint32_t requestId);
+	// completes a request that will get no reply with status, if it is still pending
+	void Fail(uint32_t requestId, Status status);
+
+	// The connection's dispatch thread. Completes the matching request, returns false if the pack answered nothing.
+	bool OnResponse(NetPack& pack);
+	// Fails requests whose deadline passed. May run on the loop while a shard dispatches OnResponse,
+	// each request still completes exactly once.
+	void Tick();
+
+	size_t PendingCount();
+	void PrintStats();
+
+private:
+	struct Pending
+	{
+		uint32_t id = 0;
+		RpcEnum request = RpcEnum::INVALID;
+		RpcEnum response = RpcEnum::INVALID;
+		int32_t room = -1;                       // see ReplyRoom
+		std::chrono::steady_clock::time_point sentAt{};
+		std::chrono::steady_clock::time_point deadline{};
+		Callback callback;
+	};
+
+	struct RpcStats
+	{
+		uint64_t sent = 0;
+		uint64_t ok = 0;
+		uint64_t errors = 0;
+		uint64_t timeouts = 0;
+		LatencyHistogram latency;
+	};
+
+	bool TakeLocked(uint32_t requestId, Pending& out);
+	// OnResponse, matching by wire id or FIFO as wireIds says
+	bool Respond(NetPack& pack, bool wireIds);
+	void Complete(Pending& pending, Status status, NetPack* pack);
+
+	static bool s_useWireIds;
+
+	std::mutex m_mutex;
+	uint32_t m_nextId = 1;
+	std::map<uint32_t, Pending> m_pending;                           // ordered by id = send order
+	std::unordered_map<uint16_t, std::deque<uint32_t>> m_fifoByResponse;
+	std::map<uint16_t, RpcStats> m_stats;                            // keyed by request type
+	size_t m_maxInFlight = 0;
+};
@@ -57,6 +57,90 @@ enum RpcEnum : std::uint16_t
 	rpc_client_poker_set_blinds,
 	rpc_server_poker_add_bot,
 	rpc_server_poker_kick_bot,
+
+	// session multiplexing (SessionMux), every pack starts with sessionId:u16
+	rpc_mux_open,
+	rpc_mux_data,
+	rpc_mux_close,
 	
 	INVALID,
 };
+
+// Response the server sends back for a request, INVALID for fire-and-forget rpcs.
+// Used to decide when an outbound pack has been acknowledged.
+inline RpcEnum GetRpcResponseType(RpcEnum request)
+{
+	switch (request)
+	{
+	case rpc_server_ping: return rpc_client_ping;
+	case rpc_server_log_in: return rpc_client_log_in;
+	case rpc_server_print_user: return rpc_client_print_user;
+	case rpc_server_print_room: return rpc_client_print_room;
+	case rpc_server_goto_room: return rpc_client_goto_room;
+	case rpc_server_leave_room: return rpc_client_leave_room;
+	case rpc_server_get_my_rooms: return rpc_client_get_my_rooms;
+	case rpc_server_create_room: return rpc_client_create_room;
+	case rpc_server_get_poker_table_info: return rpc_client_get_poker_table_info;
+	case rpc_server_sit_down: return rpc_client_sit_down;
+	case rpc_server_poker_buyin: return rpc_client_poker_buyin;
+	case rpc_server_poker_standup: return rpc_client_poker_standup;
+	case rpc_server_poker_set_blinds: return rpc_client_poker_set_blinds;
+	default: return INVALID;
+	}
+}
+
+inline const char* GetRpcName(RpcEnum rpc)
+{
+	switch (rpc)
+	{
+	case rpc_connect: return "rpc_connect";
+	case rpc_debug: return "rpc_debug";
+	case rpc_server_ping: return "rpc_server_ping";
+	case rpc_client_ping: return "rpc_client_ping";
+	case rpc_server_tick: return "rpc_server_tick";
+	case rpc_server_error_respond: return "rpc_server_error_respond";
+	case rpc_server_register: return "rpc_server_register";
+	case rpc_server_log_in: return "rpc_server_log_in";
+	case rpc_server_set_name: return "rpc_server_set_name";
+	case rpc_server_set_language: return "rpc_server_set_language";
+	case rpc_server_send_text: return "rpc_server_send_text";
+	case rpc_server_print_user: return "rpc_server_print_user";
+	case rpc_server_print_room: return "rpc_server_print_room";
+	case rpc_server_goto_room: return "rpc_server_goto_room";
+	case rpc_server_leave_room: return "rpc_server_leave_room";
+	case rpc_server_get_my_rooms: return "rpc_server_get_my_rooms";
+	case rpc_server_create_room: return "rpc_server_create_room";
+	case rpc_server_refresh_user_info: return "rpc_server_refresh_user_info";
+	case rpc_client_tick: return "rpc_client_tick";
+	case rpc_client_error_respond: return "rpc_client_error_respond";
+	case rpc_client_log_in: return "rpc_client_log_in";
+	case rpc_client_set_name: return "rpc_client_set_name";
+	case rpc_client_set_language: return "rpc_client_set_language";
+	case rpc_client_send_text: return "rpc_client_send_text";
+	case rpc_client_print_user: return "rpc_client_print_user";
+	case rpc_client_print_room: return "rpc_client_print_room";
+	case rpc_client_goto_room: return "rpc_client_goto_room";
+	case rpc_client_leave_room: return "rpc_client_leave_room";
+	case rpc_client_get_my_rooms: return "rpc_client_get_my_rooms";
+	case rpc_client_create_room: return "rpc_client_create_room";
+	case rpc_client_refresh_user_info: return "rpc_client_refresh_user_info";
+	case rpc_server_get_poker_table_info: return "rpc_server_get_poker_table_info";
+	case rpc_client_get_poker_table_info: return "rpc_client_get_poker_table_info";
+	case rpc_server_sit_down: return "rpc_server_sit_down";
+	case rpc_client_sit_down: return "rpc_client_sit_down";
+	case rpc_server_poker_action: return "rpc_server_poker_action";
+	case rpc_client_poker_hand_result: return "rpc_client_poker_hand_result";
+	case rpc_server_poker_buyin: return "rpc_server_poker_buyin";
+	case rpc_client_poker_buyin: return "rpc_client_poker_buyin";
+	case rpc_server_poker_standup: return "rpc_server_poker_standup";
+	case rpc_client_poker_standup: return "rpc_client_poker_standup";
+	case rpc_server_poker_set_blinds: return "rpc_server_poker_set_blinds";
+	case rpc_client_poker_set_blinds: return "rpc_client_poker_set_blinds";
+	case rpc_server_poker_add_bot: return "rpc_server_poker_add_bot";
+	case rpc_server_poker_kick_bot: return "rpc_server_poker_kick_bot";
+	case rpc_mux_open: return "rpc_mux_open";
+	case rpc_mux_data: return "rpc_mux_data";
+	case rpc_mux_close: return "rpc_mux_close";
+	default: return "INVALID";
+	}
+}
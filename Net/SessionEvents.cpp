@@ -0,0 +1,81 @@
+#include "pch.h"
+#include "SessionEvents.h"
+
+SessionEvents& SessionEvents::Inst()
+{
+	static SessionEvents inst;
+	return inst;
+}
+
+void SessionEvents::Publish(const std::function<void(State&)>& update)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		update(m_state);
+	}
+	m_cv.notify_all();
+}
+
+void SessionEvents::OnLogin(int playerId)
+{
+	Publish([playerId](State& state) { state.myPlayerId = playerId; });
+}
+
+void SessionEvents::OnTableInfo(int roomId, int actingPlayerId)
+{
+	Publish([roomId, actingPlayerId](State& state) {
+		state.tableUpdates++;
+		state.actingByRoom[roomId] = actingPlayerId;
+	});
+}
+
+void SessionEvents::OnHandResult(int roomId)
+{
+	Publish([roomId](State& state) {
+		state.handResults++;
+		state.handResultsByRoom[roomId]++;
+	});
+}
+
+void SessionEvents::OnError(uint16_t errCode)
+{
+	Publish([errCode](State& state) {
+		state.errors++;
+		state.lastError = errCode;
+	});
+}
+
+SessionEvents::State SessionEvents::Snapshot()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_state;
+}
+
+bool SessionEvents::WaitUntil(const std::function<bool(const State&)>& pred, std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_cv.wait_for(lock, timeout, [this, &pred]() { return pred(m_state); });
+}
+
+bool SessionEvents::IsMyTurn(const State& state, int roomId)
+{
+	if (state.myPlayerId < 0)
+		return false;
+	if (roomId >= 0)
+	{
+		auto it = state.actingByRoom.find(roomId);
+		return it != state.actingByRoom.end() && it->second == state.myPlayerId;
+	}
+	for (const auto& [room, acting] : state.actingByRoom)
+		if (acting == state.myPlayerId)
+			return true;
+	return false;
+}
+
+uint64_t SessionEvents::HandResultCount(const State& state, int roomId)
+{
+	if (roomId < 0)
+		return state.handResults;
+	auto it = state.handResultsByRoom.find(roomId);
+	return it == state.handResultsByRoom.end() ? 0 : it->second;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+
+// Latest session facts published by NetPackHandler, for code that has to block
+// until something happens on the table (headless scripts, load harness).
+class SessionEvents
+{
+public:
+	struct State
+	{
+		int myPlayerId = -1;
+		uint64_t tableUpdates = 0;
+		uint64_t handResults = 0;
+		uint64_t errors = 0;
+		uint16_t lastError = 0;
+		std::map<int, int> actingByRoom;    // roomId -> acting player id from the latest table info
+		std::map<int, uint64_t> handResultsByRoom;
+	};
+
+	static SessionEvents& Inst();
+
+	// dispatch thread
+	void OnLogin(int playerId);
+	void OnTableInfo(int roomId, int actingPlayerId);
+	void OnHandResult(int roomId);
+	void OnError(uint16_t errCode);
+
+	State Snapshot();
+	// Blocks until pred(state) holds, returns false on timeout
+	bool WaitUntil(const std::function<bool(const State&)>& pred, std::chrono::milliseconds timeout);
+
+	// roomId < 0 means any room
+	static bool IsMyTurn(const State& state, int roomId);
+	static uint64_t HandResultCount(const State& state, int roomId);
+
+private:
+	SessionEvents() = default;
+	void Publish(const std::function<void(State&)>& update);
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	State m_state;
+};
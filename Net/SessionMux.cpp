@@ -0,0 +1,325 @@
+#include "pch.h"
+#include "SessionMux.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <vector>
+
+#undef min
+#undef max
+
+namespace
+{
+	void WriteHeader(char* frame, RpcEnum type, size_t payload, uint16_t session)
+	{
+		// same layout as a NetPack header, so the peer's NetPackFramer cuts envelopes too
+		const uint16_t rawType = (uint16_t)type;
+		const uint16_t rawSize = (uint16_t)(SessionMux::kHeaderLen + payload);
+		memcpy(frame, &rawType, 2);
+		memcpy(frame + 2, &rawSize, 2);
+		memcpy(frame + 4, &session, 2);
+	}
+}
+
+// One logical session. Inbound bytes are pushed by the mux thread into the callback
+// when one is set, otherwise buffered for Recv.
+class SessionMux::Channel : public Transport
+{
+public:
+	Channel(SessionMux& mux, uint16_t id) :
+		m_mux(mux),
+		m_id(id)
+	{
+	}
+	~Channel() override
+	{
+		Shutdown();
+		m_mux.Detach(m_id);
+	}
+
+	int Recv(char* buffer, int length) override
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [this]() { return !m_inbound.empty() || m_ended || m_shutdown; });
+		if (!m_inbound.empty())
+		{
+			const int count = std::min(length, (int)m_inbound.size());
+			memcpy(buffer, m_inbound.data(), count);
+			m_inbound.erase(m_inbound.begin(), m_inbound.begin() + count);
+			return count;
+		}
+		return m_shutdown ? 0 : m_endResult;
+	}
+
+	bool Send(const char* data, size_t length) override
+	{
+		if (m_shutdown || m_ended)
+			return false;
+		if (m_mux.Send(RpcEnum::rpc_mux_data, m_id, data, length))
+			return true;
+		m_lastError = m_mux.m_lastError != 0 ? m_mux.m_lastError.load() : WSAECONNRESET;
+		return false;
+	}
+
+	void Shutdown() override
+	{
+		if (m_shutdown.exchange(true))
+			return;
+		// the owner may close us from inside the callback (Player deletes itself on a reset),
+		// Deliver then sees m_shutdown before the next call
+		if (m_delivering.load() != std::this_thread::get_id())
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_callback = nullptr;
+		}
+		m_cv.notify_all();
+		// a session the peer closed, or one on a dead link, has nobody left to tell
+		if (!m_ended)
+			m_mux.Send(RpcEnum::rpc_mux_close, m_id, nullptr, 0);
+	}
+
+	int LastError() const override { return m_lastError; }
+	const char* Kind() const override { return "mux"; }
+	uint16_t SessionId() const override { return m_id; }
+
+	bool SetDataCallback(DataCallback callback) override
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_shutdown)
+			return false;
+		m_callback = std::move(callback);
+		// whatever arrived before the owner was ready goes first
+		if (!m_inbound.empty())
+		{
+			Invoke(m_inbound.data(), (int)m_inbound.size());
+			m_inbound.clear();
+		}
+		if (m_ended && !m_shutdown)
+			Invoke(nullptr, m_endResult);
+		return true;
+	}
+
+	// mux thread, under the mux mutex. length 0: the peer closed the session, <0: the link broke
+	void Deliver(const char* data, int length, int error = 0)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_shutdown || m_ended)
+			return;
+		if (length <= 0)
+		{
+			m_lastError = error;
+			m_endResult = length;
+			m_ended = true;
+		}
+		if (m_callback)
+		{
+			Invoke(data, length);
+			return;
+		}
+		if (length > 0)
+			m_inbound.insert(m_inbound.end(), data, data + length);
+		m_cv.notify_all();
+	}
+
+private:
+	// under m_mutex
+	void Invoke(const char* data, int length)
+	{
+		m_delivering = std::this_thread::get_id();
+		m_callback(data, length);
+		m_delivering = std::thread::id();
+	}
+
+	SessionMux& m_mux;
+	const uint16_t m_id;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	DataCallback m_callback;
+	std::vector<char> m_inbound;
+	int m_endResult = 0;
+	std::atomic<bool> m_ended = false;
+	std::atomic<bool> m_shutdown = false;
+	std::atomic<int> m_lastError = 0;
+	std::atomic<std::thread::id> m_delivering{};
+};
+
+SessionMux::SessionMux(std::unique_ptr<Transport> link) :
+	m_link(std::move(link))
+{
+	m_recvThread = std::thread(&SessionMux::RecvJob, this);
+}
+
+SessionMux::~SessionMux()
+{
+	m_closed = true;
+	m_link->Shutdown();
+	if (m_recvThread.joinable())
+		m_recvThread.join();
+}
+
+std::unique_ptr<Transport> SessionMux::OpenSession()
+{
+	if (m_closed)
+		return nullptr;
+	std::unique_ptr<Channel> channel;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_channels.size() >= 0xFFFF)
+			return nullptr;
+		// 0 is the plain, unmultiplexed connection
+		while (m_nextId == 0 || m_channels.count(m_nextId))
+			m_nextId++;
+		const uint16_t id = m_nextId++;
+		channel = std::make_unique<Channel>(*this, id);
+		m_channels[id] = channel.get();
+		m_stats.opened++;
+	}
+	// the open goes out before the session can send, the link keeps them in order
+	if (!Send(RpcEnum::rpc_mux_open, channel->SessionId(), nullptr, 0))
+		return nullptr;
+	return channel;
+}
+
+void SessionMux::RecvJob()
+{
+	char buffer[NET_PACK_MAX_LEN];
+	NetPackFramer framer;
+	while (!m_closed)
+	{
+		int received = m_link->Recv(buffer, sizeof(buffer));
+		if (received <= 0)
+		{
+			Fail(received == 0 ? 0 : (m_link->LastError() != 0 ? m_link->LastError() : WSAECONNRESET));
+			return;
+		}
+		if (!framer.Feed(buffer, (size_t)received, [this](NetPack&& pack) { OnPack(pack); }))
+		{
+			Console::Err() << "mux link sent a corrupt pack, dropping every session" << std::endl;
+			m_link->Shutdown();
+			Fail(WSAECONNRESET);
+			return;
+		}
+	}
+	Fail(0);
+}
+
+void SessionMux::OnPack(NetPack& pack)
+{
+	const RpcEnum type = pack.MsgType();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (type != RpcEnum::rpc_mux_data && type != RpcEnum::rpc_mux_close)
+	{
+		m_stats.foreignPacks++;
+		return;
+	}
+	m_stats.envelopesIn++;
+	auto it = m_channels.find(ReadSession(pack));
+	if (it == m_channels.end())
+	{
+		m_stats.unknownSession++;
+		return;
+	}
+	if (type == RpcEnum::rpc_mux_close)
+	{
+		m_stats.closedByPeer++;
+		it->second->Deliver(nullptr, 0);
+		return;
+	}
+	size_t length = 0;
+	const char* data = Payload(pack, length);
+	m_stats.bytesIn += length;
+	if (length > 0)
+		it->second->Deliver(data, (int)length);
+}
+
+bool SessionMux::Send(RpcEnum type, uint16_t session, const char* data, size_t length)
+{
+	if (m_closed)
+		return false;
+	std::unique_lock<std::mutex> lock(m_sendMutex);
+	const bool sent = type == RpcEnum::rpc_mux_data
+		? SendData(*m_link, session, data, length)
+		: SendControl(*m_link, type, session);
+	if (!sent)
+	{
+		lock.unlock();
+		// the recv thread wakes up and fails every session
+		m_link->Shutdown();
+		return false;
+	}
+	m_envelopesOut += type == RpcEnum::rpc_mux_data ? (length + kMaxChunk - 1) / kMaxChunk : 1;
+	m_bytesOut += length;
+	return true;
+}
+
+void SessionMux::Detach(uint16_t session)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_channels.erase(session);
+}
+
+void SessionMux::Fail(int error)
+{
+	if (error != 0)
+		m_lastError = error;
+	m_closed = true;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (auto& [id, channel] : m_channels)
+		channel->Deliver(nullptr, error == 0 ? 0 : -1, error);
+}
+
+bool SessionMux::SendData(Transport& link, uint16_t session, const char* data, size_t length)
+{
+	char frame[NET_PACK_MAX_LEN];
+	while (length > 0)
+	{
+		const size_t chunk = std::min(length, kMaxChunk);
+		WriteHeader(frame, RpcEnum::rpc_mux_data, chunk, session);
+		memcpy(frame + kHeaderLen, data, chunk);
+		if (!link.Send(frame, kHeaderLen + chunk))
+			return false;
+		data += chunk;
+		length -= chunk;
+	}
+	return true;
+}
+
+bool SessionMux::SendControl(Transport& link, RpcEnum type, uint16_t session)
+{
+	char frame[kHeaderLen];
+	WriteHeader(frame, type, 0, session);
+	return link.Send(frame, kHeaderLen);
+}
+
+uint16_t SessionMux::ReadSession(NetPack& pack)
+{
+	pack.ResetReadPos();
+	return pack.ReadUInt16();
+}
+
+const char* SessionMux::Payload(NetPack& pack, size_t& length)
+{
+	length = pack.Length() > kHeaderLen ? pack.Length() - kHeaderLen : 0;
+	return pack.GetContent() + kHeaderLen;
+}
+
+SessionMux::Stats SessionMux::GetStats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Stats stats = m_stats;
+	stats.sessions = m_channels.size();
+	stats.envelopesOut = m_envelopesOut;
+	stats.bytesOut = m_bytesOut;
+	return stats;
+}
+
+void SessionMux::PrintStats()
+{
+	const Stats stats = GetStats();
+	Console::Out() << "[MUX] link " << m_link->Kind() << (Alive() ? "" : " (down)")
+		<< ", sessions " << stats.sessions << " (opened " << stats.opened << ", closed by peer " << stats.closedByPeer << ")"
+		<< ", envelopes in/out " << stats.envelopesIn << "/" << stats.envelopesOut
+		<< ", payload bytes in/out " << stats.bytesIn << "/" << stats.bytesOut
+		<< ", header bytes " << (stats.envelopesIn + stats.envelopesOut) * kHeaderLen
+		<< ", unknown session " << stats.unknownSession << ", foreign packs " << stats.foreignPacks << std::endl;
+}
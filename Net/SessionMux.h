@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Net/NetPack.h"
+#include "Net/Transport.h"
+
+// Carries many logical sessions over one connection, so a bot farm does not need a
+// socket, a handshake and a pair of kernel buffers per account.
+// Sessions are ordinary NetPack streams wrapped in envelopes on the link:
+//     rpc_mux_open   sessionId:u16                  a new session, sent before its first data
+//     rpc_mux_data   sessionId:u16, stream bytes    a piece of the session's pack stream
+//     rpc_mux_close  sessionId:u16                  either side ends the session
+// A pack bigger than one envelope is cut across several, the receiver frames each session's
+// bytes on their own. OpenSession returns a Transport, so a Player runs unchanged on top;
+// it pushes inbound bytes (SetDataCallback) from the mux thread, sessions cost no thread.
+// Sessions do not survive the link: when it drops they all see a reset.
+class SessionMux
+{
+public:
+	static constexpr size_t kHeaderLen = 6;   // type:u16, size:u16, sessionId:u16
+	static constexpr size_t kMaxChunk = NET_PACK_MAX_LEN - kHeaderLen;
+
+	struct Stats
+	{
+		size_t sessions = 0;             // open now
+		uint64_t opened = 0;
+		uint64_t closedByPeer = 0;
+		uint64_t envelopesIn = 0;
+		uint64_t envelopesOut = 0;
+		uint64_t bytesIn = 0;            // session payload, envelope headers excluded
+		uint64_t bytesOut = 0;
+		uint64_t unknownSession = 0;     // data for a session we do not have (closed meanwhile)
+		uint64_t foreignPacks = 0;       // not mux rpcs, a peer without mux support answers with errors
+	};
+
+	// Takes over a connected link to a peer that speaks the mux rpcs (LoopbackServer does)
+	explicit SessionMux(std::unique_ptr<Transport> link);
+	// Every session has to be destroyed before the mux
+	~SessionMux();
+	SessionMux(const SessionMux&) = delete;
+	SessionMux& operator=(const SessionMux&) = delete;
+
+	// nullptr once the link is down or all ids are taken
+	std::unique_ptr<Transport> OpenSession();
+	bool Alive() const { return !m_closed; }
+	const char* LinkKind() const { return m_link->Kind(); }
+	Stats GetStats();
+	void PrintStats();
+
+	// Envelope writers, shared with LoopbackServer. Callers serialize sends on the link.
+	static bool SendData(Transport& link, uint16_t session, const char* data, size_t length);
+	static bool SendControl(Transport& link, RpcEnum type, uint16_t session);
+	// Read side of an rpc_mux_* pack: the session id, then (rpc_mux_data) the stream bytes
+	static uint16_t ReadSession(NetPack& pack);
+	static const char* Payload(NetPack& pack, size_t& length);
+
+private:
+	class Channel;
+
+	void RecvJob();
+	void OnPack(NetPack& pack);
+	bool Send(RpcEnum type, uint16_t session, const char* data, size_t length);
+	void Detach(uint16_t session);
+	// the link is gone, every session sees the error
+	void Fail(int error);
+
+	std::unique_ptr<Transport> m_link;
+	std::thread m_recvThread;
+	std::mutex m_sendMutex;
+	// guards m_channels and is held while a channel delivers, so a session being
+	// destroyed waits for a delivery in progress instead of racing it
+	std::mutex m_mutex;
+	std::map<uint16_t, Channel*> m_channels;
+	uint16_t m_nextId = 1;
+	std::atomic<bool> m_closed = false;
+	std::atomic<int> m_lastError = 0;
+	Stats m_stats{};                     // inbound side, under m_mutex
+	std::atomic<uint64_t> m_envelopesOut = 0;
+	std::atomic<uint64_t> m_bytesOut = 0;
+};
@@ -0,0 +1,547 @@
+#include "pch.h"
+#include "ShmTransport.h"
+#include <cstring>
+#include <new>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#undef min
+#undef max
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared memory rings need lock free atomics");
+static_assert((ShmTransport::kRingBytes & (ShmTransport::kRingBytes - 1)) == 0, "ring size must be a power of two");
+
+struct ShmRing
+{
+	alignas(64) std::atomic<uint32_t> head;      // bytes written, owned by the producer
+	std::atomic<uint32_t> dataSignal;            // the consumer sleeps on this one
+	std::atomic<uint32_t> consumerWaiting;
+	alignas(64) std::atomic<uint32_t> tail;      // bytes consumed, owned by the consumer
+	std::atomic<uint32_t> spaceSignal;           // the producer sleeps on this one while the ring is full
+	std::atomic<uint32_t> producerWaiting;
+	alignas(64) char data[ShmTransport::kRingBytes];
+};
+
+struct ShmSlot
+{
+	alignas(64) std::atomic<uint32_t> state;
+	std::atomic<uint32_t> closedSides;
+	ShmRing rings[2];                            // 0: client -> server, 1: server -> client
+};
+
+struct ShmRegion
+{
+	std::atomic<uint32_t> magic;
+	uint32_t version;
+	std::atomic<uint32_t> listening;
+	std::atomic<uint32_t> acceptSignal;
+	std::atomic<uint32_t> acceptWaiting;
+	uint32_t ownerPid;                           // the listening process, tells a live region from a crashed one's
+	ShmSlot slots[ShmTransport::kMaxSlots];
+};
+
+namespace
+{
+	constexpr uint32_t kMagic = 0x43534852;      // "CSHR"
+	constexpr uint32_t kVersion = 2;
+	constexpr int kSpinCount = 256;
+	// spinning only pays off when the peer runs on another core meanwhile
+	const int g_spinCount = std::thread::hardware_concurrency() > 1 ? kSpinCount : 0;
+
+	// slot states
+	constexpr uint32_t kFree = 0;
+	constexpr uint32_t kClaiming = 1;            // a client is resetting the rings
+	constexpr uint32_t kPending = 2;             // waiting for ShmListener::Accept
+	constexpr uint32_t kOpen = 3;
+
+	constexpr uint32_t kClientBit = 1;
+	constexpr uint32_t kServerBit = 2;
+
+	// one doorbell per ring direction, plus one for Accept
+	constexpr int kAcceptEvent = ShmTransport::kMaxSlots * 4;
+	constexpr int kEventCount = kAcceptEvent + 1;
+	int RingEvent(int slot, int ring, bool space) { return (slot * 2 + ring) * 2 + (space ? 1 : 0); }
+
+	void CpuRelax()
+	{
+#if defined(_WIN32)
+		YieldProcessor();
+#elif defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+
+	void ResetRing(ShmRing& ring)
+	{
+		// the signals only ever count up, a sleeper compares against the value it saw
+		ring.head = 0;
+		ring.tail = 0;
+		ring.consumerWaiting = 0;
+		ring.producerWaiting = 0;
+	}
+
+	void CopyIn(ShmRing& ring, uint32_t head, const char* data, uint32_t count)
+	{
+		const uint32_t offset = head & (ShmTransport::kRingBytes - 1);
+		const uint32_t first = std::min(count, ShmTransport::kRingBytes - offset);
+		memcpy(ring.data + offset, data, first);
+		memcpy(ring.data, data + first, count - first);
+	}
+
+	void CopyOut(const ShmRing& ring, uint32_t tail, char* buffer, uint32_t count)
+	{
+		const uint32_t offset = tail & (ShmTransport::kRingBytes - 1);
+		const uint32_t first = std::min(count, ShmTransport::kRingBytes - offset);
+		memcpy(buffer, ring.data + offset, first);
+		memcpy(buffer + first, ring.data, count - first);
+	}
+}
+
+// The named region plus the platform doorbells
+class ShmMapping
+{
+public:
+	static std::shared_ptr<ShmMapping> Map(const std::string& name, bool create);
+	~ShmMapping();
+
+	ShmRegion& Region() const { return *m_region; }
+	// Sleeps until word moved away from seen, Wake was called or timeoutMs (-1: forever) passed
+	void Wait(int event, std::atomic<uint32_t>& word, uint32_t seen, int timeoutMs);
+	void Wake(int event, std::atomic<uint32_t>& word);
+	// Removes the name so no new client finds the region, mapped views stay valid
+	void Unlink();
+
+private:
+	ShmMapping() = default;
+
+	ShmRegion* m_region = nullptr;
+	bool m_owner = false;
+#ifdef _WIN32
+	HANDLE m_file = NULL;
+	std::vector<HANDLE> m_events;
+#else
+	std::string m_path;
+#endif
+};
+
+#ifdef _WIN32
+std::shared_ptr<ShmMapping> ShmMapping::Map(const std::string& name, bool create)
+{
+	const std::string base = "Local\\CppClientShm-" + name;
+	std::shared_ptr<ShmMapping> mapping(new ShmMapping());
+	mapping->m_owner = create;
+	mapping->m_file = create
+		? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)sizeof(ShmRegion), base.c_str())
+		: OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, base.c_str());
+	if (mapping->m_file == NULL)
+		return nullptr;
+	if (create && GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		Console::Err() << "shm: region " << name << " is already served by another process" << std::endl;
+		return nullptr;
+	}
+	mapping->m_region = (ShmRegion*)MapViewOfFile(mapping->m_file, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(ShmRegion));
+	if (mapping->m_region == nullptr)
+		return nullptr;
+	mapping->m_events.reserve(kEventCount);
+	for (int i = 0; i < kEventCount; i++)
+	{
+		// auto reset, CreateEvent opens the server's event if it already exists
+		HANDLE ev = CreateEventA(NULL, FALSE, FALSE, (base + "-" + std::to_string(i)).c_str());
+		if (ev == NULL)
+			return nullptr;
+		mapping->m_events.push_back(ev);
+	}
+	return mapping;
+}
+
+ShmMapping::~ShmMapping()
+{
+	for (HANDLE ev : m_events)
+		CloseHandle(ev);
+	if (m_region)
+		UnmapViewOfFile(m_region);
+	if (m_file)
+		CloseHandle(m_file);
+}
+
+void ShmMapping::Wait(int event, std::atomic<uint32_t>&, uint32_t, int timeoutMs)
+{
+	// a SetEvent that raced ahead of us stays signalled, so nothing is lost
+	WaitForSingleObject(m_events[event], timeoutMs < 0 ? INFINITE : (DWORD)timeoutMs);
+}
+
+void ShmMapping::Wake(int event, std::atomic<uint32_t>&)
+{
+	SetEvent(m_events[event]);
+}
+
+void ShmMapping::Unlink()
+{
+	// the name goes away with the last handle
+}
+#else
+namespace
+{
+	// the region at path is listening and the process that opened it still exists
+	bool ServedByLiveProcess(const std::string& path)
+	{
+		int fd = shm_open(path.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			return false;
+		bool live = false;
+		struct stat info{};
+		if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(ShmRegion))
+		{
+			void* view = mmap(nullptr, sizeof(ShmRegion), PROT_READ, MAP_SHARED, fd, 0);
+			if (view != MAP_FAILED)
+			{
+				const ShmRegion& region = *(const ShmRegion*)view;
+				const pid_t owner = (pid_t)region.ownerPid;
+				live = region.magic == kMagic && region.version == kVersion && region.listening
+					&& owner > 0 && (kill(owner, 0) == 0 || errno == EPERM);
+				munmap(view, sizeof(ShmRegion));
+			}
+		}
+		close(fd);
+		return live;
+	}
+}
+
+std::shared_ptr<ShmMapping> ShmMapping::Map(const std::string& name, bool create)
+{
+	std::shared_ptr<ShmMapping> mapping(new ShmMapping());
+	mapping->m_owner = create;
+	mapping->m_path = "/cppclient-" + name;
+	int fd = -1;
+	if (create)
+	{
+		fd = shm_open(mapping->m_path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0 && errno == EEXIST)
+		{
+			if (ServedByLiveProcess(mapping->m_path))
+			{
+				Console::Err() << "shm: region " << name << " is already served by another process" << std::endl;
+				return nullptr;
+			}
+			// left behind by a server that crashed: remove it and start over
+			shm_unlink(mapping->m_path.c_str());
+			fd = shm_open(mapping->m_path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		}
+	}
+	else
+		fd = shm_open(mapping->m_path.c_str(), O_RDWR, 0);
+	if (fd < 0)
+		return nullptr;
+	struct stat info{};
+	if ((create && ftruncate(fd, sizeof(ShmRegion)) != 0)
+		|| fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ShmRegion))
+	{
+		close(fd);
+		return nullptr;
+	}
+	void* view = mmap(nullptr, sizeof(ShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return nullptr;
+	mapping->m_region = (ShmRegion*)view;
+	return mapping;
+}
+
+ShmMapping::~ShmMapping()
+{
+	if (m_region)
+		munmap(m_region, sizeof(ShmRegion));
+}
+
+void ShmMapping::Wait(int, std::atomic<uint32_t>& word, uint32_t seen, int timeoutMs)
+{
+#ifdef __linux__
+	// not FUTEX_PRIVATE_FLAG, the word is shared with the other process
+	struct timespec timeout { timeoutMs / 1000, (long)(timeoutMs % 1000) * 1000000 };
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen,
+		timeoutMs < 0 ? nullptr : &timeout, nullptr, 0);
+#else
+	(void)word; (void)seen;
+	std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs < 0 ? 1 : std::min(timeoutMs, 1)));
+#endif
+}
+
+void ShmMapping::Wake(int, std::atomic<uint32_t>& word)
+{
+#ifdef __linux__
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+	(void)word;
+#endif
+}
+
+void ShmMapping::Unlink()
+{
+	if (m_owner)
+		shm_unlink(m_path.c_str());
+}
+#endif
+
+namespace
+{
+	// Spins briefly, then sleeps on the doorbell until ready() holds. Setting waiting
+	// before the last ready() check pairs with Notify, so a wakeup cannot slip in between.
+	template <class Ready>
+	bool WaitUntil(ShmMapping& mapping, int event, std::atomic<uint32_t>& signal,
+		std::atomic<uint32_t>& waiting, Ready ready, int timeoutMs)
+	{
+		for (int i = 0; i < g_spinCount; i++)
+		{
+			if (ready())
+				return true;
+			CpuRelax();
+		}
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0));
+		while (true)
+		{
+			const uint32_t seen = signal.load();
+			waiting = 1;
+			if (ready())
+			{
+				waiting = 0;
+				return true;
+			}
+			int waitMs = -1;
+			if (timeoutMs >= 0)
+			{
+				auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+					deadline - std::chrono::steady_clock::now()).count();
+				if (left <= 0)
+				{
+					waiting = 0;
+					return false;
+				}
+				waitMs = (int)left;
+			}
+			mapping.Wait(event, signal, seen, waitMs);
+		}
+	}
+
+	// Rings the doorbell if the other side sleeps on it (or always, e.g. on close)
+	void Notify(ShmMapping& mapping, int event, std::atomic<uint32_t>& signal,
+		std::atomic<uint32_t>& waiting, bool always)
+	{
+		if (!waiting.exchange(0) && !always)
+			return;
+		signal++;
+		mapping.Wake(event, signal);
+	}
+}
+
+std::unique_ptr<Transport> ShmTransport::Connect(const std::string& name, int timeoutMs, bool quiet)
+{
+	auto mapping = ShmMapping::Map(name, false);
+	if (!mapping || mapping->Region().magic != kMagic || mapping->Region().version != kVersion
+		|| !mapping->Region().listening)
+	{
+		if (!quiet) Console::Err() << "shm: no server listening on " << name << std::endl;
+		return nullptr;
+	}
+	ShmRegion& region = mapping->Region();
+	for (int slot = 0; slot < kMaxSlots; slot++)
+	{
+		ShmSlot& s = region.slots[slot];
+		uint32_t expected = kFree;
+		if (!s.state.compare_exchange_strong(expected, kClaiming))
+			continue;
+		s.closedSides = 0;
+		for (auto& ring : s.rings)
+			ResetRing(ring);
+		s.state = kPending;
+		Notify(*mapping, kAcceptEvent, region.acceptSignal, region.acceptWaiting, true);
+
+		// Accept rings the server->client data doorbell once the slot is open
+		ShmRing& inbound = s.rings[1];
+		bool accepted = WaitUntil(*mapping, RingEvent(slot, 1, false), inbound.dataSignal, inbound.consumerWaiting,
+			[&s]() { return s.state == kOpen; }, timeoutMs);
+		expected = kPending;
+		if (!accepted && s.state.compare_exchange_strong(expected, kFree))
+		{
+			if (!quiet) Console::Err() << "shm: server did not accept within " << timeoutMs << " ms" << std::endl;
+			return nullptr;
+		}
+		return std::unique_ptr<Transport>(new ShmTransport(std::move(mapping), slot, false));
+	}
+	if (!quiet) Console::Err() << "shm: all " << kMaxSlots << " slots of " << name << " are in use" << std::endl;
+	return nullptr;
+}
+
+ShmTransport::ShmTransport(std::shared_ptr<ShmMapping> mapping, int slot, bool serverSide) :
+	m_mapping(std::move(mapping)),
+	m_slot(slot),
+	m_serverSide(serverSide)
+{
+}
+
+ShmTransport::~ShmTransport()
+{
+	Shutdown();
+}
+
+ShmSlot& ShmTransport::Slot() const
+{
+	return m_mapping->Region().slots[m_slot];
+}
+
+ShmRing& ShmTransport::Inbound() const
+{
+	return Slot().rings[InboundRing()];
+}
+
+ShmRing& ShmTransport::Outbound() const
+{
+	return Slot().rings[OutboundRing()];
+}
+
+bool ShmTransport::Broken() const
+{
+	// once either side closed the slot may be handed to a new client, only m_shutdown protects us then
+	return m_shutdown || Slot().closedSides != 0;
+}
+
+int ShmTransport::Recv(char* buffer, int length)
+{
+	ShmRing& ring = Inbound();
+	WaitUntil(*m_mapping, RingEvent(m_slot, InboundRing(), false), ring.dataSignal, ring.consumerWaiting,
+		[this, &ring]() { return m_shutdown || ring.head != ring.tail.load(std::memory_order_relaxed) || Broken(); }, -1);
+	if (m_shutdown || length <= 0)
+		return 0;
+	const uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+	const uint32_t available = ring.head - tail;
+	// the peer closed and everything it wrote was read
+	if (available == 0)
+		return 0;
+	const uint32_t count = std::min(available, (uint32_t)length);
+	CopyOut(ring, tail, buffer, count);
+	ring.tail = tail + count;
+	Notify(*m_mapping, RingEvent(m_slot, InboundRing(), true), ring.spaceSignal, ring.producerWaiting, false);
+	return (int)count;
+}
+
+bool ShmTransport::Send(const char* data, size_t length)
+{
+	ShmRing& ring = Outbound();
+	while (length > 0)
+	{
+		if (Broken())
+			return false;
+		const uint32_t head = ring.head.load(std::memory_order_relaxed);
+		const uint32_t space = kRingBytes - (head - ring.tail);
+		if (space == 0)
+		{
+			WaitUntil(*m_mapping, RingEvent(m_slot, OutboundRing(), true), ring.spaceSignal, ring.producerWaiting,
+				[this, &ring, head]() { return ring.tail != head - kRingBytes || Broken(); }, -1);
+			continue;
+		}
+		const uint32_t count = (uint32_t)std::min<size_t>(space, length);
+		CopyIn(ring, head, data, count);
+		ring.head = head + count;
+		Notify(*m_mapping, RingEvent(m_slot, OutboundRing(), false), ring.dataSignal, ring.consumerWaiting, false);
+		data += count;
+		length -= count;
+	}
+	return true;
+}
+
+void ShmTransport::Shutdown()
+{
+	if (m_shutdown.exchange(true))
+		return;
+	ShmSlot& slot = Slot();
+	const uint32_t bit = m_serverSide ? kServerBit : kClientBit;
+	const uint32_t before = slot.closedSides.fetch_or(bit);
+	// wake everyone sleeping on the slot, the peer and our own blocked Recv
+	for (int r = 0; r < 2; r++)
+	{
+		ShmRing& ring = slot.rings[r];
+		Notify(*m_mapping, RingEvent(m_slot, r, false), ring.dataSignal, ring.consumerWaiting, true);
+		Notify(*m_mapping, RingEvent(m_slot, r, true), ring.spaceSignal, ring.producerWaiting, true);
+	}
+	// the side that closes last hands the slot back
+	if ((before | bit) == (kClientBit | kServerBit))
+		slot.state = kFree;
+}
+
+ShmListener::~ShmListener()
+{
+	Close();
+}
+
+bool ShmListener::Open(const std::string& name)
+{
+	if (IsOpen())
+		return false;
+	auto mapping = ShmMapping::Map(name, true);
+	if (!mapping)
+	{
+		Console::Err() << "shm: cannot create region " << name << std::endl;
+		return false;
+	}
+	ShmRegion& region = mapping->Region();
+	new (&region) ShmRegion();
+	region.version = kVersion;
+#ifdef _WIN32
+	region.ownerPid = GetCurrentProcessId();
+#else
+	region.ownerPid = (uint32_t)getpid();
+#endif
+	region.listening = 1;
+	region.magic = kMagic;
+	m_mapping = std::move(mapping);
+	m_closed = false;
+	return true;
+}
+
+std::unique_ptr<Transport> ShmListener::Accept(int timeoutMs)
+{
+	if (!IsOpen())
+		return nullptr;
+	ShmRegion& region = m_mapping->Region();
+	int accepted = -1;
+	auto claim = [this, &region, &accepted]() {
+		if (m_closed)
+			return true;
+		for (int slot = 0; slot < ShmTransport::kMaxSlots; slot++)
+		{
+			uint32_t expected = kPending;
+			if (region.slots[slot].state.compare_exchange_strong(expected, kOpen))
+			{
+				accepted = slot;
+				return true;
+			}
+		}
+		return false;
+	};
+	if (!WaitUntil(*m_mapping, kAcceptEvent, region.acceptSignal, region.acceptWaiting, claim, timeoutMs)
+		|| accepted < 0)
+		return nullptr;
+
+	ShmRing& toClient = region.slots[accepted].rings[1];
+	Notify(*m_mapping, RingEvent(accepted, 1, false), toClient.dataSignal, toClient.consumerWaiting, true);
+	return std::unique_ptr<Transport>(new ShmTransport(m_mapping, accepted, true));
+}
+
+void ShmListener::Close()
+{
+	if (!m_mapping || m_closed.exchange(true))
+		return;
+	ShmRegion& region = m_mapping->Region();
+	region.listening = 0;
+	Notify(*m_mapping, kAcceptEvent, region.acceptSignal, region.acceptWaiting, true);
+	m_mapping->Unlink();
+}
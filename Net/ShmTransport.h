@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include "Net/Transport.h"
+
+class ShmMapping;
+struct ShmSlot;
+struct ShmRing;
+
+// Shared memory transport for bots and a server on the same host, selected with shm://<name>.
+// The server maps a named region of kMaxSlots connection slots. A slot holds two single
+// producer / single consumer byte rings (client->server and server->client), so a pack is
+// one memcpy in and one memcpy out instead of two trips through the kernel TCP stack.
+// A reader spins briefly, then sleeps on a futex (Linux) or a named event (Windows);
+// the writer only pays for the wakeup when the reader is actually asleep.
+// There is no liveness check: if the server process dies, a blocked client Recv waits forever.
+class ShmTransport : public Transport
+{
+public:
+	static constexpr int kMaxSlots = 16;
+	static constexpr uint32_t kRingBytes = 64 * 1024;
+
+	// Client side: claims a free slot of the region the server opened under name and waits
+	// for the server to accept it. Returns nullptr if there is no server or no free slot.
+	static std::unique_ptr<Transport> Connect(const std::string& name, int timeoutMs = 2000, bool quiet = false);
+
+	~ShmTransport() override;
+	ShmTransport(const ShmTransport&) = delete;
+	ShmTransport& operator=(const ShmTransport&) = delete;
+
+	int Recv(char* buffer, int length) override;
+	bool Send(const char* data, size_t length) override;
+	void Shutdown() override;
+	const char* Kind() const override { return "shm"; }
+
+private:
+	friend class ShmListener;
+	ShmTransport(std::shared_ptr<ShmMapping> mapping, int slot, bool serverSide);
+
+	ShmSlot& Slot() const;
+	ShmRing& Inbound() const;
+	ShmRing& Outbound() const;
+	int InboundRing() const { return m_serverSide ? 0 : 1; }
+	int OutboundRing() const { return m_serverSide ? 1 : 0; }
+	bool Broken() const;
+
+	std::shared_ptr<ShmMapping> m_mapping;
+	int m_slot;
+	bool m_serverSide;
+	std::atomic<bool> m_shutdown = false;
+};
+
+// Server side of the shared memory transport, owns the named region
+class ShmListener
+{
+public:
+	ShmListener() = default;
+	~ShmListener();
+	ShmListener(const ShmListener&) = delete;
+	ShmListener& operator=(const ShmListener&) = delete;
+
+	bool Open(const std::string& name);
+	// Waits up to timeoutMs for a client to claim a slot, nullptr on timeout or once closed
+	std::unique_ptr<Transport> Accept(int timeoutMs);
+	// Wakes a blocked Accept and removes the region name, open connections keep working
+	void Close();
+	bool IsOpen() const { return m_mapping != nullptr && !m_closed; }
+
+private:
+	std::shared_ptr<ShmMapping> m_mapping;
+	std::atomic<bool> m_closed = false;
+};
@@ -0,0 +1,56 @@
+#pragma once
+// Winsock names for the socket code on POSIX, so the networking layer and the
+// loopback server stub build on Linux as well. On Windows this is just winsock.
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+// winsock never raises a signal for a closed peer
+#define MSG_NOSIGNAL 0
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0   // macOS: SIGPIPE is ignored in WSAStartup below
+#endif
+
+typedef int SOCKET;
+typedef struct pollfd WSAPOLLFD;
+struct WSADATA { int unused; };
+
+#define INVALID_SOCKET (-1)
+#define SOCKET_ERROR (-1)
+#define SD_RECEIVE SHUT_RD
+#define SD_SEND SHUT_WR
+#define SD_BOTH SHUT_RDWR
+#define WSAEWOULDBLOCK EWOULDBLOCK
+#define WSAEINPROGRESS EINPROGRESS
+#define WSAECONNRESET ECONNRESET
+#define MAKEWORD(low, high) ((unsigned short)(((low) & 0xff) | (((high) & 0xff) << 8)))
+
+// a send to a peer that hung up raises SIGPIPE, which ends the process; ignored, the send
+// fails with EPIPE as it does on Windows
+inline int WSAStartup(unsigned short, WSADATA*) { signal(SIGPIPE, SIG_IGN); return 0; }
+inline int WSACleanup() { return 0; }
+inline int WSAGetLastError() { return errno; }
+inline int closesocket(SOCKET s) { return close(s); }
+inline int WSAPoll(WSAPOLLFD* fds, unsigned long count, int timeoutMs) { return poll(fds, count, timeoutMs); }
+// only FIONBIO is used by this project
+inline int ioctlsocket(SOCKET s, long, unsigned long* nonBlocking)
+{
+	int flags = fcntl(s, F_GETFL, 0);
+	if (flags < 0) return SOCKET_ERROR;
+	flags = *nonBlocking ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	return fcntl(s, F_SETFL, flags) < 0 ? SOCKET_ERROR : 0;
+}
+#endif
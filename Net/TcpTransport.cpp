@@ -0,0 +1,56 @@
+#include "pch.h"
+#include "TcpTransport.h"
+
+TcpTransport::TcpTransport(SOCKET socket) :
+	m_socket(socket)
+{
+}
+
+TcpTransport::~TcpTransport()
+{
+	closesocket(m_socket);
+}
+
+int TcpTransport::Recv(char* buffer, int length)
+{
+	int received = recv(m_socket, buffer, length, 0);
+	if (received < 0)
+		m_lastError = WSAGetLastError();
+	return received;
+}
+
+bool TcpTransport::Send(const char* data, size_t length)
+{
+	while (length > 0)
+	{
+		int sent = send(m_socket, data, (int)length, MSG_NOSIGNAL);
+		if (sent == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK)
+		{
+			// non blocking socket with a full send buffer, wait until it drains
+			WSAPOLLFD fd{};
+			fd.fd = m_socket;
+			fd.events = POLLOUT;
+			if (WSAPoll(&fd, 1, -1) > 0 && !(fd.revents & (POLLERR | POLLHUP | POLLNVAL)))
+				continue;
+		}
+		if (sent == SOCKET_ERROR || sent == 0)
+		{
+			m_lastError = WSAGetLastError();
+			return false;
+		}
+		data += sent;
+		length -= (size_t)sent;
+	}
+	return true;
+}
+
+bool TcpTransport::SetNonBlocking(bool nonBlocking)
+{
+	unsigned long mode = nonBlocking ? 1 : 0;
+	return ioctlsocket(m_socket, FIONBIO, &mode) != SOCKET_ERROR;
+}
+
+void TcpTransport::Shutdown()
+{
+	shutdown(m_socket, SD_BOTH);
+}
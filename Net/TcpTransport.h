@@ -0,0 +1,25 @@
+#pragma once
+#include <atomic>
+#include "Net/Transport.h"
+
+// Transport over a connected TCP socket, owns and closes it
+class TcpTransport : public Transport
+{
+public:
+	explicit TcpTransport(SOCKET socket);
+	~TcpTransport() override;
+	TcpTransport(const TcpTransport&) = delete;
+	TcpTransport& operator=(const TcpTransport&) = delete;
+
+	int Recv(char* buffer, int length) override;
+	bool Send(const char* data, size_t length) override;
+	void Shutdown() override;
+	int LastError() const override { return m_lastError; }
+	const char* Kind() const override { return "tcp"; }
+	SOCKET PollHandle() const override { return m_socket; }
+	bool SetNonBlocking(bool nonBlocking) override;
+
+private:
+	SOCKET m_socket;
+	std::atomic<int> m_lastError = 0;
+};
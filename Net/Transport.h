@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Byte stream between the client and the server. Player and the loopback server only
+// talk to this interface, so the NetPack framing runs unchanged over TCP or shared memory.
+// Send is not thread safe, callers serialize it (Player::m_sendMutex).
+class Transport
+{
+public:
+	// data/length > 0 for bytes, length 0 once the peer closed, <0 on error (see LastError)
+	using DataCallback = std::function<void(const char* data, int length)>;
+
+	virtual ~Transport() = default;
+
+	// Blocks like recv: bytes read, 0 once the peer closed, <0 on error (see LastError)
+	virtual int Recv(char* buffer, int length) = 0;
+	// Blocks until all bytes are handed over, false once the link is broken
+	virtual bool Send(const char* data, size_t length) = 0;
+	// Breaks the link in both directions and wakes a blocked Recv.
+	// The object stays valid until destroyed, later calls just fail.
+	virtual void Shutdown() = 0;
+	virtual int LastError() const { return 0; }
+	virtual const char* Kind() const = 0;
+
+	// Socket an EventLoop can poll for readability, INVALID_SOCKET if there is none (shm)
+	virtual SOCKET PollHandle() const { return INVALID_SOCKET; }
+	// Non blocking Recv returns <0 with LastError() == WSAEWOULDBLOCK when drained. Send still blocks.
+	virtual bool SetNonBlocking(bool) { return false; }
+
+	// Push mode: bytes are handed to callback from the transport's own thread instead of
+	// being read with Recv. false if the transport cannot push (then Recv it is).
+	// Shutdown detaches the callback and waits for a delivery in progress.
+	virtual bool SetDataCallback(DataCallback) { return false; }
+	// Logical session on a multiplexed connection (SessionMux), 0 for a connection of its own
+	virtual uint16_t SessionId() const { return 0; }
+};
@@ -1,38 +1,128 @@
 #include "pch.h"
 #include "Player.h"
+#include "Net/ReconnectManager.h"
+#include "Net/Transport.h"
+#include "Utils/EventLoop.h"
 
-Player::Player(SOCKET&& socket) :
-	m_socket(socket)
+Player::Player(std::unique_ptr<Transport> transport, ReconnectManager* reconnect, EventLoop* loop) :
+	m_transport(std::move(transport)),
+	m_reconnect(reconnect),
+	m_loop(loop)
 {
-	m_recvThread = std::thread(&Player::RecvJob, this);
+	if (!AttachReader())
+		m_recvThread = std::thread(&Player::RecvJob, this);
+}
+Player::~Player()
+{
+	if (!m_deleted)
+		Delete();
+	// queued packs point at m_tracker
+	m_handler.Detach();
+}
+// Hooks the transport up to something that reads it for us, false if it needs a blocking RecvJob
+bool Player::AttachReader()
+{
+	if (m_transport->SetDataCallback([this](const char* data, int length) { OnData(data, length); }))
+		return true;
+	// shm has nothing to poll, it keeps its blocking recv thread and only hands packs over
+	if (m_loop && m_transport->PollHandle() != INVALID_SOCKET)
+	{
+		m_loop->Post([this]() { WatchTransport(); });
+		return true;
+	}
+	return false;
 }
 void Player::RecvJob()
 {
 	char recvbuf[NET_PACK_MAX_LEN];
 	int recvbuflen = NET_PACK_MAX_LEN;
 	int iResult;
+	NetPackFramer framer;
 	// Receive until the peer shuts down the connection
-	do {
-		iResult = recv(m_socket, recvbuf, recvbuflen, 0);
-		if (iResult > 0)
-		{
-			NetPack pack = NetPack((uint8_t*)recvbuf);
-			OnRecv(std::move(pack));
-		}
-		else
+	while (!m_deleted)
+	{
+		iResult = m_transport->Recv(recvbuf, recvbuflen);
+		if (iResult > 0 && framer.Feed(recvbuf, (size_t)iResult,
+			[this](NetPack&& pack) { OnRecv(std::move(pack)); }))
+			continue;
+
+		framer.Reset();
+		if (!OnConnectionLost(iResult > 0 ? -1 : m_transport->LastError()))
 			break;
-	} while (iResult > 0 && !m_deleted);
+	}
+}
+void Player::WatchTransport()
+{
+	if (m_deleted) return;
+	m_transport->SetNonBlocking(true);
+	m_watched = m_transport->PollHandle();
+	m_loop->Watch(m_watched, EventLoop::Readable, [this](uint32_t) { OnReadable(); });
+}
+void Player::OnReadable()
+{
+	char recvbuf[NET_PACK_MAX_LEN];
+	while (!m_deleted)
+	{
+		int iResult = m_transport->Recv(recvbuf, NET_PACK_MAX_LEN);
+		if (iResult > 0 && m_framer.Feed(recvbuf, (size_t)iResult,
+			[this](NetPack&& pack) { OnRecv(std::move(pack)); }))
+			continue;
+		if (iResult < 0 && m_transport->LastError() == WSAEWOULDBLOCK)
+			return;
+		StartRecovery(iResult > 0 ? -1 : m_transport->LastError());
+		return;
+	}
+	m_loop->Unwatch(m_watched);
+}
+void Player::OnData(const char* data, int length)
+{
+	if (length > 0 && m_framer.Feed(data, (size_t)length,
+		[this](NetPack&& pack) { OnRecv(std::move(pack)); }))
+		return;
+	StartRecovery(length > 0 ? -1 : m_transport->LastError());
+}
+void Player::StartRecovery(int errCode)
+{
+	if (m_watched != INVALID_SOCKET)
+	{
+		m_loop->Unwatch(m_watched);
+		m_watched = INVALID_SOCKET;
+	}
+	m_framer.Reset();
+	// nothing to reconnect: no thread that could outlive a Player its owner destroys right after
+	if (!m_reconnect)
+	{
+		Delete(errCode);
+		return;
+	}
+	// reconnecting sleeps between attempts, so it runs off the loop and hands the new transport back
+	std::unique_lock<std::mutex> lock(m_sendMutex);
+	if (m_deleted) return;
+	if (m_recvThread.joinable()) m_recvThread.join();
+	m_recvThread = std::thread([this, errCode]() {
+		// the new transport may need a different reader than the old one
+		if (OnConnectionLost(errCode) && !AttachReader())
+			RecvJob();
+	});
 }
 void Player::OnRecv(NetPack&& pack)
 {
-	NetPackHandler::AddTask(std::move(pack));
+	if (m_reconnect)
+		m_reconnect->OnInbound(pack);
+	m_handler.AddTask(std::move(pack), &m_tracker, m_transport->SessionId());
+}
+bool Player::OnConnectionLost(int errCode)
+{
+	if (m_deleted) return false;
+	if (m_reconnect && m_reconnect->Reconnect(*this))
+		return true;
+	Delete(errCode);
+	return false;
 }
 void Player::Send(NetPack& pack)
 {
 	if (Expired()) return;
-	auto iSendResult = send(m_socket, pack.GetContent(), (int)pack.Length(), 0);
-	if (iSendResult == SOCKET_ERROR)
-		Delete(iSendResult * 100);
+	Dispatch(pack, m_tracker.Begin(pack.MsgType(), nullptr, RequestTracker::kDefaultTimeoutMs, RequestTracker::ReplyRoom(pack)));
 }
 void Player::Send(RpcEnum msgType, std::function<void(NetPack&)> func)
 {
@@ -41,12 +131,81 @@ void Player::Send(RpcEnum msgType, std::function<void(NetPack&)> func)
 	func(pack);
 	Send(pack);
 }
+bool Player::Request(RpcEnum msgType, std::function<void(NetPack&)> func, RequestTracker::Callback callback, int timeoutMs)
+{
+	if (Expired()) return false;
+	NetPack pack(msgType);
+	func(pack);
+	if (!RequestCoalescer::Coalesces(msgType))
+	{
+		uint32_t requestId = m_tracker.Begin(msgType, std::move(callback), timeoutMs, RequestTracker::ReplyRoom(pack));
+		if (requestId == 0) return false;
+		return Dispatch(pack, requestId);
+	}
+
+	std::string key = RequestCoalescer::KeyOf(pack);
+	if (m_coalescer.Join(msgType, key, callback))
+		return true;
+	// this one goes out for everybody who joins it meanwhile
+	uint32_t requestId = m_tracker.Begin(msgType, [this, key](RequestTracker::Status status, NetPack* reply) {
+		m_coalescer.Complete(key, status, reply);
+	}, timeoutMs, RequestTracker::ReplyRoom(pack));
+	if (requestId != 0 && Dispatch(pack, requestId))
+		return true;
+	m_coalescer.Abandon(key);
+	return false;
+}
+bool Player::Dispatch(NetPack& pack, uint32_t requestId)
+{
+	if (RequestTracker::UseWireIds())
+		pack.AttachRequestId(requestId);
+	uint64_t seq = 0;
+	// while reconnecting the pack stays in the journal and goes out with the replay
+	if (m_reconnect && !m_reconnect->OnOutbound(pack, requestId, seq))
+		return true;
+	bool sent = Transmit(pack);
+	if (m_reconnect)
+	{
+		m_reconnect->OnSendResult(seq, sent);
+		// wake the recv thread so it notices the broken link and reconnects
+		if (!sent)
+		{
+			std::unique_lock<std::mutex> lock(m_sendMutex);
+			m_transport->Shutdown();
+		}
+	}
+	else if (!sent)
+	{
+		m_tracker.Cancel(requestId);
+		Delete(SOCKET_ERROR * 100);
+		return false;
+	}
+	return true;
+}
+bool Player::Transmit(NetPack& pack)
+{
+	std::unique_lock<std::mutex> lock(m_sendMutex);
+	return m_transport->Send(pack.GetContent(), pack.Length());
+}
+bool Player::ResetTransport(std::unique_ptr<Transport> transport)
+{
+	std::unique_lock<std::mutex> lock(m_sendMutex);
+	if (m_deleted)
+		return false;
+	// only the recv thread calls this, so nobody is blocked in the old transport
+	m_transport = std::move(transport);
+	return true;
+}
 void Player::Delete(int errCode)
 {
-	if (m_deleted) return;
-	m_deleted = true;
+	if (m_deleted.exchange(true)) return;
 	Console::Out() << "delete player(err " << errCode << ")" << std::endl;
-	if (m_recvThread.joinable()) m_recvThread.detach();
-	shutdown(m_socket, SD_SEND);
-	closesocket(m_socket);
+	{
+		std::unique_lock<std::mutex> lock(m_sendMutex);
+		if (m_recvThread.joinable()) m_recvThread.detach();
+	}
+	// the detached recv thread may still be inside Recv, the transport itself lives until ~Player.
+	// Outside the lock: a push transport waits for its delivery in progress, which may be
+	// StartRecovery waiting for m_sendMutex. ResetTransport sees m_deleted, so m_transport stays put.
+	m_transport->Shutdown();
 }
@@ -1,24 +1,64 @@
 #pragma once
+#include "Net/NetPack.h"
+#include "Net/NetPackHandler.h"
 #include "Net/RpcEnum.h"
+#include "Net/RequestTracker.h"
+#include "Net/RequestCoalescer.h"
+#include <atomic>
 #include <functional>
+#include <memory>
 
-class NetPack;
+class EventLoop;
+class Transport;
+class ReconnectManager;
 class Player
 {
-	SOCKET m_socket;
+	// declared first so it goes last: a drain still running elsewhere is waited out in ~Player
+	NetPackHandler m_handler;
+	std::unique_ptr<Transport> m_transport;
 	std::thread m_recvThread;
-	bool m_deleted = false;
+	std::mutex m_sendMutex;
+	std::atomic<bool> m_deleted = false;
+	ReconnectManager* m_reconnect = nullptr;
+	RequestTracker m_tracker;
+	RequestCoalescer m_coalescer;
+	// reactor mode: the loop polls the transport, m_recvThread only runs reconnects.
+	// push mode (SessionMux sessions): the transport calls OnData, same as reactor mode otherwise
+	EventLoop* m_loop = nullptr;
+	NetPackFramer m_framer;
+	SOCKET m_watched = INVALID_SOCKET;
+	bool AttachReader();
 	void RecvJob();
+	void WatchTransport();
+	void OnReadable();
+	void OnData(const char* data, int length);
+	void StartRecovery(int errCode);
 	void OnRecv(NetPack&& pack);
+	bool OnConnectionLost(int errCode);
+	bool Dispatch(NetPack& pack, uint32_t requestId);
 public:
 	//static std::vector<std::shared_ptr<Player>> AllConnectedPlayers;
 	//static void InitPlayer(SOCKET&& socket);
 	Player() = delete;
-	Player(SOCKET&& socket);
-	~Player() { if (m_deleted) return; Delete(); }
+	// With a loop, a pollable transport is read on the loop thread instead of a recv thread
+	Player(std::unique_ptr<Transport> transport, ReconnectManager* reconnect = nullptr, EventLoop* loop = nullptr);
+	~Player();
 	void Send(NetPack& pack);
 	void Send(RpcEnum msgType, std::function<void(NetPack&)> func);
+	// Like Send, but the callback runs on the dispatch thread when the reply, an error or the timeout arrives.
+	// Returns false (and never calls back) if the rpc has no reply type or could not be sent.
+	// Coalesced rpcs (table info) share a request in flight, or a fresh reply which calls back right away.
+	bool Request(RpcEnum msgType, std::function<void(NetPack&)> func, RequestTracker::Callback callback,
+		int timeoutMs = RequestTracker::kDefaultTimeoutMs);
+	// Writes straight to the transport, bypassing the reconnect journal (used for replay)
+	bool Transmit(NetPack& pack);
+	// Swaps in a freshly connected transport, called by ReconnectManager
+	bool ResetTransport(std::unique_ptr<Transport> transport);
 	void Delete(int errCode = 0);
-	bool Expired() { return m_deleted || !m_recvThread.joinable(); }
+	bool Expired() { return m_deleted; }
+	ReconnectManager* GetReconnectManager() const { return m_reconnect; }
+	RequestTracker& Tracker() { return m_tracker; }
+	RequestCoalescer& Coalescer() { return m_coalescer; }
+	// Inbound queue of this connection, whoever drains it is the player's dispatch thread
+	NetPackHandler& Handler() { return m_handler; }
 };
-
@@ -0,0 +1,833 @@
+#include "pch.h"
+#include "LoopbackServer.h"
+#include "Game/HoldemPokerGame.h"
+#include "Net/SessionMux.h"
+#include "Net/TcpTransport.h"
+#include <algorithm>
+#include <cctype>
+
+#undef min
+#undef max
+
+namespace
+{
+	int64_t SystemNowMs()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+
+	Language ParseLanguage(std::string text, Language fallback)
+	{
+		for (auto& c : text) c = (char)std::toupper((unsigned char)c);
+		if (text == "EN" || text == "ENGLISH" || text == "0") return Language::English;
+		if (text == "CN" || text == "ZH" || text == "CHINESE" || text == "1") return Language::Chinese;
+		if (text == "IT" || text == "ITALIAN" || text == "2") return Language::Italian;
+		if (text == "JP" || text == "JA" || text == "JAPANESE" || text == "3") return Language::Japanese;
+		if (text == "FR" || text == "FRENCH" || text == "4") return Language::Franch;
+		if (text == "ES" || text == "SPANISH" || text == "5") return Language::Spanish;
+		return fallback;
+	}
+
+	constexpr int kBotIdBase = 900000;
+	bool IsBotId(int playerId) { return playerId >= kBotIdBase; }
+}
+
+LoopbackServer::LoopbackServer()
+{
+}
+
+LoopbackServer::~LoopbackServer()
+{
+	Stop();
+}
+
+bool LoopbackServer::Start(const Config& config)
+{
+	if (m_running)
+		return false;
+	m_config = config;
+	if (HoldemPokerGame::GetMaxSeats() <= 0)
+		HoldemPokerGame::SetMaxSeats(config.maxSeats);
+
+	m_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (m_listenSocket == INVALID_SOCKET)
+	{
+		Console::Err() << "loopback server: socket failed: " << WSAGetLastError() << std::endl;
+		return false;
+	}
+	int reuse = 1;
+	setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(config.port);
+	inet_pton(AF_INET, config.bindHost.c_str(), &addr.sin_addr);
+	if (bind(m_listenSocket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR
+		|| listen(m_listenSocket, SOMAXCONN) == SOCKET_ERROR)
+	{
+		Console::Err() << "loopback server: bind/listen on " << config.bindHost << ":" << config.port
+			<< " failed: " << WSAGetLastError() << std::endl;
+		closesocket(m_listenSocket);
+		m_listenSocket = INVALID_SOCKET;
+		return false;
+	}
+
+	socklen_t addrLen = sizeof(addr);
+	getsockname(m_listenSocket, (sockaddr*)&addr, &addrLen);
+	m_port = ntohs(addr.sin_port);
+
+	if (!config.shmName.empty() && !m_shmListener.Open(config.shmName))
+	{
+		closesocket(m_listenSocket);
+		m_listenSocket = INVALID_SOCKET;
+		return false;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_stateMutex);
+		StubRoom& hall = m_rooms[0];
+		hall.id = 0;
+		hall.type = Room::HALL;
+	}
+
+	m_running = true;
+	m_acceptThread = std::thread(&LoopbackServer::AcceptJob, this);
+	if (m_shmListener.IsOpen())
+		m_shmAcceptThread = std::thread(&LoopbackServer::ShmAcceptJob, this);
+	if (m_config.verbose)
+	{
+		Console::Out() << "loopback server listening on " << config.bindHost << ":" << m_port << std::endl;
+		if (m_shmListener.IsOpen())
+			Console::Out() << "loopback server listening on shm://" << config.shmName << std::endl;
+	}
+	return true;
+}
+
+void LoopbackServer::Stop()
+{
+	if (!m_running.exchange(false))
+		return;
+
+	// shutdown wakes a blocked accept on POSIX, closesocket does on Windows
+	shutdown(m_listenSocket, SD_BOTH);
+	closesocket(m_listenSocket);
+	m_listenSocket = INVALID_SOCKET;
+	if (m_acceptThread.joinable())
+		m_acceptThread.join();
+	m_shmListener.Close();
+	if (m_shmAcceptThread.joinable())
+		m_shmAcceptThread.join();
+
+	std::vector<std::shared_ptr<Connection>> connections;
+	{
+		std::unique_lock<std::mutex> lock(m_stateMutex);
+		connections.swap(m_connections);
+	}
+	for (auto& conn : connections)
+		if (conn->transport)
+			conn->transport->Shutdown();
+	for (auto& conn : connections)
+		if (conn->thread.joinable())
+			conn->thread.join();
+
+	std::unique_lock<std::mutex> lock(m_stateMutex);
+	m_rooms.clear();
+}
+
+void LoopbackServer::AcceptJob()
+{
+	while (m_running)
+	{
+		SOCKET client = accept(m_listenSocket, nullptr, nullptr);
+		if (client == INVALID_SOCKET)
+		{
+			if (!m_running)
+				break;
+			continue;
+		}
+		int noDelay = 1;
+		setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+		m_accepted++;
+		AddConnection(std::make_unique<TcpTransport>(client));
+	}
+}
+
+void LoopbackServer::ShmAcceptJob()
+{
+	while (m_running)
+	{
+		// the timeout only bounds how long Stop waits for us
+		auto transport = m_shmListener.Accept(200);
+		if (!transport)
+			continue;
+		m_accepted++;
+		m_shmAccepted++;
+		AddConnection(std::move(transport));
+	}
+}
+
+void LoopbackServer::AddConnection(std::unique_ptr<Transport> transport)
+{
+	auto conn = std::make_shared<Connection>();
+	conn->transport = std::move(transport);
+
+	std::vector<std::shared_ptr<Connection>> finished;
+	{
+		std::unique_lock<std::mutex> lock(m_stateMutex);
+		// reap connections whose thread is done so reconnect storms do not pile up
+		auto it = std::partition(m_connections.begin(), m_connections.end(),
+			[](const std::shared_ptr<Connection>& c) { return !c->closed; });
+		finished.assign(std::make_move_iterator(it), std::make_move_iterator(m_connections.end()));
+		m_connections.erase(it, m_connections.end());
+		m_connections.push_back(conn);
+	}
+	for (auto& done : finished)
+		if (done->thread.joinable())
+			done->thread.join();
+
+	conn->thread = std::thread(&LoopbackServer::ConnectionJob, this, conn);
+}
+
+void LoopbackServer::ConnectionJob(std::shared_ptr<Connection> conn)
+{
+	char buffer[NET_PACK_MAX_LEN];
+	NetPackFramer framer;
+	while (m_running)
+	{
+		int received = conn->transport->Recv(buffer, sizeof(buffer));
+		if (received <= 0)
+			break;
+		m_bytesIn += received;
+		bool ok = framer.Feed(buffer, (size_t)received, [this, &conn](NetPack&& pack) {
+			m_packsIn++;
+			std::unique_lock<std::mutex> lock(m_stateMutex);
+			Handle(*conn, pack);
+		});
+		if (!ok)
+			break;
+	}
+	OnDisconnect(*conn);
+	conn->transport->Shutdown();
+	conn->closed = true;
+}
+
+void LoopbackServer::OnDisconnect(Connection& conn)
+{
+	std::unique_lock<std::mutex> lock(m_stateMutex);
+	// the sessions it carried go down with it
+	for (auto& [id, session] : conn.sessions)
+	{
+		LeaveRooms(*session);
+		session->closed = true;
+	}
+	conn.sessions.clear();
+	LeaveRooms(conn);
+}
+
+void LoopbackServer::LeaveRooms(Connection& conn)
+{
+	for (auto& [id, room] : m_rooms)
+	{
+		auto it = std::find(room.members.begin(), room.members.end(), &conn);
+		if (it == room.members.end())
+			continue;
+		room.members.erase(it);
+		if (room.game && conn.playerId >= 0 && room.game->GetSeatByPlayerId(conn.playerId))
+		{
+			room.game->MarkPendingLeave(conn.playerId);
+			if (room.game->GetStage() == HoldemPokerGame::Stage::Waiting)
+				room.game->RemovePendingLeavers();
+			AdvanceTable(room);
+		}
+	}
+}
+
+bool LoopbackServer::SendTo(Connection& conn, NetPack& pack, uint32_t requestId)
+{
+	if (conn.closed)
+		return false;
+	pack.AttachRequestId(requestId);
+	if (conn.link)
+	{
+		std::unique_lock<std::mutex> lock(conn.link->sendMutex);
+		if (!SessionMux::SendData(*conn.link->transport, conn.muxSession, pack.GetContent(), pack.Length()))
+			return false;
+	}
+	else
+	{
+		std::unique_lock<std::mutex> lock(conn.sendMutex);
+		if (!conn.transport->Send(pack.GetContent(), pack.Length()))
+			return false;
+	}
+	m_packsOut++;
+	m_bytesOut += pack.Length();
+	return true;
+}
+
+void LoopbackServer::SendError(Connection& conn, RpcError error, uint32_t requestId)
+{
+	// Format: errCode:u16
+	NetPack reply(RpcEnum::rpc_client_error_respond);
+	reply.WriteUInt16(error);
+	SendTo(conn, reply, requestId);
+}
+
+void LoopbackServer::WritePlayerInfo(NetPack& pack, const Connection& conn) const
+{
+	// PlayerInfo::WriteInfo format: id:u32, name:string, lang:u8, chips:i32
+	pack.WriteUInt32((uint32_t)conn.playerId);
+	pack.WriteString(conn.name);
+	pack.WriteUInt8(conn.language);
+	pack.WriteInt32(conn.wallet);
+}
+
+LoopbackServer::StubRoom* LoopbackServer::FindRoom(int roomId)
+{
+	auto it = m_rooms.find(roomId);
+	return it == m_rooms.end() ? nullptr : &it->second;
+}
+
+LoopbackServer::StubRoom* LoopbackServer::FindPokerRoom(Connection& conn, int roomId, uint32_t requestId)
+{
+	StubRoom* room = FindRoom(roomId);
+	if (!room)
+	{
+		SendError(conn, RpcError::ROOM_NOT_EXIST, requestId);
+		return nullptr;
+	}
+	if (!room->game)
+	{
+		SendError(conn, RpcError::ROOM_TYPE_ERROR, requestId);
+		return nullptr;
+	}
+	return room;
+}
+
+bool LoopbackServer::IsMember(const StubRoom& room, const Connection& conn) const
+{
+	return std::find(room.members.begin(), room.members.end(), &conn) != room.members.end();
+}
+
+void LoopbackServer::Handle(Connection& conn, NetPack& pack)
+{
+	const uint32_t requestId = pack.RequestId();
+	switch (pack.MsgType())
+	{
+	case RpcEnum::rpc_server_ping:
+	{
+		// Format: clientSendMs:i64 -> upLatencyMs:i64, serverSendMs:i64
+		const int64_t clientSendMs = pack.ReadInt64();
+		const int64_t nowMs = SystemNowMs();
+		NetPack reply(RpcEnum::rpc_client_ping);
+		reply.WriteInt64(nowMs - clientSendMs);
+		reply.WriteInt64(nowMs);
+		SendTo(conn, reply, requestId);
+		return;
+	}
+	case RpcEnum::rpc_server_tick:
+	case RpcEnum::rpc_connect:
+	case RpcEnum::rpc_debug:
+		return;
+	case RpcEnum::rpc_server_log_in:
+	case RpcEnum::rpc_server_register:
+		HandleLogin(conn, pack, requestId);
+		return;
+	case RpcEnum::rpc_mux_open:
+	case RpcEnum::rpc_mux_data:
+	case RpcEnum::rpc_mux_close:
+		HandleMux(conn, pack);
+		return;
+	default:
+		break;
+	}
+
+	if (conn.playerId < 0)
+	{
+		SendError(conn, RpcError::NOT_LOGGED_IN, requestId);
+		return;
+	}
+
+	switch (pack.MsgType())
+	{
+	case RpcEnum::rpc_server_set_name:
+		conn.name = pack.ReadString();
+		m_accounts[conn.playerId] = conn.name;
+		return;
+	case RpcEnum::rpc_server_set_language:
+		conn.language = ParseLanguage(pack.ReadString(), conn.language);
+		return;
+	case RpcEnum::rpc_server_print_user:
+	{
+		// Format: count:u32, [PlayerInfo]...
+		std::vector<Connection*> users;
+		for (auto& other : m_connections)
+			if (!other->closed && other->playerId >= 0)
+				users.push_back(other.get());
+		NetPack reply(RpcEnum::rpc_client_print_user);
+		reply.WriteUInt32((uint32_t)users.size());
+		for (Connection* user : users)
+			WritePlayerInfo(reply, *user);
+		SendTo(conn, reply, requestId);
+		return;
+	}
+	case RpcEnum::rpc_server_send_text:
+	{
+		// Format: roomId:i32, msg:string -> to every member: PlayerInfo, msg:string, includeName:i8
+		int roomId = pack.ReadInt32();
+		std::string msg = pack.ReadString();
+		StubRoom* room = FindRoom(roomId);
+		if (!room || !IsMember(*room, conn))
+		{
+			SendError(conn, RpcError::ROOM_NOT_EXIST, requestId);
+			return;
+		}
+		for (Connection* member : room->members)
+		{
+			NetPack text(RpcEnum::rpc_client_send_text);
+			WritePlayerInfo(text, conn);
+			text.WriteString(msg);
+			text.WriteInt8(1);
+			SendTo(*member, text);
+		}
+		return;
+	}
+	case RpcEnum::rpc_server_print_room:
+	case RpcEnum::rpc_server_goto_room:
+	case RpcEnum::rpc_server_leave_room:
+	case RpcEnum::rpc_server_get_my_rooms:
+	case RpcEnum::rpc_server_create_room:
+		HandleRoomRpc(conn, pack, requestId);
+		return;
+	case RpcEnum::rpc_server_get_poker_table_info:
+	case RpcEnum::rpc_server_sit_down:
+	case RpcEnum::rpc_server_poker_action:
+	case RpcEnum::rpc_server_poker_buyin:
+	case RpcEnum::rpc_server_poker_standup:
+	case RpcEnum::rpc_server_poker_set_blinds:
+	case RpcEnum::rpc_server_poker_add_bot:
+	case RpcEnum::rpc_server_poker_kick_bot:
+		HandlePokerRpc(conn, pack, requestId);
+		return;
+	default:
+		SendError(conn, RpcError::UNKNOWN_RPC_ERROR, requestId);
+		return;
+	}
+}
+
+void LoopbackServer::HandleMux(Connection& conn, NetPack& pack)
+{
+	// sessions do not nest
+	if (conn.link)
+	{
+		SendError(conn, RpcError::UNKNOWN_RPC_ERROR, 0);
+		return;
+	}
+	const uint16_t id = SessionMux::ReadSession(pack);
+	auto it = conn.sessions.find(id);
+	switch (pack.MsgType())
+	{
+	case RpcEnum::rpc_mux_open:
+	{
+		if (id == 0 || it != conn.sessions.end())
+			return;
+		auto session = std::make_shared<Connection>();
+		session->link = &conn;
+		session->muxSession = id;
+		conn.sessions[id] = session;
+		m_connections.push_back(session);
+		m_muxOpened++;
+		return;
+	}
+	case RpcEnum::rpc_mux_data:
+	{
+		if (it == conn.sessions.end())
+			return;
+		size_t length = 0;
+		const char* data = SessionMux::Payload(pack, length);
+		Connection& session = *it->second;
+		bool ok = session.muxFramer.Feed(data, length, [this, &session](NetPack&& inner) {
+			m_packsIn++;
+			Handle(session, inner);
+		});
+		if (!ok)
+			CloseMuxSession(conn, id, true);
+		return;
+	}
+	case RpcEnum::rpc_mux_close:
+		if (it != conn.sessions.end())
+			CloseMuxSession(conn, id, false);
+		return;
+	default:
+		return;
+	}
+}
+
+void LoopbackServer::CloseMuxSession(Connection& conn, uint16_t session, bool notifyPeer)
+{
+	auto it = conn.sessions.find(session);
+	if (it == conn.sessions.end())
+		return;
+	// reaped from m_connections by AddConnection like any closed connection
+	std::shared_ptr<Connection> closing = it->second;
+	conn.sessions.erase(it);
+	LeaveRooms(*closing);
+	closing->closed = true;
+	if (notifyPeer)
+	{
+		std::unique_lock<std::mutex> lock(conn.sendMutex);
+		SessionMux::SendControl(*conn.transport, RpcEnum::rpc_mux_close, session);
+	}
+}
+
+void LoopbackServer::HandleLogin(Connection& conn, NetPack& pack, uint32_t requestId)
+{
+	int playerId = -1;
+	std::string name;
+	if (pack.MsgType() == RpcEnum::rpc_server_log_in)
+	{
+		// Format: id:u32, password:string (any password is accepted)
+		playerId = (int)pack.ReadUInt32();
+		auto it = m_accounts.find(playerId);
+		name = it != m_accounts.end() ? it->second : "player" + std::to_string(playerId);
+	}
+	else
+	{
+		// Format: name:string, password:string
+		name = pack.ReadString();
+		playerId = m_nextPlayerId++;
+	}
+	if (playerId < 0 || IsBotId(playerId))
+	{
+		SendError(conn, RpcError::WRONG_PASSWORD, requestId);
+		return;
+	}
+
+	// a reconnecting client logs in again on a new socket, the stale one just loses the id
+	for (auto& other : m_connections)
+		if (other.get() != &conn && other->playerId == playerId)
+			other->playerId = -1;
+
+	m_accounts[playerId] = name;
+	conn.playerId = playerId;
+	conn.name = name;
+	if (conn.wallet == 0)
+		conn.wallet = m_config.startingWallet;
+
+	// Format: PlayerInfo
+	NetPack reply(RpcEnum::rpc_client_log_in);
+	WritePlayerInfo(reply, conn);
+	SendTo(conn, reply, requestId);
+}
+
+void LoopbackServer::HandleRoomRpc(Connection& conn, NetPack& pack, uint32_t requestId)
+{
+	switch (pack.MsgType())
+	{
+	case RpcEnum::rpc_server_print_room:
+	{
+		// Format: count:u32, [roomId:i32, roomType:u16, userCnt:u32, [PlayerInfo]...]...
+		NetPack reply(RpcEnum::rpc_client_print_room);
+		reply.WriteUInt32((uint32_t)m_rooms.size());
+		for (auto& [id, room] : m_rooms)
+		{
+			reply.WriteInt32(id);
+			reply.WriteUInt16(room.type);
+			reply.WriteUInt32((uint32_t)room.members.size());
+			for (Connection* member : room.members)
+				WritePlayerInfo(reply, *member);
+		}
+		SendTo(conn, reply, requestId);
+		return;
+	}
+	case RpcEnum::rpc_server_goto_room:
+	{
+		int roomId = pack.ReadInt32();
+		StubRoom* room = FindRoom(roomId);
+		if (!room)
+		{
+			SendError(conn, RpcError::ROOM_NOT_EXIST, requestId);
+			return;
+		}
+		if (!IsMember(*room, conn))
+			room->members.push_back(&conn);
+		NetPack reply(RpcEnum::rpc_client_goto_room);
+		reply.WriteInt32(roomId);
+		SendTo(conn, reply, requestId);
+		return;
+	}
+	case RpcEnum::rpc_server_leave_room:
+	{
+		int roomId = pack.ReadInt32();
+		StubRoom* room = FindRoom(roomId);
+		if (!room || !IsMember(*room, conn))
+		{
+			SendError(conn, RpcError::ROOM_NOT_EXIST, requestId);
+			return;
+		}
+		room->members.erase(std::find(room->members.begin(), room->members.end(), &conn));
+		if (room->game && room->game->GetSeatByPlayerId(conn.playerId))
+		{
+			room->game->MarkPendingLeave(conn.playerId);
+			if (room->game->GetStage() == HoldemPokerGame::Stage::Waiting)
+				room->game->RemovePendingLeavers();
+			AdvanceTable(*room);
+		}
+		NetPack reply(RpcEnum::rpc_client_leave_room);
+		reply.WriteInt32(roomId);
+		SendTo(conn, reply, requestId);
+		return;
+	}
+	case RpcEnum::rpc_server_get_my_rooms:
+	{
+		// Format: count:u32, [roomId:i32, roomType:u16]...
+		std::vector<const StubRoom*> mine;
+		for (auto& [id, room] : m_rooms)
+			if (IsMember(room, conn))
+				mine.push_back(&room);
+		NetPack reply(RpcEnum::rpc_client_get_my_rooms);
+		reply.WriteUInt32((uint32_t)mine.size());
+		for (const StubRoom* room : mine)
+		{
+			reply.WriteInt32(room->id);
+			reply.WriteUInt16(room->type);
+		}
+		SendTo(conn, reply, requestId);
+		return;
+	}
+	case RpcEnum::rpc_server_create_room:
+	{
+		uint16_t type = pack.ReadUInt16();
+		if (type != Room::CHAT_ROOM && type != Room::POKER_ROOM)
+		{
+			SendError(conn, RpcError::ROOM_TYPE_ERROR, requestId);
+			return;
+		}
+		int roomId = m_nextRoomId++;
+		StubRoom& room = m_rooms[roomId];
+		room.id = roomId;
+		room.type = (Room::RoomType)type;
+		if (room.type == Room::POKER_ROOM)
+			room.game = std::make_unique<HoldemPokerGame>();
+		NetPack reply(RpcEnum::rpc_client_create_room);
+		reply.WriteInt32(roomId);
+		SendTo(conn, reply, requestId);
+		return;
+	}
+	default:
+		return;
+	}
+}
+
+void LoopbackServer::HandlePokerRpc(Connection& conn, NetPack& pack, uint32_t requestId)
+{
+	const int roomId = pack.ReadInt32();
+	StubRoom* room = FindPokerRoom(conn, roomId, requestId);
+	if (!room)
+		return;
+	HoldemPokerGame& game = *room->game;
+
+	switch (pack.MsgType())
+	{
+	case RpcEnum::rpc_server_get_poker_table_info:
+	{
+		NetPack reply(RpcEnum::rpc_client_get_poker_table_info);
+		reply.WriteInt32(roomId);
+		game.WriteTable(reply, conn.playerId);
+		SendTo(conn, reply, requestId);
+		return;
+	}
+	case RpcEnum::rpc_server_sit_down:
+	{
+		if (!game.AreBlindsSet())
+		{
+			SendError(conn, RpcError::POKER_BLINDS_NOT_SET, requestId);
+			return;
+		}
+		int seatIdx = -1;
+		if (!game.SitDown(conn.playerId, -1, seatIdx))
+		{
+			SendError(conn, game.GetSeatByPlayerId(conn.playerId) ? RpcError::PLAYER_STATE_ERROR : RpcError::POKER_TABLE_FULL, requestId);
+			return;
+		}
+		if (!IsMember(*room, conn))
+			room->members.push_back(&conn);
+		// Format: seatIdx:i32, chips:i32, minBuyin:i32, bigBlind:i32, walletBalance:i32
+		NetPack reply(RpcEnum::rpc_client_sit_down);
+		reply.WriteInt32(seatIdx);
+		reply.WriteInt32(game.GetPlayerChips(conn.playerId));
+		reply.WriteInt32(game.GetMinBuyin());
+		reply.WriteInt32(game.GetBigBlind());
+		reply.WriteInt32(conn.wallet);
+		SendTo(conn, reply, requestId);
+		PushTable(*room);
+		return;
+	}
+	case RpcEnum::rpc_server_poker_buyin:
+	{
+		int amount = pack.ReadInt32();
+		auto result = HoldemPokerGame::BuyInResult::BelowMinimum;
+		if (amount <= conn.wallet)
+			result = game.BuyIn(conn.playerId, amount);
+		if (result == HoldemPokerGame::BuyInResult::Success)
+			conn.wallet -= amount;
+		// Format: result:u8, tableChips:i32, walletChips:i32
+		NetPack reply(RpcEnum::rpc_client_poker_buyin);
+		reply.WriteUInt8(static_cast<uint8_t>(result));
+		reply.WriteInt32(game.GetPlayerChips(conn.playerId));
+		reply.WriteInt32(conn.wallet);
+		SendTo(conn, reply, requestId);
+		if (result == HoldemPokerGame::BuyInResult::Success)
+			AdvanceTable(*room);
+		return;
+	}
+	case RpcEnum::rpc_server_poker_standup:
+	{
+		bool success = game.StandUp(conn.playerId);
+		if (success && game.GetStage() == HoldemPokerGame::Stage::Waiting)
+			conn.wallet += game.CashOut(conn.playerId);
+		NetPack reply(RpcEnum::rpc_client_poker_standup);
+		reply.WriteUInt8(success ? 1 : 0);
+		SendTo(conn, reply, requestId);
+		AdvanceTable(*room);
+		return;
+	}
+	case RpcEnum::rpc_server_poker_set_blinds:
+	{
+		int smallBlind = pack.ReadInt32();
+		int bigBlind = pack.ReadInt32();
+		auto result = game.SetBlinds(smallBlind, bigBlind);
+		// Format: result:u8, smallBlind:i32, bigBlind:i32, minBuyin:i32
+		NetPack reply(RpcEnum::rpc_client_poker_set_blinds);
+		reply.WriteUInt8(static_cast<uint8_t>(result));
+		reply.WriteInt32(game.GetSmallBlind());
+		reply.WriteInt32(game.GetBigBlind());
+		reply.WriteInt32(game.GetMinBuyin());
+		SendTo(conn, reply, requestId);
+		return;
+	}
+	case RpcEnum::rpc_server_poker_action:
+	{
+		// Format: action:u8, amount:i32
+		auto action = static_cast<HoldemPokerGame::Action>(pack.ReadUInt8());
+		int amount = pack.ReadInt32();
+		if (game.HandleAction(conn.playerId, action, amount) == HoldemPokerGame::ActionResult::Invalid)
+		{
+			SendError(conn, RpcError::POKER_INVALID_ACTION, requestId);
+			return;
+		}
+		AdvanceTable(*room);
+		return;
+	}
+	case RpcEnum::rpc_server_poker_add_bot:
+	{
+		int botId = m_nextBotId++;
+		int seatIdx = -1;
+		if (!game.AreBlindsSet() || !game.SitDown(botId, -1, seatIdx))
+		{
+			SendError(conn, game.AreBlindsSet() ? RpcError::POKER_TABLE_FULL : RpcError::POKER_BLINDS_NOT_SET, requestId);
+			return;
+		}
+		game.BuyIn(botId, game.GetMinBuyin());
+		// bots check when they can and fold otherwise
+		game.GetSeatByPlayerId(botId)->autoMode = true;
+		room->botIds.push_back(botId);
+		AdvanceTable(*room);
+		return;
+	}
+	case RpcEnum::rpc_server_poker_kick_bot:
+	{
+		int seatIdx = pack.ReadInt32();
+		const Seat* seat = game.GetSeatByIndex(seatIdx);
+		if (!seat || !IsBotId(seat->playerId))
+		{
+			SendError(conn, RpcError::PLAYER_STATE_ERROR, requestId);
+			return;
+		}
+		int botId = seat->playerId;
+		game.MarkPendingLeave(botId);
+		if (game.GetStage() == HoldemPokerGame::Stage::Waiting)
+			game.RemovePendingLeavers();
+		room->botIds.erase(std::remove(room->botIds.begin(), room->botIds.end(), botId), room->botIds.end());
+		AdvanceTable(*room);
+		return;
+	}
+	default:
+		return;
+	}
+}
+
+void LoopbackServer::AdvanceTable(StubRoom& room)
+{
+	if (!room.game)
+		return;
+	HoldemPokerGame& game = *room.game;
+	bool startedHand = false;
+	// bounded: an all-bot table would otherwise play hands forever
+	for (int guard = 0; guard < 256; guard++)
+	{
+		if (game.HasPendingHandResult())
+		{
+			for (Connection* member : room.members)
+			{
+				// Format: roomId:i32, then HandResult::Write format
+				NetPack result(RpcEnum::rpc_client_poker_hand_result);
+				result.WriteInt32(room.id);
+				game.GetLastHandResult().Write(result);
+				SendTo(*member, result);
+			}
+			game.ClearPendingHandResult();
+		}
+
+		if (game.GetStage() == HoldemPokerGame::Stage::Waiting)
+		{
+			game.RemovePendingLeavers();
+			bool humanSeated = false;
+			for (const Seat& seat : game.GetSeats())
+				if (seat.IsOccupied() && !seat.autoMode && !IsBotId(seat.playerId))
+					humanSeated = true;
+			// one hand per event, the next starts on the following action
+			if (startedHand || !humanSeated || !game.CanStart())
+				break;
+			game.StartHand();
+			startedHand = true;
+			continue;
+		}
+
+		const Seat* acting = game.GetSeatByPlayerId(game.ActingPlayerId());
+		if (!acting || !(acting->autoMode || acting->pendingLeave))
+			break;
+		game.ProcessAutoModePlayer();
+	}
+	PushTable(room);
+}
+
+void LoopbackServer::PushTable(StubRoom& room)
+{
+	if (!room.game)
+		return;
+	for (Connection* member : room.members)
+	{
+		NetPack table(RpcEnum::rpc_client_get_poker_table_info);
+		table.WriteInt32(room.id);
+		room.game->WriteTable(table, member->playerId);
+		SendTo(*member, table);
+	}
+}
+
+void LoopbackServer::PrintStats()
+{
+	size_t connections = 0;
+	size_t rooms = 0;
+	{
+		std::unique_lock<std::mutex> lock(m_stateMutex);
+		for (auto& conn : m_connections)
+			if (!conn->closed) connections++;
+		rooms = m_rooms.size();
+	}
+	Console::Out() << "[LOOPBACK SERVER] port " << m_port
+		<< ", connections " << connections << " (accepted " << m_accepted << ", shm " << m_shmAccepted << ", mux sessions " << m_muxOpened << ")"
+		<< ", rooms " << rooms
+		<< ", packs in/out " << m_packsIn << "/" << m_packsOut
+		<< ", bytes in/out " << m_bytesIn << "/" << m_bytesOut << std::endl;
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Net/NetPack.h"
+#include "Net/RpcEnum.h"
+#include "Net/RpcError.h"
+#include "Net/ShmTransport.h"
+#include "Player/PlayerInfo.h"
+#include "ServerClass/Room.h"
+#include "Utils/enum.h"
+
+class HoldemPokerGame;
+class Transport;
+
+// Minimal in-process server speaking the RpcEnum protocol over loopback TCP,
+// and over shared memory (ShmTransport) when Config::shmName is set.
+// Covers login, rooms, chat echo, ping and poker tables run by the real
+// HoldemPokerGame engine, so the whole client pipeline can be exercised and
+// benchmarked on one machine. No database: accounts live as long as the server.
+// Request ids (NET_PACK_REQUEST_ID_FLAG) are echoed on replies, pushes stay untagged.
+// A connection may carry SessionMux sessions, each one is a Connection of its own here.
+class LoopbackServer
+{
+public:
+	struct Config
+	{
+		std::string bindHost = "127.0.0.1";
+		uint16_t port = 0;             // 0 picks a free port, see Port()
+		std::string shmName;           // also accept shm://<shmName> clients
+		int maxSeats = 6;
+		int startingWallet = 100000;
+		bool verbose = false;
+	};
+
+	LoopbackServer();
+	~LoopbackServer();
+	LoopbackServer(const LoopbackServer&) = delete;
+	LoopbackServer& operator=(const LoopbackServer&) = delete;
+
+	bool Start(const Config& config);
+	void Stop();
+	bool Running() const { return m_running; }
+	uint16_t Port() const { return m_port; }
+	void PrintStats();
+
+private:
+	struct Connection
+	{
+		std::unique_ptr<Transport> transport;    // null for a mux session, it writes through link
+		std::thread thread;
+		std::mutex sendMutex;
+		std::atomic<bool> closed = false;
+		// below guarded by m_stateMutex
+		int playerId = -1;
+		std::string name;
+		Language language = Language::English;
+		int wallet = 0;
+		// mux sessions: the physical connection and our id on it
+		Connection* link = nullptr;
+		uint16_t muxSession = 0;
+		NetPackFramer muxFramer;
+		// physical connections: the sessions they carry
+		std::map<uint16_t, std::shared_ptr<Connection>> sessions;
+	};
+
+	struct StubRoom
+	{
+		int id = 0;
+		Room::RoomType type = Room::HALL;
+		std::vector<Connection*> members;
+		std::unique_ptr<HoldemPokerGame> game;   // poker rooms only
+		std::vector<int> botIds;
+	};
+
+	void AcceptJob();
+	void ShmAcceptJob();
+	void AddConnection(std::unique_ptr<Transport> transport);
+	void ConnectionJob(std::shared_ptr<Connection> conn);
+	void OnDisconnect(Connection& conn);
+	void LeaveRooms(Connection& conn);
+
+	// rpc_mux_open/data/close on a physical connection
+	void HandleMux(Connection& conn, NetPack& pack);
+	void CloseMuxSession(Connection& conn, uint16_t session, bool notifyPeer);
+	// all handlers run under m_stateMutex
+	void Handle(Connection& conn, NetPack& pack);
+	void HandleLogin(Connection& conn, NetPack& pack, uint32_t requestId);
+	void HandleRoomRpc(Connection& conn, NetPack& pack, uint32_t requestId);
+	void HandlePokerRpc(Connection& conn, NetPack& pack, uint32_t requestId);
+	// hands auto-start and bots act until a human has to move
+	void AdvanceTable(StubRoom& room);
+	void PushTable(StubRoom& room);
+
+	StubRoom* FindRoom(int roomId);
+	StubRoom* FindPokerRoom(Connection& conn, int roomId, uint32_t requestId);
+	bool IsMember(const StubRoom& room, const Connection& conn) const;
+	void WritePlayerInfo(NetPack& pack, const Connection& conn) const;
+
+	bool SendTo(Connection& conn, NetPack& pack, uint32_t requestId = 0);
+	void SendError(Connection& conn, RpcError error, uint32_t requestId);
+
+	Config m_config;
+	std::atomic<bool> m_running = false;
+	SOCKET m_listenSocket = INVALID_SOCKET;
+	uint16_t m_port = 0;
+	std::thread m_acceptThread;
+	ShmListener m_shmListener;
+	std::thread m_shmAcceptThread;
+
+	std::mutex m_stateMutex;
+	std::vector<std::shared_ptr<Connection>> m_connections;
+	std::map<int, StubRoom> m_rooms;
+	std::map<int, std::string> m_accounts;     // id -> name
+	int m_nextRoomId = 1;
+	int m_nextPlayerId = 1000;
+	int m_nextBotId = 900000;
+
+	std::atomic<uint64_t> m_packsIn = 0;
+	std::atomic<uint64_t> m_packsOut = 0;
+	std::atomic<uint64_t> m_bytesIn = 0;
+	std::atomic<uint64_t> m_bytesOut = 0;
+	std::atomic<uint64_t> m_accepted = 0;
+	std::atomic<uint64_t> m_shmAccepted = 0;
+	std::atomic<uint64_t> m_muxOpened = 0;
+};
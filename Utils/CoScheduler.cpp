@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "CoScheduler.h"
+
+#undef min
+#undef max
+
+namespace
+{
+	// Owns a spawned Task: starts suspended, frees its own frame when the flow ends
+	struct DetachedFlow
+	{
+		struct promise_type
+		{
+			DetachedFlow get_return_object() { return DetachedFlow{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			std::suspend_never final_suspend() const noexcept { return {}; }
+			void return_void() const noexcept {}
+			void unhandled_exception() const noexcept {}
+		};
+		std::coroutine_handle<promise_type> handle;
+	};
+}
+
+CoScheduler& CoScheduler::Inst()
+{
+	static CoScheduler inst;
+	return inst;
+}
+
+void CoScheduler::Spawn(Task<void> task)
+{
+	auto run = [](Task<void> flow, CoScheduler* scheduler) -> DetachedFlow {
+		try
+		{
+			co_await flow;
+			scheduler->m_finished++;
+		}
+		catch (const std::exception& e)
+		{
+			scheduler->m_failed++;
+			Console::Err() << "coroutine flow failed: " << e.what() << std::endl;
+		}
+		scheduler->m_activeFlows--;
+	};
+	DetachedFlow detached = run(std::move(task), this);
+	m_activeFlows++;
+	m_spawned++;
+	Post(detached.handle);
+}
+
+void CoScheduler::Post(std::coroutine_handle<> handle)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_ready.push_back(handle);
+	}
+	if (m_wakeHook)
+		m_wakeHook();
+}
+
+void CoScheduler::AddTimer(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_timers.push(Timer{ deadline, m_timerSeq++, handle });
+}
+
+size_t CoScheduler::RunReady()
+{
+	size_t count = 0;
+	std::vector<std::coroutine_handle<>> batch;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			const auto now = std::chrono::steady_clock::now();
+			while (!m_timers.empty() && m_timers.top().deadline <= now)
+			{
+				m_ready.push_back(m_timers.top().handle);
+				m_timers.pop();
+			}
+			batch.swap(m_ready);
+		}
+		if (batch.empty())
+			break;
+		// flows resumed here may post more work, loop until quiet
+		for (auto handle : batch)
+			handle.resume();
+		count += batch.size();
+		batch.clear();
+	}
+	m_resumes += count;
+	return count;
+}
+
+std::chrono::milliseconds CoScheduler::NextWakeup(std::chrono::milliseconds maxWait)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (!m_ready.empty())
+		return std::chrono::milliseconds(0);
+	if (m_timers.empty())
+		return maxWait;
+	auto untilTimer = std::chrono::ceil<std::chrono::milliseconds>(m_timers.top().deadline - std::chrono::steady_clock::now());
+	return std::max(std::chrono::milliseconds(0), std::min(maxWait, untilTimer));
+}
+
+void CoScheduler::PrintStats()
+{
+	size_t timers = 0;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		timers = m_timers.size();
+	}
+	Console::Out() << "[COROUTINES] active: " << m_activeFlows
+		<< ", spawned: " << m_spawned
+		<< ", finished: " << m_finished
+		<< ", failed: " << m_failed
+		<< ", resumes: " << m_resumes
+		<< ", sleeping: " << timers << std::endl;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+#include "Utils/Task.h"
+
+// Runs coroutine flows on the dispatch thread. Nothing here owns a thread: the main
+// loop calls RunReady after draining NetPackHandler, so a suspended flow costs only
+// its frame and thousands of them can share one core.
+class CoScheduler
+{
+public:
+	static CoScheduler& Inst();
+
+	// Takes ownership of a top-level flow and starts it on the next RunReady
+	void Spawn(Task<void> task);
+	// Queues a handle to be resumed on the dispatch thread, callable from any thread
+	void Post(std::coroutine_handle<> handle);
+
+	// Dispatch thread only. Resumes everything ready and every expired timer, returns how many ran.
+	size_t RunReady();
+	// How long the dispatch loop may block before a timer is due, capped at maxWait
+	std::chrono::milliseconds NextWakeup(std::chrono::milliseconds maxWait);
+	// Called after Post from another thread so a blocked dispatch loop wakes up
+	void SetWakeHook(std::function<void()> hook) { m_wakeHook = std::move(hook); }
+
+	size_t ActiveFlows() const { return m_activeFlows; }
+	void PrintStats();
+
+	struct SleepAwaiter
+	{
+		CoScheduler* scheduler = nullptr;
+		std::chrono::steady_clock::time_point deadline{};
+		bool await_ready() const noexcept { return deadline <= std::chrono::steady_clock::now(); }
+		void await_suspend(std::coroutine_handle<> handle) { scheduler->AddTimer(deadline, handle); }
+		void await_resume() const noexcept {}
+	};
+	struct YieldAwaiter
+	{
+		CoScheduler* scheduler = nullptr;
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { scheduler->Post(handle); }
+		void await_resume() const noexcept {}
+	};
+
+	// co_await Sleep(ms) / co_await Yield() inside a flow
+	SleepAwaiter Sleep(std::chrono::milliseconds delay) { return SleepAwaiter{ this, std::chrono::steady_clock::now() + delay }; }
+	YieldAwaiter Yield() { return YieldAwaiter{ this }; }
+
+private:
+	CoScheduler() = default;
+
+	struct Timer
+	{
+		std::chrono::steady_clock::time_point deadline;
+		uint64_t seq;
+		std::coroutine_handle<> handle;
+		bool operator>(const Timer& other) const
+		{
+			return deadline != other.deadline ? deadline > other.deadline : seq > other.seq;
+		}
+	};
+
+	void AddTimer(std::chrono::steady_clock::time_point deadline, std::coroutine_handle<> handle);
+
+	std::mutex m_mutex;
+	std::vector<std::coroutine_handle<>> m_ready;
+	std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_timers;
+	uint64_t m_timerSeq = 0;
+	std::function<void()> m_wakeHook;
+
+	// Spawn may run on the input thread, flows finish on the dispatch thread
+	std::atomic<size_t> m_activeFlows = 0;
+	std::atomic<uint64_t> m_spawned = 0;
+	std::atomic<uint64_t> m_finished = 0;
+	std::atomic<uint64_t> m_failed = 0;
+	std::atomic<uint64_t> m_resumes = 0;
+};
@@ -6,14 +6,160 @@
 #include <sstream>
 
 #include "Helper/HelpString.h"
+#include "Helper/GameElementPrinter.h"
+#include "Helper/Benchmark.h"
+#include "Game/EquityCalculator.h"
+#include "Game/GameItem/HandEvaluator.h"
+#include "Game/GameItem/Rng.h"
 #include "Audio/AudioCenter.h"
+#include "Net/NetHealth.h"
+#include "Net/ClockSync.h"
+#include "Net/FaultInjectingTransport.h"
+#include "Net/ReconnectManager.h"
+#include "Net/RequestTracker.h"
+#include "Utils/CoScheduler.h"
+#include "Utils/EventLoop.h"
+#include "Utils/SessionFarm.h"
+
+namespace
+{
+	struct SnapshotBatch
+	{
+		int total = 0;
+		int done = 0;
+		int ok = 0;
+		std::chrono::steady_clock::time_point startedAt{};
+		std::optional<HoldemTableSnapshot> last;
+	};
+
+	// one of SNAPSHOT's concurrent flows, the last one to finish prints the summary
+	Task<void> SnapshotFlow(ClientSession& session, int room, std::shared_ptr<SnapshotBatch> batch)
+	{
+		auto table = co_await session.GetTableInfo(room);
+		batch->done++;
+		if (table)
+		{
+			batch->ok++;
+			batch->last = std::move(table);
+		}
+		if (batch->done < batch->total)
+			co_return;
+
+		const double elapsedMs = std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now() - batch->startedAt).count() / 1000.0;
+		Console::Out() << "[SNAPSHOT] room " << room << ": " << batch->ok << "/" << batch->total
+			<< " replies in " << std::format("{:.2f}", elapsedMs) << " ms" << std::endl;
+		if (!batch->last)
+			co_return;
+		int seated = 0;
+		for (const auto& seat : batch->last->seats)
+			if (seat.seat.IsOccupied()) seated++;
+		Console::Out() << "\tstage " << (int)batch->last->stage
+			<< ", pot " << batch->last->totalPot
+			<< ", seated " << seated << "/" << batch->last->seats.size()
+			<< ", acting player " << batch->last->actingPlayerId << std::endl;
+	}
+
+	// resumes the flow on the dispatch thread once the workers are through
+	struct EquityAwaiter
+	{
+		std::shared_ptr<EquityJob> job;
+		bool await_ready() const { return job->Done(); }
+		void await_suspend(std::coroutine_handle<> handle) { job->OnDone([handle]() { CoScheduler::Inst().Post(handle); }); }
+		EquityResult await_resume() { return job->Wait(); }
+	};
+
+	void PrintCards(CardSet cards)
+	{
+		if (cards.Empty())
+			Console::OutW() << L"-";
+		cards.ForEach([](const Card& card) { Console::OutW() << card.ToString(); });
+	}
+
+	void PrintEquity(const EquityRequest& request, const EquityResult& result)
+	{
+		Console::OutW() << L"[EQUITY] ";
+		PrintCards(request.hole);
+		Console::OutW() << L" vs " << request.opponents << L" opponent(s), board ";
+		PrintCards(request.board);
+		Console::OutW() << std::endl;
+		Console::Out() << '\t' << result.trials << " trials in " << std::format("{:.1f}", result.elapsedMs) << " ms"
+			<< (result.cancelled ? " (cancelled)" : "") << std::endl;
+		if (result.trials == 0)
+			return;
+		auto line = [&result](const char* name, double rate) {
+			Console::Out() << '\t' << name << std::format("{:6.2f}% +/- {:.2f}", rate * 100,
+				EquityResult::Margin95(rate, result.trials) * 100) << std::endl;
+		};
+		line("win    ", result.WinRate());
+		line("tie    ", result.TieRate());
+		line("lose   ", result.LossRate());
+		Console::Out() << '\t' << "equity " << std::format("{:6.2f}% +/- {:.2f}", result.Equity() * 100,
+			result.EquityMargin95() * 100) << " (95%)" << std::endl;
+	}
+
+	// EQUITY against the cached table: our seat is the one whose hole cards we can see
+	Task<void> EquityFlow(ClientSession& session, int room, EquityRequest request, bool countOpponents,
+		std::shared_ptr<std::shared_ptr<EquityJob>> current)
+	{
+		if (room >= 0)
+		{
+			auto table = co_await session.GetTableInfo(room);
+			if (!table)
+			{
+				Console::Out() << "[EQUITY] no table info for room " << room << std::endl;
+				co_return;
+			}
+			const Seat* self = nullptr;
+			int live = 0;
+			for (const auto& seatSnapshot : table->seats)
+			{
+				const Seat& seat = seatSnapshot.seat;
+				if (!seat.inHand || seat.folded)
+					continue;
+				live++;
+				if (!self && seat.HoleSet().Count() == 2)
+					self = &seat;
+			}
+			if (!self || table->stage == HoldemPokerGame::Stage::Showdown)
+			{
+				Console::Out() << "[EQUITY] not in a hand in room " << room << std::endl;
+				co_return;
+			}
+			request.hole = self->HoleSet();
+			request.board = CardSet{};
+			for (const Card& card : table->community)
+				request.board.Add(card);
+			if (countOpponents)
+				request.opponents = live - 1;
+		}
 
-CommandProcessor::CommandProcessor(Player& player)
-	: m_player(player)
+		const std::string error = EquityCalculator::Validate(request);
+		if (!error.empty())
+		{
+			Console::Out() << "[EQUITY] " << error << std::endl;
+			co_return;
+		}
+		auto job = EquityCalculator::Start(request);
+		*current = job;
+		EquityAwaiter finished{ job };
+		const EquityResult result = co_await finished;
+		if (*current == job)
+			current->reset();
+		PrintEquity(request, result);
+	}
+}
+
+CommandProcessor::CommandProcessor(Player& player, EventLoop* loop)
+	: m_player(player),
+	m_loop(loop),
+	m_session(player)
 {
 	RegisterCommands();
 }
 
+CommandProcessor::~CommandProcessor() = default;
+
 void CommandProcessor::Run()
 {
 	while (!m_player.Expired())
@@ -21,7 +167,11 @@ void CommandProcessor::Run()
 		std::string input;
 		if (!Console::ReadLine(input))
 			break;
-		HandleLine(input);
+		// commands run on the loop, in order with the packs they race against
+		if (m_loop)
+			m_loop->Post([this, input]() { HandleLine(input); });
+		else
+			HandleLine(input);
 	}
 }
 
@@ -94,17 +244,312 @@ void CommandProcessor::RegisterCommands()
 	} };
 
 	m_commands["MUTE"] = CommandSpec{ 1, true, false, [](const std::vector<std::string>&, int) {
-		AudioCenter::Inst().m_mute = true;
+		if (AudioCenter::IsEnabled())
+			AudioCenter::Inst().m_mute = true;
 	} };
 
 	m_commands["UNMUTE"] = CommandSpec{ 1, true, false, [](const std::vector<std::string>&, int) {
-		AudioCenter::Inst().m_mute = false;
+		if (AudioCenter::IsEnabled())
+			AudioCenter::Inst().m_mute = false;
 	} };
 
 	m_commands["PING"] = CommandSpec{ 1, true, false, [this](const std::vector<std::string>&, int) {
-		const auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-			std::chrono::system_clock::now().time_since_epoch()).count();
-		m_player.Send(RpcEnum::rpc_server_ping, [nowMs](NetPack& pack) { pack.WriteInt64(nowMs); });
+		NetHealth::Inst().SendPing(m_player, true);
+	} };
+
+	m_commands["NETHEALTH"] = CommandSpec{ 1, false, false, [](const std::vector<std::string>& tokens, int) {
+		if (tokens.size() < 2)
+		{
+			NetHealth::Inst().Print();
+			ClockSync::Inst().Print();
+			return;
+		}
+		if (tokens[1] == "RESET")
+		{
+			NetHealth::Inst().Reset();
+			ClockSync::Inst().Reset();
+			Console::Out() << "Network health stats reset" << std::endl;
+			return;
+		}
+		int intervalMs = 0;
+		try { intervalMs = std::stoi(tokens[1]); }
+		catch (const std::exception& e) { Console::Out() << e.what() << std::endl; return; }
+		NetHealth::Inst().SetInterval(intervalMs);
+		Console::Out() << "Ping probe interval set to " << intervalMs << " ms" << std::endl;
+	} };
+
+	m_commands["RPCSTAT"] = CommandSpec{ 1, false, false, [this](const std::vector<std::string>& tokens, int) {
+		if (tokens.size() >= 3 && tokens[1] == "REQID")
+		{
+			RequestTracker::SetUseWireIds(tokens[2] == "ON");
+			Console::Out() << "Request ids on the wire: " << (RequestTracker::UseWireIds() ? "on" : "off") << std::endl;
+			return;
+		}
+		if (tokens.size() >= 3 && tokens[1] == "COALESCE")
+		{
+			RequestCoalescer::SetEnabled(tokens[2] == "ON");
+			Console::Out() << "Coalescing identical requests: " << (RequestCoalescer::IsEnabled() ? "on" : "off") << std::endl;
+			return;
+		}
+		int value = 0;
+		if (tokens.size() >= 3 && tokens[1] == "REFRESH" && TryParseInt(tokens[2], value) && value >= 0)
+		{
+			RequestCoalescer::SetMinRefreshMs(value);
+			Console::Out() << "Table info replies reused for " << value << " ms" << std::endl;
+			return;
+		}
+		if (tokens.size() >= 2 && tokens[1] == "CHECK")
+		{
+			Console::Out() << "Untagged error with a ping and a BUYIN pending: "
+				<< (RequestTracker::SelfCheck() ? "fails the BUYIN" : "DOES NOT fail the BUYIN") << std::endl;
+			return;
+		}
+		if (tokens.size() >= 2)
+		{
+			Console::Out() << "Usage: RPCSTAT [REQID ON|OFF | COALESCE ON|OFF | REFRESH <ms> | CHECK]" << std::endl;
+			return;
+		}
+		m_player.Tracker().PrintStats();
+		m_player.Coalescer().PrintStats();
+		CoScheduler::Inst().PrintStats();
+	} };
+
+	m_commands["QUEUESTAT"] = CommandSpec{ 1, false, false, [this](const std::vector<std::string>& tokens, int) {
+		if (tokens.size() < 2)
+		{
+			m_player.Handler().PrintStats();
+			if (m_loop)
+				m_loop->PrintStats();
+			return;
+		}
+		if (tokens[1] == "RESET")
+		{
+			m_player.Handler().ResetStats();
+			Console::Out() << "Queue stats reset" << std::endl;
+			return;
+		}
+		int value = 0;
+		if (tokens[1] == "BURST" && tokens.size() >= 3)
+		{
+			try { value = std::stoi(tokens[2]); }
+			catch (const std::exception& e) { Console::Out() << e.what() << std::endl; return; }
+			m_player.Handler().SetMaxBurst(value);
+			Console::Out() << "Max burst set to " << value << std::endl;
+			return;
+		}
+		if ((tokens[1] == "PRIO" || tokens[1] == "WAIT") && tokens.size() >= 4)
+		{
+			NetPackHandler::Lane lane = NetPackHandler::Lane::Count;
+			for (int i = 0; i < (int)NetPackHandler::Lane::Count; i++)
+			{
+				std::string name = NetPackHandler::GetLaneName((NetPackHandler::Lane)i);
+				for (auto& c : name) c = (char)std::toupper((unsigned char)c);
+				if (name == tokens[2]) lane = (NetPackHandler::Lane)i;
+			}
+			if (lane == NetPackHandler::Lane::Count)
+			{
+				Console::Out() << "Unknown lane: " << tokens[2] << " (GAME, CONTROL, CHAT)" << std::endl;
+				return;
+			}
+			try { value = std::stoi(tokens[3]); }
+			catch (const std::exception& e) { Console::Out() << e.what() << std::endl; return; }
+			if (tokens[1] == "PRIO")
+				m_player.Handler().SetLanePriority(lane, value);
+			else
+				m_player.Handler().SetLaneMaxWait(lane, value);
+			Console::Out() << "Lane " << NetPackHandler::GetLaneName(lane) << " " << (tokens[1] == "PRIO" ? "priority" : "max wait") << " set to " << value << std::endl;
+			return;
+		}
+		Console::Out() << "Usage: QUEUESTAT [RESET | BURST <n> | PRIO <lane> <n> | WAIT <lane> <ms>]" << std::endl;
+	} };
+
+	m_commands["FAULTSTAT"] = CommandSpec{ 1, false, false, [](const std::vector<std::string>& tokens, int) {
+		if (tokens.size() >= 2 && tokens[1] == "RESET")
+		{
+			FaultInjectingTransport::ResetStats();
+			Console::Out() << "Fault stats reset" << std::endl;
+			return;
+		}
+		FaultInjectingTransport::PrintStats();
+	} };
+
+	m_commands["BENCH"] = CommandSpec{ 2, false, true, [this](const std::vector<std::string>& tokens, int) {
+		int count = 0;
+		int seed = 1;
+		if (tokens.size() >= 4 && !TryParseInt(tokens[3], seed))
+			seed = -1;
+		if (tokens[1] == "EVAL" && seed >= 0)
+		{
+			if (tokens.size() < 3)
+				count = 1000000;
+			else if (!TryParseInt(tokens[2], count) || count <= 0)
+				count = 0;
+			if (count > 0)
+			{
+				Benchmark::HandEval(count, (uint64_t)seed);
+				return;
+			}
+		}
+		if (tokens[1] == "ALLIN" && seed >= 0)
+		{
+			if (tokens.size() < 3)
+				count = 2;
+			else if (!TryParseInt(tokens[2], count) || count < 2 || count > 10)
+				count = 0;
+			if (count > 0)
+			{
+				Benchmark::AllInEquity(count, (uint64_t)seed);
+				return;
+			}
+		}
+		if (tokens[1] == "SEATS" && seed >= 0)
+		{
+			if (tokens.size() < 3)
+				count = 100000;
+			else if (!TryParseInt(tokens[2], count) || count <= 0)
+				count = 0;
+			if (count > 0)
+			{
+				Benchmark::Seats(count, (uint64_t)seed);
+				return;
+			}
+		}
+		if (tokens[1] == "SHUFFLE" && seed >= 0)
+		{
+			if (tokens.size() < 3)
+				count = 200000;
+			else if (!TryParseInt(tokens[2], count) || count <= 0)
+				count = 0;
+			if (count > 0)
+			{
+				Benchmark::Shuffle(count, (uint64_t)seed);
+				return;
+			}
+		}
+		if (tokens[1] == "BATCH" && tokens.size() >= 3 && tokens[2] == "ALL")
+		{
+			Benchmark::HandEvalExhaustive();
+			return;
+		}
+		if (tokens[1] == "BATCH" && tokens.size() >= 3 && (tokens[2] == "AUTO" || tokens[2] == "SCALAR"))
+		{
+			HandEvaluator::SetBatchPath(tokens[2] == "AUTO" ? HandEvaluator::BatchPath::Auto : HandEvaluator::BatchPath::Scalar);
+			Console::Out() << "Batch evaluation: " << (HandEvaluator::ActiveBatchPath() == HandEvaluator::BatchPath::Avx2 ? "avx2" : "scalar")
+				<< std::endl;
+			return;
+		}
+		if (tokens[1] == "BATCH" && seed >= 0)
+		{
+			if (tokens.size() < 3)
+				count = 1000000;
+			else if (!TryParseInt(tokens[2], count) || count <= 0)
+				count = 0;
+			if (count > 0)
+			{
+				Benchmark::HandEvalBatch(count, (uint64_t)seed);
+				return;
+			}
+		}
+		Console::Out() << "Usage: BENCH EVAL [hands] [seed] | BENCH BATCH [hands] [seed] | BENCH BATCH <ALL|AUTO|SCALAR>"
+			<< " | BENCH ALLIN [players] [seed] | BENCH SHUFFLE [decks] [seed]"
+			<< " | BENCH SEATS [hands] [seed]" << std::endl;
+	} };
+
+	m_commands["EVALMODE"] = CommandSpec{ 1, false, false, [](const std::vector<std::string>& tokens, int) {
+		if (tokens.size() >= 2)
+		{
+			if (tokens[1] == "COMPAT")
+				HandEvaluator::SetScoreMode(HandEvaluator::ScoreMode::Compatible);
+			else if (tokens[1] == "EXACT")
+				HandEvaluator::SetScoreMode(HandEvaluator::ScoreMode::Exact);
+			else
+			{
+				Console::Out() << "Usage: EVALMODE [COMPAT|EXACT]" << std::endl;
+				return;
+			}
+		}
+		Console::Out() << "Hand scores: " << (HandEvaluator::GetScoreMode() == HandEvaluator::ScoreMode::Exact
+			? "exact (every kicker, wheel is five-high)" : "compatible (original encoding)") << std::endl;
+	} };
+
+	m_commands["RNG"] = CommandSpec{ 1, false, false, [this](const std::vector<std::string>& tokens, int) {
+		int seed = 0;
+		if (tokens.size() >= 2 && (tokens[1] == "FAST" || tokens[1] == "SECURE"))
+			DeckRng::SetDefaultPolicy(tokens[1] == "FAST" ? RngPolicy::Fast : RngPolicy::Secure);
+		else if (tokens.size() >= 3 && tokens[1] == "SEED" && tokens[2] == "OFF")
+			DeckRng::SetReplaySeed(0);
+		else if (tokens.size() >= 3 && tokens[1] == "SEED" && TryParseInt(tokens[2], seed) && seed > 0)
+			DeckRng::SetReplaySeed((uint64_t)seed);
+		else if (tokens.size() >= 2)
+		{
+			Console::Out() << "Usage: RNG [FAST|SECURE] | RNG SEED <n|OFF>" << std::endl;
+			return;
+		}
+		Console::Out() << "Deals: " << (DeckRng::DefaultPolicy() == RngPolicy::Fast ? "xoshiro256** (fast)" : "ChaCha20 (secure)")
+			<< ", seeds: ";
+		if (DeckRng::ReplaySeed() != 0)
+			Console::Out() << "replay " << DeckRng::ReplaySeed() << std::endl;
+		else
+			Console::Out() << "random_device" << std::endl;
+	} };
+
+	m_commands["MUX"] = CommandSpec{ 1, false, false, [this](const std::vector<std::string>& tokens, int) {
+		if (tokens.size() >= 3 && tokens[1] == "VERBOSE")
+		{
+			NetPackHandler::SetMuxVerbose(tokens[2] == "ON");
+			Console::Out() << "Mux session packs: " << (tokens[2] == "ON" ? "all printed" : "logins and errors only") << std::endl;
+			return;
+		}
+		if (!m_farm)
+		{
+			// sessions share the main connection's endpoint and loop
+			if (!m_loop || !m_player.GetReconnectManager())
+			{
+				Console::Out() << "ERROR: MUX only runs on the main connection" << std::endl;
+				return;
+			}
+			m_farm = std::make_unique<SessionFarm>(m_player.GetReconnectManager()->GetEndpoint(), *m_loop);
+		}
+		if (tokens.size() < 2)
+		{
+			m_farm->PrintStats();
+			return;
+		}
+		int value = 0;
+		if (tokens[1] == "OPEN" && tokens.size() == 3 && TryParseInt(tokens[2], value) && value > 0)
+		{
+			int opened = m_farm->Open(value);
+			Console::Out() << "Opened " << opened << " mux session(s), " << m_farm->Count() << " open" << std::endl;
+			return;
+		}
+		if (tokens[1] == "SHARDS" && tokens.size() == 3 && TryParseInt(tokens[2], value) && value >= 0)
+		{
+			if (m_farm->SetShards((size_t)value))
+				Console::Out() << "Mux sessions dispatch on " << (value == 0 ? "one thread per core" : tokens[2] + " thread(s)") << std::endl;
+			else
+				Console::Out() << "Close every mux session before changing shards" << std::endl;
+			return;
+		}
+		if (tokens[1] == "CLOSE" && tokens.size() == 3)
+		{
+			if (tokens[2] == "ALL")
+				m_farm->Close(0);
+			else if (!TryParseInt(tokens[2], value) || value <= 0 || !m_farm->Close((uint16_t)value))
+				Console::Out() << "Unknown mux session: " << tokens[2] << std::endl;
+			return;
+		}
+		if (tokens.size() >= 3 && tokens[1] != "OPEN" && tokens[1] != "CLOSE" && tokens[1] != "SHARDS")
+		{
+			std::string line = tokens[2];
+			for (size_t i = 3; i < tokens.size(); i++)
+				line += " " + tokens[i];
+			if (tokens[1] == "ALL")
+				m_farm->RunAll(line);
+			else if (!TryParseInt(tokens[1], value) || value <= 0 || !m_farm->Run((uint16_t)value, line))
+				Console::Out() << "Unknown mux session: " << tokens[1] << std::endl;
+			return;
+		}
+		Console::Out() << "Usage: MUX [OPEN <n> | CLOSE <id|ALL> | SHARDS <n> | <id|ALL> <command...> | VERBOSE ON|OFF]" << std::endl;
 	} };
 
 	m_commands["LOGIN"] = CommandSpec{ 3, true, true, [this](const std::vector<std::string>& tokens, int) {
@@ -141,7 +586,8 @@ void CommandProcessor::RegisterCommands()
 		uint16_t type = 0;
 		try { type = static_cast<uint16_t>(std::stoi(tokens[1])); }
 		catch (const std::exception& e) { Console::Out() << e.what() << std::endl; return; }
-		m_player.Send(RpcEnum::rpc_server_create_room, [type](NetPack& pack) { pack.WriteUInt16(type); });
+		m_player.Request(RpcEnum::rpc_server_create_room, [type](NetPack& pack) { pack.WriteUInt16(type); },
+			ReportFailure("MAKEROOM"));
 	} };
 
 	m_commands["TOROOM"] = CommandSpec{ 2, true, true, [this](const std::vector<std::string>& tokens, int) {
@@ -182,11 +628,139 @@ void CommandProcessor::RegisterCommands()
 	m_commands["TABLEINFO"] = CommandSpec{ 1, false, false, [this](const std::vector<std::string>&, int room) {
 		if (!RequireRoom(room))
 			return;
-		m_player.Send(RpcEnum::rpc_server_get_poker_table_info, [room](NetPack& pack) {
+		m_player.Request(RpcEnum::rpc_server_get_poker_table_info, [room](NetPack& pack) {
 			pack.WriteInt32(room);
+		}, [report = ReportFailure("TABLEINFO")](RequestTracker::Status status, NetPack* reply) {
+			// a fresh reply was reused (RPCSTAT REFRESH), NetPackHandler never saw it
+			if (status == RequestTracker::Status::Cached && reply)
+			{
+				// Format: roomId:i32, then HoldemPokerGame::ReadTable format
+				int replyRoom = reply->ReadInt32();
+				HoldemPokerGame localGame;
+				localGame.ReadTable(*reply);
+				Console::Out() << "(cached table info)" << std::endl;
+				GameElementPrinter::Print(localGame, replyRoom);
+				return;
+			}
+			report(status, reply);
 		});
 	} };
 
+	m_commands["EQUITY"] = CommandSpec{ 1, false, false, [this](const std::vector<std::string>& tokens, int room) {
+		if (tokens.size() >= 3 && tokens[1] == "ALLIN")
+		{
+			HoldemPokerGame::SetAllInEquity(tokens[2] == "ON");
+			Console::Out() << "All-in equity in hand results: " << (HoldemPokerGame::IsAllInEquity() ? "on" : "off") << std::endl;
+			return;
+		}
+		if (tokens.size() >= 2 && tokens[1] == "CANCEL")
+		{
+			if (*m_equityJob)
+				(*m_equityJob)->Cancel();
+			else
+				Console::Out() << "[EQUITY] nothing running" << std::endl;
+			return;
+		}
+
+		// EQUITY [opponents] [ms] on the current table, EQUITY <hole> [board|-] [opponents] [ms] for given cards
+		EquityRequest request;
+		size_t next = 1;
+		int number = 0;
+		bool ok = true;
+		const bool fromTable = tokens.size() < 2 || TryParseInt(tokens[1], number);
+		if (!fromTable)
+		{
+			ok = CardSet::Parse(tokens[1], request.hole);
+			next = 2;
+			if (ok && tokens.size() > next && !TryParseInt(tokens[next], number))
+				ok = CardSet::Parse(tokens[next++], request.board);
+		}
+		int opponents = 0, budgetMs = 0;
+		if (!ok || (tokens.size() > next && !TryParseInt(tokens[next], opponents))
+			|| (tokens.size() > next + 1 && !TryParseInt(tokens[next + 1], budgetMs)))
+		{
+			Console::Out() << "Usage: EQUITY [opponents] [ms] | EQUITY <hole> [board|-] [opponents] [ms] | EQUITY CANCEL" << std::endl;
+			return;
+		}
+		if (opponents > 0)
+			request.opponents = opponents;
+		if (budgetMs > 0)
+			request.budget = std::chrono::milliseconds(budgetMs);
+		if (fromTable && !RequireRoom(room))
+			return;
+		if (*m_equityJob)
+			(*m_equityJob)->Cancel();
+		CoScheduler::Inst().Spawn(EquityFlow(m_session, fromTable ? room : -1, request, fromTable && opponents <= 0, m_equityJob));
+	} };
+
+	m_commands["RANGE"] = CommandSpec{ 2, false, true, [](const std::vector<std::string>& tokens, int) {
+		if (tokens[1] == "CACHE")
+		{
+			if (tokens.size() >= 3 && tokens[2] == "CLEAR")
+				EquityCalculator::ClearRangeCache();
+			Console::Out() << "[RANGE] " << EquityCalculator::RangeCacheSize() << " cached result(s)" << std::endl;
+			return;
+		}
+		std::string error;
+		if (tokens[1] == "PARSE" && tokens.size() >= 3)
+		{
+			HandRange range;
+			if (!HandRange::Parse(tokens[2], range, error))
+			{
+				Console::Out() << "[RANGE] " << error << std::endl;
+				return;
+			}
+			Console::Out() << "[RANGE] " << tokens[2] << ": " << range.Size() << " combos, weight "
+				<< std::format("{:.2f}", range.TotalWeight()) << std::endl;
+			return;
+		}
+
+		CardSet board;
+		if (tokens.size() < 4 || !CardSet::Parse(tokens[1], board))
+		{
+			Console::Out() << "Usage: RANGE <board> <range> <range> [range...] | RANGE PARSE <range> | RANGE CACHE [CLEAR]" << std::endl;
+			return;
+		}
+		std::vector<HandRange> ranges(tokens.size() - 2);
+		for (size_t i = 0; i < ranges.size(); i++)
+		{
+			if (!HandRange::Parse(tokens[i + 2], ranges[i], error))
+			{
+				Console::Out() << "[RANGE] " << error << std::endl;
+				return;
+			}
+		}
+		const RangeEquity result = EquityCalculator::RangeVsRange(ranges, board);
+		if (!result.error.empty())
+		{
+			Console::Out() << "[RANGE] " << result.error << std::endl;
+			return;
+		}
+		Console::Out() << "[RANGE] " << tokens[1] << ": " << result.matchups << " matchups x " << result.runouts << " runouts in "
+			<< std::format("{:.1f}", result.elapsedMs) << " ms" << (result.cached ? " (cached)" : "") << std::endl;
+		for (size_t i = 0; i < ranges.size(); i++)
+			Console::Out() << '\t' << std::format("{:6.2f}%", result.equity[i] * 100) << "  " << tokens[i + 2]
+				<< " (" << result.combos[i] << " combos)" << std::endl;
+	} };
+
+	m_commands["SNAPSHOT"] = CommandSpec{ 1, false, false, [this](const std::vector<std::string>& tokens, int room) {
+		if (!RequireRoom(room))
+			return;
+		int count = 1;
+		if (tokens.size() >= 2)
+		{
+			try { count = std::stoi(tokens[1]); }
+			catch (const std::exception& e) { Console::Out() << e.what() << std::endl; return; }
+		}
+		if (count < 1)
+			return;
+		auto batch = std::make_shared<SnapshotBatch>();
+		batch->total = count;
+		batch->startedAt = std::chrono::steady_clock::now();
+		for (int i = 0; i < count; i++)
+			CoScheduler::Inst().Spawn(SnapshotFlow(m_session, room, batch));
+	} };
+
 	m_commands["SIT"] = CommandSpec{ 1, false, false, [this](const std::vector<std::string>& tokens, int room) {
 		if (!RequireRoom(room))
 			return;
@@ -201,10 +775,10 @@ void CommandProcessor::RegisterCommands()
 		int amount = 0;
 		try { amount = std::stoi(tokens[1]); }
 		catch (const std::exception& e) { Console::Out() << e.what() << std::endl; return; }
-		m_player.Send(RpcEnum::rpc_server_poker_buyin, [room, amount](NetPack& pack) {
+		m_player.Request(RpcEnum::rpc_server_poker_buyin, [room, amount](NetPack& pack) {
 			pack.WriteInt32(room);
 			pack.WriteInt32(amount);
-		});
+		}, ReportFailure("BUYIN"));
 	} };
 
 	m_commands["STANDUP"] = CommandSpec{ 1, false, false, [this](const std::vector<std::string>&, int room) {
@@ -390,6 +964,17 @@ void CommandProcessor::SendTextMessage(const std::string& rawInput, const std::s
 		});
 }
 
+RequestTracker::Callback CommandProcessor::ReportFailure(const char* command)
+{
+	// the reply itself is printed by NetPackHandler, only say something when none comes
+	return [command](RequestTracker::Status status, NetPack*) {
+		if (status == RequestTracker::Status::Timeout)
+			Console::Out() << command << ": no response from server (timed out)" << std::endl;
+		else if (status == RequestTracker::Status::Lost)
+			Console::Out() << command << ": connection lost before the reply, not resent" << std::endl;
+	};
+}
+
 bool CommandProcessor::RequireRoom(int room) const
 {
 	if (room < 0)
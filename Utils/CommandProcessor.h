@@ -2,20 +2,29 @@
 
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "Game/HoldemPokerGame.h"
+#include "Net/RequestTracker.h"
+#include "Net/ClientSession.h"
 
 class Player;
+class EquityJob;
+class EventLoop;
+class SessionFarm;
 
 class CommandProcessor
 {
 public:
-	explicit CommandProcessor(Player& player);
+	// With a loop, Run hands every line to the loop thread instead of handling it on the input thread
+	explicit CommandProcessor(Player& player, EventLoop* loop = nullptr);
+	~CommandProcessor();
 	void Run();
 	bool HandleLine(const std::string& input);
+	int CurrentRoom() const { return m_currentRoom; }
 
 private:
 	enum class Mode
@@ -41,8 +50,15 @@ private:
 	};
 
 	Player& m_player;
+	EventLoop* m_loop = nullptr;
+	ClientSession m_session;
 	int m_currentRoom = -1;
 	std::unordered_map<std::string, CommandSpec> m_commands;
+	// MUX sessions, created on first use
+	std::unique_ptr<SessionFarm> m_farm;
+	// the EQUITY run in flight, a new one or EQUITY CANCEL stops it; shared with the flow
+	// that fills it, which may outlive this processor
+	std::shared_ptr<std::shared_ptr<EquityJob>> m_equityJob = std::make_shared<std::shared_ptr<EquityJob>>();
 
 	void RegisterCommands();
 	static std::vector<std::string> Split(const std::string& str);
@@ -53,6 +69,7 @@ private:
 	void SendTextMessage(const std::string& rawInput, const std::string& message, const PrefixResult& prefix, int room);
 
 	bool RequireRoom(int room) const;
+	static RequestTracker::Callback ReportFailure(const char* command);
 	bool TryParseInt(const std::string& s, int& out) const;
 
 	static std::function<void(const std::vector<std::string>& strVec, int room)> MakePokerActionCall(
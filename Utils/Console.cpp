@@ -17,6 +17,20 @@ void Console::Start()
 	Instance().StartInternal();
 }
 
+void Console::StartHeadless(HeadlessFormat format)
+{
+	Console& inst = Instance();
+	inst.m_headlessFormat = format;
+	inst.m_headlessStart = std::chrono::steady_clock::now();
+	inst.m_running = true;
+	inst.m_headless = true;
+}
+
+bool Console::IsHeadless()
+{
+	return Instance().m_headless.load();
+}
+
 void Console::Stop()
 {
 	Instance().StopInternal();
@@ -50,6 +64,8 @@ bool Console::ReadLine(std::string& outLine)
 Console::Console()
 	: m_running(false),
 	m_started(false),
+	m_headless(false),
+	m_headlessFormat(HeadlessFormat::Plain),
 	m_inHandle(INVALID_HANDLE_VALUE),
 	m_outHandle(INVALID_HANDLE_VALUE),
 	m_outputEvent(nullptr),
@@ -117,6 +133,16 @@ void Console::StartInternal()
 
 void Console::StopInternal()
 {
+	if (m_headless.load())
+	{
+		FlushStreamBuffer(m_outState);
+		FlushStreamBuffer(m_errState);
+		m_running = false;
+		m_commandCv.notify_all();
+		std::fflush(stdout);
+		std::fflush(stderr);
+		return;
+	}
 	if (!m_started.load())
 		return;
 
@@ -152,6 +178,9 @@ void Console::StopInternal()
 
 bool Console::ReadLineInternal(std::string& outLine)
 {
+	if (m_headless.load())
+		return m_running.load() && static_cast<bool>(std::getline(std::cin, outLine));
+
 	std::unique_lock<std::mutex> lock(m_commandMutex);
 	m_commandCv.wait(lock, [this]() {
 		return !m_commandQueue.empty() || !m_running.load();
@@ -172,6 +201,11 @@ void Console::QueueOutput(const std::string& text, bool isError)
 
 void Console::QueueOutput(const std::wstring& text, bool isError)
 {
+	if (m_headless.load())
+	{
+		WriteHeadless(text, isError);
+		return;
+	}
 	if (!m_started.load())
 	{
 		DWORD written = 0;
@@ -189,6 +223,45 @@ void Console::QueueOutput(const std::wstring& text, bool isError)
 		SetEvent(m_outputEvent);
 }
 
+void Console::WriteHeadless(const std::wstring& text, bool isError)
+{
+	std::string line = ToNarrow(text);
+	FILE* stream = isError ? stderr : stdout;
+	std::lock_guard<std::mutex> lock(m_headlessMutex);
+	if (m_headlessFormat == HeadlessFormat::Plain)
+	{
+		std::fwrite(line.data(), 1, line.size(), stream);
+		return;
+	}
+
+	if (!line.empty() && line.back() == '\n')
+		line.pop_back();
+	std::string escaped;
+	escaped.reserve(line.size() + 8);
+	for (char c : line)
+	{
+		switch (c)
+		{
+		case '"': escaped += "\\\""; break;
+		case '\\': escaped += "\\\\"; break;
+		case '\n': escaped += "\\n"; break;
+		case '\r': escaped += "\\r"; break;
+		case '\t': escaped += "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+				escaped += std::format("\\u{:04x}", (unsigned char)c);
+			else
+				escaped += c;
+		}
+	}
+	const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - m_headlessStart).count();
+	std::string record = std::format("{{\"ts\":{},\"stream\":\"{}\",\"text\":\"{}\"}}\n",
+		elapsedMs, isError ? "err" : "out", escaped);
+	// json lines always go to stdout so one pipe carries the whole session
+	std::fwrite(record.data(), 1, record.size(), stdout);
+}
+
 void Console::AppendStreamText(StreamState& state, const std::wstring& text)
 {
 	if (text.empty())
@@ -698,7 +771,8 @@ std::string Console::ToNarrow(const std::wstring& text) const
 	if (text.empty())
 		return "";
 
-	UINT cp = GetConsoleCP();
+	// headless output is usually piped to a file or another tool, keep it utf-8
+	UINT cp = m_headless.load() ? CP_UTF8 : GetConsoleCP();
 	int size = WideCharToMultiByte(cp, 0, text.data(), (int)text.size(), nullptr, 0, nullptr, nullptr);
 	if (size <= 0)
 		return "";
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <mutex>
@@ -15,8 +16,17 @@
 class Console
 {
 public:
+	enum class HeadlessFormat : uint8_t
+	{
+		Plain = 0,
+		Json = 1,      // one JSON object per output line
+	};
+
 	static Console& Instance();
 	static void Start();
+	// No UI thread and no console modes: every line goes straight to stdout/stderr
+	static void StartHeadless(HeadlessFormat format);
+	static bool IsHeadless();
 	static void Stop();
 
 	static std::ostream& Out();
@@ -42,6 +52,7 @@ private:
 	void AppendStreamText(StreamState& state, const std::wstring& text);
 	void FlushStreamBuffer(StreamState& state);
 	void QueueCommand(const std::wstring& line);
+	void WriteHeadless(const std::wstring& text, bool isError);
 
 	void UiThreadMain();
 	void HandleKeyEvent(const KEY_EVENT_RECORD& key);
@@ -109,6 +120,10 @@ private:
 
 	std::atomic<bool> m_running;
 	std::atomic<bool> m_started;
+	std::atomic<bool> m_headless;
+	HeadlessFormat m_headlessFormat;
+	std::chrono::steady_clock::time_point m_headlessStart;
+	std::mutex m_headlessMutex;
 	std::thread m_uiThread;
 
 	HANDLE m_inHandle;
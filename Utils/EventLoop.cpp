@@ -0,0 +1,240 @@
+#include "pch.h"
+#include "EventLoop.h"
+#include <future>
+
+#undef min
+#undef max
+
+EventLoop::EventLoop() :
+	m_threadId(std::this_thread::get_id())
+{
+	m_wakeSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = 0;
+	inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+	socklen_t addrLen = sizeof(addr);
+	unsigned long nonBlocking = 1;
+	if (m_wakeSocket == INVALID_SOCKET
+		|| bind(m_wakeSocket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR
+		|| getsockname(m_wakeSocket, (sockaddr*)&addr, &addrLen) == SOCKET_ERROR
+		|| connect(m_wakeSocket, (sockaddr*)&addr, addrLen) == SOCKET_ERROR
+		|| ioctlsocket(m_wakeSocket, FIONBIO, &nonBlocking) == SOCKET_ERROR)
+	{
+		// without it the loop still works, a blocked poll just notices posts at the next timer
+		Console::Err() << "event loop: wake socket failed: " << WSAGetLastError() << std::endl;
+		if (m_wakeSocket != INVALID_SOCKET)
+			closesocket(m_wakeSocket);
+		m_wakeSocket = INVALID_SOCKET;
+	}
+}
+
+EventLoop::~EventLoop()
+{
+	if (m_wakeSocket != INVALID_SOCKET)
+		closesocket(m_wakeSocket);
+}
+
+void EventLoop::Post(Callback task)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_postMutex);
+		m_posted.push_back(std::move(task));
+	}
+	m_posts++;
+	if (!InLoopThread())
+		WakeUp();
+}
+
+void EventLoop::Invoke(Callback task)
+{
+	if (InLoopThread())
+	{
+		task();
+		return;
+	}
+	auto done = std::make_shared<std::promise<void>>();
+	auto finished = done->get_future();
+	Post([task = std::move(task), done]() {
+		task();
+		done->set_value();
+	});
+	// a stopped loop never runs it, do not hang the caller
+	while (finished.wait_for(std::chrono::milliseconds(50)) != std::future_status::ready)
+		if (m_stopped)
+			return;
+}
+
+EventLoop::TimerId EventLoop::AddTimer(std::chrono::milliseconds delay, Callback task, std::chrono::milliseconds repeat)
+{
+	const TimerId id = m_nextTimerId++;
+	m_timers[id] = TimerEntry{ std::move(task), repeat };
+	m_timerQueue.push(Timer{ std::chrono::steady_clock::now() + delay, id });
+	return id;
+}
+
+void EventLoop::CancelTimer(TimerId id)
+{
+	// the queue entry stays and is skipped when it comes up
+	m_timers.erase(id);
+}
+
+void EventLoop::Watch(SOCKET socket, uint32_t events, IoCallback callback)
+{
+	m_watchers[socket] = Watcher{ events, std::move(callback) };
+}
+
+void EventLoop::Unwatch(SOCKET socket)
+{
+	m_watchers.erase(socket);
+}
+
+void EventLoop::Run()
+{
+	m_threadId = std::this_thread::get_id();
+	while (!m_stopped)
+	{
+		m_iterations++;
+		RunPosted();
+		RunTimers();
+		if (m_stopped)
+			break;
+		PollOnce(PollTimeoutMs());
+	}
+}
+
+void EventLoop::Stop()
+{
+	m_stopped = true;
+	if (!InLoopThread())
+		WakeUp();
+}
+
+size_t EventLoop::RunPosted()
+{
+	std::vector<Callback> tasks;
+	{
+		std::unique_lock<std::mutex> lock(m_postMutex);
+		tasks.swap(m_posted);
+	}
+	// tasks posted by these run in the next round, after I/O had a chance
+	for (auto& task : tasks)
+		task();
+	m_tasksRun += tasks.size();
+	return tasks.size();
+}
+
+size_t EventLoop::RunTimers()
+{
+	const auto now = std::chrono::steady_clock::now();
+	size_t fired = 0;
+	while (!m_timerQueue.empty() && m_timerQueue.top().deadline <= now)
+	{
+		Timer timer = m_timerQueue.top();
+		m_timerQueue.pop();
+		auto it = m_timers.find(timer.id);
+		if (it == m_timers.end())
+			continue;
+		Callback task = it->second.task;
+		if (it->second.repeat.count() > 0)
+			m_timerQueue.push(Timer{ now + it->second.repeat, timer.id });
+		else
+			m_timers.erase(it);
+		task();
+		fired++;
+	}
+	m_timersFired += fired;
+	return fired;
+}
+
+int EventLoop::PollTimeoutMs()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_postMutex);
+		if (!m_posted.empty())
+			return 0;
+	}
+	// drop cancelled timers so they do not cut the sleep short
+	while (!m_timerQueue.empty() && m_timers.find(m_timerQueue.top().id) == m_timers.end())
+		m_timerQueue.pop();
+	if (m_timerQueue.empty())
+		return m_wakeSocket == INVALID_SOCKET ? 50 : -1;
+	const auto left = std::chrono::duration_cast<std::chrono::microseconds>(
+		m_timerQueue.top().deadline - std::chrono::steady_clock::now()).count();
+	// round up, waking a hair early would just spin once more
+	return left <= 0 ? 0 : (int)((left + 999) / 1000);
+}
+
+void EventLoop::PollOnce(int timeoutMs)
+{
+	std::vector<WSAPOLLFD> fds;
+	fds.reserve(m_watchers.size() + 1);
+	if (m_wakeSocket != INVALID_SOCKET)
+	{
+		WSAPOLLFD wake{};
+		wake.fd = m_wakeSocket;
+		wake.events = POLLIN;
+		fds.push_back(wake);
+	}
+	for (const auto& [socket, watcher] : m_watchers)
+	{
+		WSAPOLLFD fd{};
+		fd.fd = socket;
+		fd.events = (short)(((watcher.events & Readable) ? POLLIN : 0) | ((watcher.events & Writable) ? POLLOUT : 0));
+		fds.push_back(fd);
+	}
+
+	int ready = WSAPoll(fds.data(), (unsigned long)fds.size(), timeoutMs);
+	if (ready <= 0)
+		return;
+	m_pollWakeups++;
+	for (const auto& fd : fds)
+	{
+		if (fd.revents == 0)
+			continue;
+		if (fd.fd == m_wakeSocket)
+		{
+			DrainWakeSocket();
+			continue;
+		}
+		uint32_t events = 0;
+		if (fd.revents & POLLIN) events |= Readable;
+		if (fd.revents & POLLOUT) events |= Writable;
+		if (fd.revents & (POLLERR | POLLHUP | POLLNVAL)) events |= Closed;
+		// an earlier callback in this round may have unwatched it
+		auto it = m_watchers.find(fd.fd);
+		if (it == m_watchers.end())
+			continue;
+		// copy, the callback may unwatch itself
+		IoCallback callback = it->second.callback;
+		callback(events);
+		m_ioEvents++;
+	}
+}
+
+void EventLoop::WakeUp()
+{
+	if (m_wakeSocket == INVALID_SOCKET || m_wakePending.exchange(true))
+		return;
+	const char byte = 1;
+	send(m_wakeSocket, &byte, 1, 0);
+	m_wakeSignals++;
+}
+
+void EventLoop::DrainWakeSocket()
+{
+	// cleared first: a post racing with the drain either sends a fresh byte or is seen by RunPosted
+	m_wakePending = false;
+	char buffer[64];
+	while (recv(m_wakeSocket, buffer, sizeof(buffer), 0) > 0)
+	{
+	}
+}
+
+void EventLoop::PrintStats()
+{
+	Console::Out() << "[EVENT LOOP] iterations " << m_iterations << ", poll wakeups " << m_pollWakeups
+		<< ", tasks " << m_tasksRun << " (posted " << m_posts << ", wake signals " << m_wakeSignals << ")"
+		<< ", timers fired " << m_timersFired << " (armed " << m_timers.size() << ")"
+		<< ", io events " << m_ioEvents << ", watched sockets " << m_watchers.size() << std::endl;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Single threaded reactor the client runtime lives on: socket readiness (WSAPoll),
+// timers and tasks posted from other threads all run in one thread, in order.
+// Network reads, pack dispatch, coroutine flows and console commands share it,
+// only blocking work (console input, TTS, reconnect backoff) stays on helper threads.
+// Everything except Post, Invoke and Stop must be called on the loop thread
+// (or before Run starts).
+class EventLoop
+{
+public:
+	using Callback = std::function<void()>;
+	using IoCallback = std::function<void(uint32_t events)>;
+	using TimerId = uint64_t;
+
+	enum IoEvent : uint32_t
+	{
+		Readable = 1,
+		Writable = 2,
+		Closed = 4,     // error or hangup, also reported when not asked for
+	};
+
+	EventLoop();
+	~EventLoop();
+	EventLoop(const EventLoop&) = delete;
+	EventLoop& operator=(const EventLoop&) = delete;
+
+	// Any thread. Tasks run in posting order.
+	void Post(Callback task);
+	// Any thread. Runs task on the loop and waits for it, runs inline on the loop thread.
+	void Invoke(Callback task);
+
+	// repeat > 0 re-arms the timer after every run until it is cancelled
+	TimerId AddTimer(std::chrono::milliseconds delay, Callback task,
+		std::chrono::milliseconds repeat = std::chrono::milliseconds(0));
+	void CancelTimer(TimerId id);
+
+	// events is a mask of IoEvent, Watch on a watched socket replaces its entry
+	void Watch(SOCKET socket, uint32_t events, IoCallback callback);
+	void Unwatch(SOCKET socket);
+
+	// Runs until Stop
+	void Run();
+	// Any thread
+	void Stop();
+	bool InLoopThread() const { return std::this_thread::get_id() == m_threadId; }
+
+	void PrintStats();
+
+private:
+	struct Timer
+	{
+		std::chrono::steady_clock::time_point deadline;
+		TimerId id;
+		bool operator>(const Timer& other) const
+		{
+			return deadline != other.deadline ? deadline > other.deadline : id > other.id;
+		}
+	};
+	struct TimerEntry
+	{
+		Callback task;
+		std::chrono::milliseconds repeat{};
+	};
+	struct Watcher
+	{
+		uint32_t events = 0;
+		IoCallback callback;
+	};
+
+	size_t RunPosted();
+	size_t RunTimers();
+	int PollTimeoutMs();
+	void PollOnce(int timeoutMs);
+	void WakeUp();
+	void DrainWakeSocket();
+
+	std::thread::id m_threadId;
+	std::atomic<bool> m_stopped = false;
+
+	std::mutex m_postMutex;
+	std::vector<Callback> m_posted;
+	std::atomic<bool> m_wakePending = false;
+	// loopback UDP socket connected to itself, a byte on it ends a blocking poll
+	SOCKET m_wakeSocket = INVALID_SOCKET;
+
+	std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> m_timerQueue;
+	std::unordered_map<TimerId, TimerEntry> m_timers;
+	TimerId m_nextTimerId = 1;
+
+	std::map<SOCKET, Watcher> m_watchers;
+
+	uint64_t m_iterations = 0;
+	uint64_t m_pollWakeups = 0;
+	uint64_t m_tasksRun = 0;
+	uint64_t m_timersFired = 0;
+	uint64_t m_ioEvents = 0;
+	std::atomic<uint64_t> m_posts = 0;
+	std::atomic<uint64_t> m_wakeSignals = 0;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+
+#undef min
+#undef max
+
+// Log-linear (HDR style) histogram of microsecond samples.
+// Every power-of-two range is split into 32 linear sub-buckets, so any recorded
+// value is reported within ~3% while the whole table stays a few KB.
+class LatencyHistogram
+{
+public:
+	static constexpr int kSubBucketBits = 5;
+	static constexpr int kSubBucketCount = 1 << kSubBucketBits;
+	static constexpr int kMaxMagnitude = 40;
+	static constexpr size_t kBucketCount = 2 * kSubBucketCount + (kMaxMagnitude - kSubBucketBits - 1) * kSubBucketCount;
+
+	void Record(int64_t valueUs)
+	{
+		if (valueUs < 0) valueUs = 0;
+		m_counts[BucketIndex((uint64_t)valueUs)]++;
+		m_total++;
+		m_sum += valueUs;
+		m_min = m_total == 1 ? valueUs : std::min(m_min, valueUs);
+		m_max = std::max(m_max, valueUs);
+	}
+
+	void Reset() { *this = LatencyHistogram{}; }
+
+	// percentile in [0, 100], returns the upper edge of the bucket holding it
+	int64_t Percentile(double percentile) const
+	{
+		if (m_total == 0) return 0;
+		uint64_t target = (uint64_t)(percentile / 100.0 * (double)m_total + 0.5);
+		target = std::clamp<uint64_t>(target, 1, m_total);
+		uint64_t seen = 0;
+		for (size_t i = 0; i < kBucketCount; ++i)
+		{
+			seen += m_counts[i];
+			if (seen >= target)
+				return std::min(BucketUpperBound(i), m_max);
+		}
+		return m_max;
+	}
+
+	uint64_t Count() const { return m_total; }
+	int64_t Min() const { return m_min; }
+	int64_t Max() const { return m_max; }
+	double Mean() const { return m_total ? (double)m_sum / (double)m_total : 0.0; }
+
+private:
+	static size_t BucketIndex(uint64_t value)
+	{
+		if (value < 2 * kSubBucketCount)
+			return (size_t)value;
+		int magnitude = std::bit_width(value) - 1;
+		if (magnitude >= kMaxMagnitude)
+			return kBucketCount - 1;
+		int shift = magnitude - kSubBucketBits;
+		return 2 * kSubBucketCount + (size_t)(magnitude - kSubBucketBits - 1) * kSubBucketCount
+			+ (size_t)((value >> shift) - kSubBucketCount);
+	}
+
+	static int64_t BucketUpperBound(size_t index)
+	{
+		if (index < 2 * kSubBucketCount)
+			return (int64_t)index;
+		size_t rel = index - 2 * kSubBucketCount;
+		int magnitude = (int)(rel / kSubBucketCount) + kSubBucketBits + 1;
+		int shift = magnitude - kSubBucketBits;
+		uint64_t sub = rel % kSubBucketCount + kSubBucketCount;
+		return (int64_t)(((sub + 1) << shift) - 1);
+	}
+
+	std::array<uint64_t, kBucketCount> m_counts{};
+	uint64_t m_total = 0;
+	int64_t m_sum = 0;
+	int64_t m_min = 0;
+	int64_t m_max = 0;
+};
@@ -0,0 +1,179 @@
+#include "pch.h"
+#include "ScriptRunner.h"
+#include "Utils/CommandProcessor.h"
+#include "Net/SessionEvents.h"
+#include "Utils/CoScheduler.h"
+#include "Utils/EventLoop.h"
+#include <sstream>
+
+namespace
+{
+	std::vector<std::string> SplitTokens(const std::string& line)
+	{
+		std::vector<std::string> tokens;
+		std::istringstream stream(line);
+		std::string token;
+		while (stream >> token)
+			tokens.push_back(token);
+		return tokens;
+	}
+
+	bool IsPokerAction(const std::string& token)
+	{
+		return token == "CHECK" || token == "CALL" || token == "BET"
+			|| token == "RAISE" || token == "ALLIN" || token == "FOLD";
+	}
+}
+
+ScriptRunner::ScriptRunner(CommandProcessor& processor, Player& player, EventLoop* loop, Options options) :
+	m_processor(processor),
+	m_player(player),
+	m_loop(loop),
+	m_options(options)
+{
+}
+
+int ScriptRunner::Run(std::istream& input)
+{
+	const auto startedAt = std::chrono::steady_clock::now();
+	std::string line;
+	while (!m_player.Expired() && std::getline(input, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		std::vector<std::string> tokens = SplitTokens(line);
+		if (tokens.empty() || tokens[0][0] == '#')
+			continue;
+
+		if (tokens[0] == "WAIT")
+		{
+			m_waits++;
+			if (!RunWait(tokens))
+			{
+				m_failures++;
+				if (m_options.stopOnFailure)
+					break;
+			}
+			continue;
+		}
+
+		if (tokens[0] == "QUIT")
+			break;
+
+		// the table we saw before acting is stale, WAIT TURN needs a newer one; a hand result
+		// already in is an earlier hand's, WAIT HANDRESULT needs one after the action
+		for (size_t i = 0; i < tokens.size() && i < 2; i++)
+		{
+			if (!IsPokerAction(tokens[i]))
+				continue;
+			const SessionEvents::State state = SessionEvents::Inst().Snapshot();
+			m_tableUpdatesAtAction = state.tableUpdates;
+			m_handResultsAtAction = SessionEvents::HandResultCount(state, CurrentRoom());
+		}
+
+		Console::Out() << "> " << line << std::endl;
+		m_commands++;
+		if (m_loop)
+			m_loop->Invoke([this, &line]() { m_processor.HandleLine(line); });
+		else
+			m_processor.HandleLine(line);
+	}
+
+	// let replies to the last commands land before disconnecting
+	if (!m_player.Expired())
+		WaitIdle(std::chrono::milliseconds(2000));
+
+	const double elapsedMs = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - startedAt).count() / 1000.0;
+	Console::Out() << "[SCRIPT] done: " << m_commands << " commands, " << m_waits << " waits, "
+		<< m_failures << " failed, " << std::format("{:.1f}", elapsedMs) << " ms" << std::endl;
+	m_player.Delete();
+	return m_failures;
+}
+
+bool ScriptRunner::RunWait(const std::vector<std::string>& tokens)
+{
+	if (tokens.size() < 2)
+	{
+		Console::Out() << "[SCRIPT] WAIT needs MS, LOGIN, TURN, HANDRESULT or IDLE" << std::endl;
+		return false;
+	}
+	const std::string& what = tokens[1];
+	int timeoutMs = m_options.defaultTimeoutMs;
+	if (tokens.size() >= 3)
+	{
+		try { timeoutMs = std::stoi(tokens[2]); }
+		catch (const std::exception& e) { Console::Out() << "[SCRIPT] " << e.what() << std::endl; return false; }
+	}
+	const auto timeout = std::chrono::milliseconds(timeoutMs);
+	const auto startedAt = std::chrono::steady_clock::now();
+
+	bool ok = false;
+	if (what == "MS")
+	{
+		std::this_thread::sleep_for(timeout);
+		return true;
+	}
+	else if (what == "LOGIN")
+	{
+		ok = SessionEvents::Inst().WaitUntil([](const SessionEvents::State& state) {
+			return state.myPlayerId >= 0;
+		}, timeout);
+	}
+	else if (what == "TURN")
+	{
+		const int room = CurrentRoom();
+		const uint64_t after = m_tableUpdatesAtAction;
+		ok = SessionEvents::Inst().WaitUntil([room, after](const SessionEvents::State& state) {
+			return state.tableUpdates > after && SessionEvents::IsMyTurn(state, room);
+		}, timeout);
+	}
+	else if (what == "HANDRESULT")
+	{
+		const int room = CurrentRoom();
+		const uint64_t seen = std::max(m_handResultsSeen, m_handResultsAtAction);
+		ok = SessionEvents::Inst().WaitUntil([room, seen](const SessionEvents::State& state) {
+			return SessionEvents::HandResultCount(state, room) > seen;
+		}, timeout);
+		if (ok)
+			m_handResultsSeen = SessionEvents::HandResultCount(SessionEvents::Inst().Snapshot(), room);
+	}
+	else if (what == "IDLE")
+	{
+		ok = WaitIdle(timeout);
+	}
+	else
+	{
+		Console::Out() << "[SCRIPT] unknown WAIT " << what << std::endl;
+		return false;
+	}
+
+	const auto waitedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - startedAt).count();
+	Console::Out() << "[SCRIPT] WAIT " << what << (ok ? " ok after " : " timed out after ") << waitedMs << " ms" << std::endl;
+	return ok;
+}
+
+int ScriptRunner::CurrentRoom()
+{
+	// USEROOM changes it on the loop thread
+	int room = -1;
+	if (m_loop)
+		m_loop->Invoke([this, &room]() { room = m_processor.CurrentRoom(); });
+	else
+		room = m_processor.CurrentRoom();
+	return room;
+}
+
+bool ScriptRunner::WaitIdle(std::chrono::milliseconds timeout)
+{
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	// a flow spawned by the last command may not have sent its first request yet
+	while (m_player.Tracker().PendingCount() > 0 || CoScheduler::Inst().ActiveFlows() > 0)
+	{
+		if (m_player.Expired() || std::chrono::steady_clock::now() >= deadline)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	return true;
+}
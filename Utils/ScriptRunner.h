@@ -0,0 +1,52 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+class CommandProcessor;
+class EventLoop;
+class Player;
+
+// Feeds CommandProcessor from a script file or stdin for headless runs.
+// Lines are ordinary console commands, plus:
+//     # comment
+//     WAIT MS <ms>                  sleep
+//     WAIT LOGIN [timeoutMs]        until the login reply arrived
+//     WAIT TURN [timeoutMs]         until the table says it is our turn (current room, or any)
+//     WAIT HANDRESULT [timeoutMs]   until a hand result newer than the last poker action and WAIT arrives
+//     WAIT IDLE [timeoutMs]         until no request is waiting for a reply and no flow runs
+// A WAIT that times out fails the run and, by default, ends the script.
+// With a loop, each command runs on the loop thread and the script continues once it returned.
+class ScriptRunner
+{
+public:
+	struct Options
+	{
+		int defaultTimeoutMs = 30000;
+		bool stopOnFailure = true;
+	};
+
+	ScriptRunner(CommandProcessor& processor, Player& player, EventLoop* loop, Options options);
+
+	// Runs until end of input or QUIT, then disconnects the player. Returns the number of failed waits.
+	int Run(std::istream& input);
+
+private:
+	bool RunWait(const std::vector<std::string>& tokens);
+	bool WaitIdle(std::chrono::milliseconds timeout);
+	int CurrentRoom();
+
+	CommandProcessor& m_processor;
+	Player& m_player;
+	EventLoop* m_loop;
+	Options m_options;
+
+	uint64_t m_handResultsSeen = 0;
+	uint64_t m_tableUpdatesAtAction = 0;
+	uint64_t m_handResultsAtAction = 0;
+	int m_commands = 0;
+	int m_waits = 0;
+	int m_failures = 0;
+};
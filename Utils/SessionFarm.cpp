@@ -0,0 +1,177 @@
+#include "pch.h"
+#include "SessionFarm.h"
+#include "Net/SessionMux.h"
+#include "Net/Transport.h"
+#include "Utils/CommandProcessor.h"
+#include "Utils/EventLoop.h"
+#include "Utils/ShardedExecutor.h"
+
+namespace
+{
+	// long enough for flows resumed by the last replies to run before their session goes
+	constexpr auto kCloseLinger = std::chrono::milliseconds(1000);
+
+	std::string ExpandId(std::string line, uint16_t id)
+	{
+		const std::string idText = std::to_string(id);
+		for (size_t pos = line.find("{id}"); pos != std::string::npos; pos = line.find("{id}", pos + idText.size()))
+			line.replace(pos, 4, idText);
+		return line;
+	}
+}
+
+SessionFarm::SessionFarm(Connector::Endpoint endpoint, EventLoop& loop) :
+	m_endpoint(std::move(endpoint)),
+	m_loop(loop)
+{
+}
+
+SessionFarm::~SessionFarm()
+{
+	if (m_timer != 0)
+		m_loop.CancelTimer(m_timer);
+	// sessions hold channels of the mux, they go first
+	m_sessions.clear();
+	m_closing.clear();
+	m_mux.reset();
+	m_executor.reset();
+}
+
+bool SessionFarm::SetShards(size_t shards)
+{
+	if (!m_sessions.empty() || !m_closing.empty())
+		return false;
+	m_shardCount = shards;
+	m_executor.reset();
+	return true;
+}
+
+int SessionFarm::Open(int count)
+{
+	if (m_mux && !m_mux->Alive())
+	{
+		Console::Out() << "mux link is down, wait for its " << m_sessions.size() + m_closing.size() << " session(s) to close" << std::endl;
+		return 0;
+	}
+	if (!m_mux)
+	{
+		auto link = Connector::Open(m_endpoint);
+		if (!link)
+			return 0;
+		m_mux = std::make_unique<SessionMux>(std::move(link));
+	}
+	if (!m_executor)
+		m_executor = std::make_unique<ShardedExecutor>(m_shardCount);
+
+	int opened = 0;
+	for (; opened < count; opened++)
+	{
+		auto transport = m_mux->OpenSession();
+		if (!transport)
+			break;
+		const uint16_t id = transport->SessionId();
+		Session& session = m_sessions[id];
+		session.id = id;
+		session.player = std::make_unique<Player>(std::move(transport), nullptr, &m_loop);
+		session.player->Handler().RunOn(*m_executor, m_executor->ShardFor(id));
+		session.processor = std::make_unique<CommandProcessor>(*session.player, &m_loop);
+	}
+	if (m_timer == 0)
+		m_timer = m_loop.AddTimer(std::chrono::milliseconds(50), [this]() { Tick(); }, std::chrono::milliseconds(50));
+	return opened;
+}
+
+bool SessionFarm::Close(uint16_t id)
+{
+	if (id == 0)
+	{
+		for (auto& [sessionId, session] : m_sessions)
+			Retire(std::move(session));
+		m_sessions.clear();
+		return true;
+	}
+	auto it = m_sessions.find(id);
+	if (it == m_sessions.end())
+		return false;
+	Retire(std::move(it->second));
+	m_sessions.erase(it);
+	return true;
+}
+
+bool SessionFarm::Run(uint16_t id, const std::string& line)
+{
+	auto it = m_sessions.find(id);
+	if (it == m_sessions.end())
+		return false;
+	it->second.processor->HandleLine(ExpandId(line, id));
+	return true;
+}
+
+void SessionFarm::RunAll(const std::string& line)
+{
+	for (auto& [id, session] : m_sessions)
+		session.processor->HandleLine(ExpandId(line, id));
+}
+
+void SessionFarm::Retire(Session&& session)
+{
+	// tells the server right away, the objects wait in m_closing
+	session.player->Delete();
+	session.closedAt = std::chrono::steady_clock::now();
+	m_closing.push_back(std::move(session));
+}
+
+void SessionFarm::Tick()
+{
+	for (auto& [id, session] : m_sessions)
+		session.player->Tracker().Tick();
+	// the server closed them, or the link is gone
+	for (auto it = m_sessions.begin(); it != m_sessions.end();)
+	{
+		if (!it->second.player->Expired())
+		{
+			++it;
+			continue;
+		}
+		Retire(std::move(it->second));
+		it = m_sessions.erase(it);
+	}
+
+	const auto now = std::chrono::steady_clock::now();
+	for (auto it = m_closing.begin(); it != m_closing.end();)
+	{
+		// pending requests time out here, which also ends the flows waiting on them
+		it->player->Tracker().Tick();
+		if (now - it->closedAt < kCloseLinger || it->player->Tracker().PendingCount() > 0)
+		{
+			++it;
+			continue;
+		}
+		it = m_closing.erase(it);
+	}
+
+	if (m_mux && !m_mux->Alive() && m_sessions.empty() && m_closing.empty())
+	{
+		Console::Out() << "mux link closed" << std::endl;
+		m_mux.reset();
+	}
+}
+
+void SessionFarm::PrintStats()
+{
+	RequestCoalescer::Stats coalesced{};
+	for (auto& [id, session] : m_sessions)
+	{
+		const RequestCoalescer::Stats stats = session.player->Coalescer().GetStats();
+		coalesced.sent += stats.sent;
+		coalesced.joined += stats.joined;
+		coalesced.cached += stats.cached;
+	}
+	Console::Out() << "[MUX SESSIONS] open " << m_sessions.size() << ", closing " << m_closing.size()
+		<< ", endpoint " << m_endpoint.ToString()
+		<< ", table info sent " << coalesced.sent << ", saved " << coalesced.joined + coalesced.cached << std::endl;
+	if (m_mux)
+		m_mux->PrintStats();
+	if (m_executor)
+		m_executor->PrintStats();
+}
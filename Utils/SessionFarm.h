@@ -0,0 +1,65 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Net/Connector.h"
+
+class CommandProcessor;
+class EventLoop;
+class Player;
+class SessionMux;
+class ShardedExecutor;
+
+// Backend of the MUX command: logical sessions sharing one SessionMux connection, each with
+// its own Player (request tracking) and CommandProcessor (current room, coroutine session),
+// so one client drives many bot seats over a single socket. Loop thread only.
+// Each session's inbound packs are dispatched on a ShardedExecutor shard picked by its id,
+// so many busy sessions use many cores; commands and coroutine flows stay on the loop.
+// Sessions do not reconnect; when the shared link drops they all end.
+class SessionFarm
+{
+public:
+	SessionFarm(Connector::Endpoint endpoint, EventLoop& loop);
+	~SessionFarm();
+	SessionFarm(const SessionFarm&) = delete;
+	SessionFarm& operator=(const SessionFarm&) = delete;
+
+	// Connects the shared link on first use, returns how many sessions were opened
+	int Open(int count);
+	// 0 closes every session, the link stays up for new ones
+	bool Close(uint16_t id);
+	// Runs a console line as that session, "{id}" in the line becomes the session id
+	bool Run(uint16_t id, const std::string& line);
+	void RunAll(const std::string& line);
+	size_t Count() const { return m_sessions.size(); }
+	// Dispatch thread count for sessions opened from now on, 0 = one per hardware thread.
+	// False while sessions are open or closing, they are pinned to the current shards.
+	bool SetShards(size_t shards);
+	void PrintStats();
+
+private:
+	struct Session
+	{
+		uint16_t id = 0;
+		std::unique_ptr<Player> player;
+		std::unique_ptr<CommandProcessor> processor;
+		std::chrono::steady_clock::time_point closedAt{};
+	};
+
+	void Tick();
+	void Retire(Session&& session);
+
+	Connector::Endpoint m_endpoint;
+	EventLoop& m_loop;
+	size_t m_shardCount = 0;
+	// declared before the sessions, whose handlers post to it, so it is destroyed after them
+	std::unique_ptr<ShardedExecutor> m_executor;
+	std::unique_ptr<SessionMux> m_mux;
+	std::map<uint16_t, Session> m_sessions;
+	// closed sessions linger until pending requests, and flows they resumed, are done with them
+	std::vector<Session> m_closing;
+	uint64_t m_timer = 0;
+};
@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "ShardedExecutor.h"
+#include <algorithm>
+#include <future>
+#include <latch>
+
+#undef min
+#undef max
+
+ShardedExecutor::ShardedExecutor(size_t shards)
+{
+	if (shards == 0)
+		shards = std::max(1u, std::thread::hardware_concurrency());
+	m_shards.reserve(shards);
+	for (size_t i = 0; i < shards; i++)
+		m_shards.push_back(std::make_unique<Shard>());
+	// every Shard is in place before a thread can look at it, and every thread has published
+	// its id before the constructor returns, so InShard never reads one being written
+	std::latch started((std::ptrdiff_t)m_shards.size());
+	for (auto& shard : m_shards)
+	{
+		shard->thread = std::thread([this, &shard = *shard, &started]() {
+			shard.threadId = std::this_thread::get_id();
+			started.count_down();
+			RunShard(shard);
+		});
+	}
+	started.wait();
+}
+
+ShardedExecutor::~ShardedExecutor()
+{
+	for (auto& shard : m_shards)
+	{
+		std::unique_lock<std::mutex> lock(shard->mutex);
+		shard->stopping = true;
+		shard->cv.notify_one();
+	}
+	for (auto& shard : m_shards)
+		if (shard->thread.joinable())
+			shard->thread.join();
+}
+
+void ShardedExecutor::Post(size_t shard, Callback task)
+{
+	Shard& target = *m_shards[shard % m_shards.size()];
+	bool wake = false;
+	{
+		std::unique_lock<std::mutex> lock(target.mutex);
+		// a busy shard picks the task up on its own, only an idle one needs the signal
+		wake = target.queue.empty();
+		target.queue.push_back(std::move(task));
+		if (target.queue.size() > target.maxDepth)
+			target.maxDepth = target.queue.size();
+	}
+	target.posted++;
+	if (wake)
+		target.cv.notify_one();
+}
+
+void ShardedExecutor::Flush(size_t shard)
+{
+	if (InShard(shard))
+		return;
+	auto done = std::make_shared<std::promise<void>>();
+	auto finished = done->get_future();
+	Post(shard, [done]() { done->set_value(); });
+	finished.wait();
+}
+
+bool ShardedExecutor::InShard(size_t shard) const
+{
+	return m_shards[shard % m_shards.size()]->threadId == std::this_thread::get_id();
+}
+
+void ShardedExecutor::RunShard(Shard& shard)
+{
+	std::vector<Callback> batch;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(shard.mutex);
+			shard.cv.wait(lock, [&shard]() { return !shard.queue.empty() || shard.stopping; });
+			if (shard.queue.empty())
+				return;
+			// swap the whole queue out, posters only contend for the lock once per batch
+			batch.swap(shard.queue);
+		}
+		shard.batches++;
+		for (auto& task : batch)
+			task();
+		shard.run += batch.size();
+		batch.clear();
+	}
+}
+
+void ShardedExecutor::PrintStats()
+{
+	Console::Out() << "[SHARDS] " << m_shards.size() << " thread(s)" << std::endl;
+	for (size_t i = 0; i < m_shards.size(); i++)
+	{
+		Shard& shard = *m_shards[i];
+		size_t depth = 0, maxDepth = 0;
+		{
+			std::unique_lock<std::mutex> lock(shard.mutex);
+			depth = shard.queue.size();
+			maxDepth = shard.maxDepth;
+		}
+		const uint64_t batches = shard.batches;
+		Console::Out() << '\t' << "shard " << i << ": posted " << shard.posted << ", run " << shard.run
+			<< ", batches " << batches << " (avg " << std::format("{:.1f}", batches > 0 ? (double)shard.run / batches : 0.0) << ")"
+			<< ", depth " << depth << " (max " << maxDepth << ")" << std::endl;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own queue. Work posted to a shard always
+// runs on that shard's thread in posting order, so whatever is pinned to a shard (a
+// session's NetPackHandler) is only ever touched by one thread, and shards never
+// contend with each other: throughput grows with the shard count until cores run out.
+class ShardedExecutor
+{
+public:
+	using Callback = std::function<void()>;
+
+	// 0 picks one shard per hardware thread
+	explicit ShardedExecutor(size_t shards);
+	// Runs what is already queued, then joins
+	~ShardedExecutor();
+	ShardedExecutor(const ShardedExecutor&) = delete;
+	ShardedExecutor& operator=(const ShardedExecutor&) = delete;
+
+	size_t ShardCount() const { return m_shards.size(); }
+	// Stable pinning of a key (a session id) to a shard
+	size_t ShardFor(uint64_t key) const { return (size_t)(key % m_shards.size()); }
+	// Any thread
+	void Post(size_t shard, Callback task);
+	// Any thread. Returns once everything posted to the shard so far has run,
+	// at once when called on that shard's own thread.
+	void Flush(size_t shard);
+	bool InShard(size_t shard) const;
+
+	void PrintStats();
+
+private:
+	struct Shard
+	{
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::vector<Callback> queue;
+		bool stopping = false;
+		std::thread thread;
+		std::thread::id threadId;          // written by the shard thread before the constructor returns
+		size_t maxDepth = 0;               // under mutex
+		std::atomic<uint64_t> posted = 0;
+		std::atomic<uint64_t> run = 0;
+		std::atomic<uint64_t> batches = 0;  // wakeups, run / batches is the average batch
+	};
+
+	void RunShard(Shard& shard);
+
+	std::vector<std::unique_ptr<Shard>> m_shards;
+};
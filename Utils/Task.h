@@ -0,0 +1,95 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Lazily started coroutine returning T. Awaiting a Task starts it and resumes the
+// awaiter when it finishes (symmetric transfer, so long chains do not grow the stack).
+// Top-level flows are handed to CoScheduler::Spawn, which owns them until completion.
+template<typename T = void>
+class Task;
+
+namespace TaskDetail
+{
+	struct FinalAwaiter
+	{
+		bool await_ready() const noexcept { return false; }
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> finished) noexcept
+		{
+			auto continuation = finished.promise().continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+		void await_resume() const noexcept {}
+	};
+
+	struct PromiseBase
+	{
+		std::coroutine_handle<> continuation;
+		std::exception_ptr exception;
+
+		std::suspend_always initial_suspend() const noexcept { return {}; }
+		FinalAwaiter final_suspend() const noexcept { return {}; }
+		void unhandled_exception() { exception = std::current_exception(); }
+	};
+
+	template<typename T>
+	struct Promise : PromiseBase
+	{
+		std::optional<T> value;
+		template<typename U>
+		void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+	};
+
+	template<>
+	struct Promise<void> : PromiseBase
+	{
+		void return_void() const noexcept {}
+	};
+}
+
+template<typename T>
+class Task
+{
+public:
+	struct promise_type : TaskDetail::Promise<T>
+	{
+		Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+	};
+
+	Task() = default;
+	Task(Task&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+	Task& operator=(Task&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (m_handle) m_handle.destroy();
+			m_handle = std::exchange(other.m_handle, nullptr);
+		}
+		return *this;
+	}
+	Task(const Task&) = delete;
+	Task& operator=(const Task&) = delete;
+	~Task() { if (m_handle) m_handle.destroy(); }
+
+	bool await_ready() const noexcept { return !m_handle || m_handle.done(); }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		m_handle.promise().continuation = awaiting;
+		return m_handle;
+	}
+	T await_resume()
+	{
+		auto& promise = m_handle.promise();
+		if (promise.exception)
+			std::rethrow_exception(promise.exception);
+		if constexpr (!std::is_void_v<T>)
+			return std::move(*promise.value);
+	}
+
+private:
+	explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+	std::coroutine_handle<promise_type> m_handle;
+};
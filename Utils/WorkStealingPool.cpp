@@ -0,0 +1,164 @@
+#include "pch.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+
+#undef min
+#undef max
+
+namespace
+{
+	// which pool and worker the current thread is, so nested ParallelFor calls use their own deque
+	thread_local const WorkStealingPool* t_pool = nullptr;
+	thread_local size_t t_worker = 0;
+}
+
+WorkStealingPool::WorkStealingPool(size_t threads)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	m_workers.reserve(threads);
+	for (size_t i = 0; i < threads; i++)
+		m_workers.push_back(std::make_unique<Worker>());
+	// every Worker is in place before a thread can steal from it
+	for (size_t i = 0; i < threads; i++)
+		m_workers[i]->thread = std::thread(&WorkStealingPool::RunWorker, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers)
+		if (worker->thread.joinable())
+			worker->thread.join();
+}
+
+void WorkStealingPool::ParallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+	if (count == 0)
+		return;
+
+	struct Batch
+	{
+		std::atomic<size_t> left = 0;
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+	auto batch = std::make_shared<Batch>();
+	batch->left = count;
+
+	const size_t workers = m_workers.size();
+	for (size_t w = 0; w < workers; w++)
+	{
+		const size_t begin = count * w / workers;
+		const size_t end = count * (w + 1) / workers;
+		if (begin == end)
+			continue;
+		Worker& worker = *m_workers[w];
+		std::unique_lock<std::mutex> lock(worker.mutex);
+		for (size_t i = begin; i < end; i++)
+		{
+			worker.tasks.push_back([&body, batch, i]() {
+				body(i);
+				if (--batch->left == 0)
+				{
+					std::unique_lock<std::mutex> doneLock(batch->mutex);
+					batch->done.notify_all();
+				}
+			});
+		}
+	}
+	{
+		// under the sleep lock, or a worker between its check and its wait misses the signal
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_queued += count;
+	}
+	m_wake.notify_all();
+
+	const size_t self = t_pool == this ? t_worker : workers;
+	while (batch->left > 0)
+	{
+		if (RunOne(self))
+			continue;
+		// the rest is running elsewhere
+		std::unique_lock<std::mutex> lock(batch->mutex);
+		batch->done.wait_for(lock, std::chrono::milliseconds(1), [&batch]() { return batch->left == 0; });
+	}
+}
+
+void WorkStealingPool::RunWorker(size_t self)
+{
+	t_pool = this;
+	t_worker = self;
+	for (;;)
+	{
+		if (RunOne(self))
+			continue;
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [this]() { return m_queued > 0 || m_stopping; });
+		if (m_stopping && m_queued == 0)
+			return;
+	}
+}
+
+bool WorkStealingPool::RunOne(size_t self)
+{
+	Callback task;
+	if (!TakeOwn(self, task) && !Steal(self, task))
+		return false;
+	task();
+	if (self < m_workers.size())
+		m_workers[self]->run++;
+	return true;
+}
+
+bool WorkStealingPool::TakeOwn(size_t self, Callback& task)
+{
+	if (self >= m_workers.size())
+		return false;
+	Worker& worker = *m_workers[self];
+	std::unique_lock<std::mutex> lock(worker.mutex);
+	if (worker.tasks.empty())
+		return false;
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+	m_queued--;
+	return true;
+}
+
+bool WorkStealingPool::Steal(size_t thief, Callback& task)
+{
+	const size_t workers = m_workers.size();
+	// start after the thief so thieves spread over their victims
+	for (size_t n = 1; n <= workers; n++)
+	{
+		const size_t victim = (thief + n) % workers;
+		if (victim == thief)
+			continue;
+		Worker& worker = *m_workers[victim];
+		std::unique_lock<std::mutex> lock(worker.mutex);
+		if (worker.tasks.empty())
+			continue;
+		task = std::move(worker.tasks.front());
+		worker.tasks.pop_front();
+		m_queued--;
+		if (thief < workers)
+			m_workers[thief]->stolen++;
+		return true;
+	}
+	return false;
+}
+
+void WorkStealingPool::PrintStats()
+{
+	Console::Out() << "[STEALING POOL] " << m_workers.size() << " thread(s), queued " << m_queued << std::endl;
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		const Worker& worker = *m_workers[i];
+		Console::Out() << '\t' << "worker " << i << ": run " << worker.run << ", stolen " << worker.stolen << std::endl;
+	}
+}
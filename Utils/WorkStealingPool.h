@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads with a deque each, for fork-join work of uneven size. A worker takes
+// its own newest task first and, once its deque is empty, steals the oldest task of
+// another worker, so a few long tasks never leave the rest of the pool idle. Unlike
+// ShardedExecutor nothing is pinned: any task may run on any thread, in any order.
+class WorkStealingPool
+{
+public:
+	// 0 picks one worker per hardware thread
+	explicit WorkStealingPool(size_t threads);
+	// Runs what is already queued, then joins
+	~WorkStealingPool();
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	size_t WorkerCount() const { return m_workers.size(); }
+	// Runs body(i) for every i in [0, count) and returns once all of them have. Indices are
+	// dealt out in contiguous runs, one per worker; the calling thread runs tasks as well,
+	// so this may be called from inside a task without starving the pool.
+	void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+
+	void PrintStats();
+
+private:
+	using Callback = std::function<void()>;
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Callback> tasks;
+		std::thread thread;
+		std::atomic<uint64_t> run = 0;
+		std::atomic<uint64_t> stolen = 0;
+	};
+
+	void RunWorker(size_t self);
+	// own newest first, then the oldest of the others; false if every deque is empty
+	bool RunOne(size_t self);
+	bool TakeOwn(size_t self, Callback& task);
+	bool Steal(size_t thief, Callback& task);
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	std::atomic<size_t> m_queued = 0;
+	bool m_stopping = false;   // under m_sleepMutex
+};
@@ -1,14 +1,128 @@
 #include "pch.h"
 #include "Utils//CommandProcessor.h"
 #include "Audio/AudioCenter.h"
+#include "Net/Connector.h"
+#include "Net/FaultInjectingTransport.h"
+#include "Net/Transport.h"
+#include "Net/ReconnectManager.h"
+#include "Net/NetHealth.h"
+#include "Net/RequestTracker.h"
+#include "Utils/CoScheduler.h"
+#include "Utils/EventLoop.h"
+#include "ServerClass/LoopbackServer.h"
+#include "Utils/ScriptRunner.h"
+#include <fstream>
 
-int main(int* args)
+namespace
 {
-	system("chcp 936");
-	Console::Start();
-	Console::Out() << "cpp client project start" << std::endl;
+	// --serve <port>: only run the loopback server, e.g. for a load harness in another process
+	int RunServerOnly(LoopbackServer& server)
+	{
+		Console::Out() << "serving on 127.0.0.1:" << server.Port() << ", type STAT or QUIT" << std::endl;
+		std::string line;
+		while (Console::ReadLine(line))
+		{
+			if (line == "QUIT")
+				break;
+			if (line == "STAT")
+				server.PrintStats();
+		}
+		server.Stop();
+		WSACleanup();
+		Console::Stop();
+		return 0;
+	}
+}
+
+// Usage: CppClient [--host <host>] [--port <port>] [--connect <uri>] [--loopback]
+//                  [--connect-timeout <ms>] [--faults <spec>] [--serve <port>] [--shm <name>]
+//                  [--headless] [--script <file>] [--json]
+//   --connect <uri> tcp://host:port or shm://name (shared memory, same host only)
+//   --connect-timeout <ms>  give up on a tcp connect (resolving and all addresses) after this long
+//   --faults <spec> run the client link through a simulated bad network, e.g. "3g" or
+//                   "flaky,seed=7" or "latency=50,jitter=20,split=0.3" (see FaultInjectingTransport)
+//   --loopback      start the in-process server stub on a free port and connect to it,
+//                   over shared memory if --connect names a shm:// endpoint; turns on
+//                   request id trailers (RPCSTAT REQID), which the stub echoes
+//   --serve <port>  run only the server stub
+//   --shm <name>    with --serve, also accept shm://name clients
+//   --headless      no console UI and no TTS, commands come from stdin (see ScriptRunner)
+//   --script <file> headless, commands come from the file
+//   --json          headless output as one JSON object per line
+int main(int argc, char** argv)
+{
+	std::string serverHost = "127.0.0.1"; // when testing using 127.0.0.1
+	//std::string serverHost = "43.128.29.250";
+	std::string serverPort = "80";
+	std::string connectUri;
+	std::string shmName;
+	std::string faults;
+	Connector::Options connectOptions;
+	bool loopback = false;
+	int servePort = -1;
+	bool headless = false;
+	bool json = false;
+	std::string scriptPath;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const bool hasValue = i + 1 < argc;
+		if (arg == "--host" && hasValue) serverHost = argv[++i];
+		else if (arg == "--port" && hasValue) serverPort = argv[++i];
+		else if (arg == "--connect" && hasValue) connectUri = argv[++i];
+		else if (arg == "--shm" && hasValue) shmName = argv[++i];
+		else if (arg == "--connect-timeout" && hasValue) connectOptions.timeoutMs = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--faults" && hasValue) faults = argv[++i];
+		else if (arg == "--loopback") loopback = true;
+		else if (arg == "--serve" && hasValue) servePort = std::atoi(argv[++i]);
+		else if (arg == "--headless") headless = true;
+		else if (arg == "--script" && hasValue) { scriptPath = argv[++i]; headless = true; }
+		else if (arg == "--json") json = true;
+	}
+
+	Connector::SetOptions(connectOptions);
+	Connector::Endpoint endpoint;
+	if (connectUri.empty())
+	{
+		endpoint.host = serverHost;
+		endpoint.port = serverPort;
+	}
+	else if (!Connector::ParseUri(connectUri, endpoint))
+	{
+		std::cerr << "bad --connect uri " << connectUri << ", expected tcp://host:port or shm://name" << std::endl;
+		return 1;
+	}
+	FaultInjectingTransport::Profile faultProfile;
+	std::string faultError;
+	if (!faults.empty() && !FaultInjectingTransport::Profile::Parse(faults, faultProfile, faultError))
+	{
+		std::cerr << "bad --faults spec: " << faultError << std::endl;
+		return 1;
+	}
+	endpoint.faults = faults;
 
-	AudioCenter::Inst();
+	std::ifstream scriptFile;
+	if (!scriptPath.empty())
+	{
+		scriptFile.open(scriptPath);
+		if (!scriptFile)
+		{
+			std::cerr << "cannot open script " << scriptPath << std::endl;
+			return 1;
+		}
+	}
+
+	if (headless)
+	{
+		Console::StartHeadless(json ? Console::HeadlessFormat::Json : Console::HeadlessFormat::Plain);
+		AudioCenter::SetEnabled(false);
+	}
+	else
+	{
+		system("chcp 936");
+		Console::Start();
+	}
+	Console::Out() << "cpp client project start" << std::endl;
 
 	WSADATA wsaData;
 	int iResult;
@@ -21,66 +135,106 @@ int main(int* args)
 		return 1;
 	}
 
-	const std::string serverPort = "80";
-	struct addrinfo* result = NULL, * ptr = NULL, hints;
-	ZeroMemory(&hints, sizeof(hints));
-	hints.ai_family = AF_INET;
-	hints.ai_socktype = SOCK_STREAM;
-	hints.ai_protocol = IPPROTO_TCP;
-	// when testing using 127.0.0.1
-	iResult = getaddrinfo("127.0.0.1", serverPort.c_str(), &hints, &result);
-	//iResult = getaddrinfo("43.128.29.250", serverPort.c_str(), &hints, &result);
-	if (iResult != 0) {
-		Console::Err() << "getaddrinfo failed: " << iResult << std::endl;
-		WSACleanup();
-		Console::Stop();
-		return 1;
+	LoopbackServer loopbackServer;
+	if (loopback || servePort >= 0)
+	{
+		LoopbackServer::Config config;
+		config.port = (uint16_t)std::max(servePort, 0);
+		config.shmName = servePort >= 0 ? shmName : endpoint.name;
+		config.verbose = true;
+		if (!loopbackServer.Start(config))
+		{
+			WSACleanup();
+			Console::Stop();
+			return 1;
+		}
+		if (servePort >= 0)
+			return RunServerOnly(loopbackServer);
+		// the stub echoes request ids and pushes table info, FIFO matching would mix the two up
+		RequestTracker::SetUseWireIds(true);
+		if (endpoint.scheme == Connector::Endpoint::Scheme::Tcp)
+		{
+			endpoint.host = "127.0.0.1";
+			endpoint.port = std::to_string(loopbackServer.Port());
+		}
 	}
 
-	SOCKET connectSocket = INVALID_SOCKET;
-	// Attempt to connect to the first address returned by
-	// the call to getaddrinfo
-	ptr = result;
-	// Create a SOCKET for connecting to server
-	connectSocket = socket(ptr->ai_family, ptr->ai_socktype, ptr->ai_protocol);
-	if (connectSocket == INVALID_SOCKET) {
-		Console::Err() << "Error at socket(): " << WSAGetLastError() << std::endl;
-		freeaddrinfo(result);
-		WSACleanup();
-		Console::Stop();
-		return 1;
-	}
-	// Connect to server.
-	iResult = connect(connectSocket, ptr->ai_addr, (int)ptr->ai_addrlen);
-	if (iResult == SOCKET_ERROR) {
-		closesocket(connectSocket);
-		connectSocket = INVALID_SOCKET;
-	}
-	// Should really try the next address returned by getaddrinfo
-	// if the connect call failed
-	// But for this simple example we just free the resources
-	// returned by getaddrinfo and print an error message
-	freeaddrinfo(result);
-	if (connectSocket == INVALID_SOCKET) {
+	if (AudioCenter::IsEnabled())
+		AudioCenter::Inst();
+
+	auto transport = Connector::Open(endpoint);
+	if (!transport) {
 		Console::Err() << "Unable to connect to server!" << std::endl;
 		WSACleanup();
 		Console::Stop();
 		return 1;
 	}
 
-	Player selfPlayer(std::move(connectSocket));
-	CommandProcessor processor(selfPlayer);
-	auto inputThread = std::thread([&processor]() { processor.Run(); });
-	while (!selfPlayer.Expired())
-	{
-		auto er = NetPackHandler::DoOneTask();
+	Console::Out() << "connected to " << endpoint.ToString() << std::endl;
+	if (!faults.empty())
+		Console::Out() << "simulating network faults: " << faultProfile.ToString() << std::endl;
+	if (endpoint.scheme == Connector::Endpoint::Scheme::Tcp)
+		Connector::PrintStats();
+	// network reads, pack dispatch, coroutine flows and commands all run on this thread
+	EventLoop loop;
+	ReconnectManager reconnectMgr(endpoint);
+	Player selfPlayer(std::move(transport), &reconnectMgr, &loop);
+	NetHealth::Inst().Start(selfPlayer, 2000);
+	CommandProcessor processor(selfPlayer, &loop);
+
+	// one drain per burst: packs queued while a drain is pending ride along with it
+	std::atomic<bool> drainQueued = false;
+	EventLoop::TimerId flowTimer = 0;
+	std::chrono::steady_clock::time_point flowDeadline{};
+	std::function<void()> drain;
+	auto scheduleDrain = [&loop, &drainQueued, &drain]() {
+		if (!drainQueued.exchange(true))
+			loop.Post(drain);
+	};
+	drain = [&]() {
+		drainQueued = false;
+		auto er = selfPlayer.Handler().DoOneTask();
 		while (er != 1)
 		{
 			if(er > 1) Console::Out() << "NetPackHandler::DoOneTask WARNING: " << er << std::endl;
-			er = NetPackHandler::DoOneTask();
+			er = selfPlayer.Handler().DoOneTask();
 		}
-		std::this_thread::sleep_for(std::chrono::milliseconds(200));
-	}
+		CoScheduler::Inst().RunReady();
+		// wake again when the earliest sleeping flow is due, re-arm only if that moved closer
+		const auto delay = CoScheduler::Inst().NextWakeup(std::chrono::milliseconds(1000));
+		const auto deadline = std::chrono::steady_clock::now() + delay;
+		if (flowTimer != 0 && deadline >= flowDeadline)
+			return;
+		loop.CancelTimer(flowTimer);
+		flowDeadline = deadline;
+		flowTimer = loop.AddTimer(delay, [&flowTimer, &scheduleDrain]() {
+			flowTimer = 0;
+			scheduleDrain();
+		});
+	};
+	selfPlayer.Handler().SetWakeHook(scheduleDrain);
+	CoScheduler::Inst().SetWakeHook(scheduleDrain);
+	// request deadlines, and leaving once the connection is gone for good
+	loop.AddTimer(std::chrono::milliseconds(50), [&loop, &selfPlayer]() {
+		selfPlayer.Tracker().Tick();
+		if (selfPlayer.Expired())
+			loop.Stop();
+	}, std::chrono::milliseconds(50));
+
+	int scriptFailures = 0;
+	auto inputThread = std::thread([&]() {
+		if (!headless)
+		{
+			processor.Run();
+			return;
+		}
+		ScriptRunner runner(processor, selfPlayer, &loop, ScriptRunner::Options{});
+		scriptFailures = runner.Run(scriptFile.is_open() ? static_cast<std::istream&>(scriptFile) : std::cin);
+	});
+	loop.Run();
+	NetHealth::Inst().Stop();
+	loopbackServer.Stop();
 	Console::Stop();
 	inputThread.join();
+	return scriptFailures > 0 ? 2 : 0;
 }
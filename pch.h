@@ -7,10 +7,11 @@
 #include <codecvt>
 #include <locale>
 
-#include <winsock2.h>
-#include <ws2tcpip.h>
+#include "Net/SocketCompat.h"
+#ifdef _WIN32
 #include <windows.h>
 #include <iphlpapi.h>
+#endif
 #include <stdio.h>
 
 #include <functional>